@@ -28,7 +28,29 @@ HEADERS += ./include/config_manager.h \
     ./include/uglobalhotkeys.h \
     ./include/options_window.h \
     ./include/credits_dialog.h \
-    ./include/simpletranslator.h
+    ./include/simpletranslator.h \
+    ./include/upload_throttle.h \
+    ./include/upload_cache.h \
+    ./include/update_downloader.h \
+    ./include/delta_patch.h \
+    ./include/perf_metrics.h \
+    ./include/undo_history.h \
+    ./include/rtree.h \
+    ./include/annotation_scene.h \
+    ./include/pixel_ops.h \
+    ./include/overlay_benchmark.h \
+    ./include/overlay_surface.h \
+    ./include/tiled_layer.h \
+    ./include/edge_map.h \
+    ./include/window_tree.h \
+    ./include/scroll_stitcher.h \
+    ./include/scroll_capture.h \
+    ./include/image_diff.h \
+    ./include/diff_command.h \
+    ./include/stroke.h \
+    ./include/mipmap_pyramid.h \
+    ./include/delta_command.h \
+    ./include/simd.h
 SOURCES += ./src/customTextInput.cpp \
     ./src/editor.cpp \
     ./src/globalKeyboardHook.cpp \
@@ -45,4 +67,24 @@ SOURCES += ./src/customTextInput.cpp \
     ./src/config_manager.cpp \
     ./src/options_window.cpp \
     ./src/credits_dialog.cpp \
-    ./src/simpletranslator.cpp
+    ./src/simpletranslator.cpp \
+    ./src/upload_throttle.cpp \
+    ./src/upload_cache.cpp \
+    ./src/update_downloader.cpp \
+    ./src/delta_patch.cpp \
+    ./src/perf_metrics.cpp \
+    ./src/undo_history.cpp \
+    ./src/annotation_scene.cpp \
+    ./src/pixel_ops.cpp \
+    ./src/overlay_benchmark.cpp \
+    ./src/overlay_surface.cpp \
+    ./src/tiled_layer.cpp \
+    ./src/edge_map.cpp \
+    ./src/window_tree.cpp \
+    ./src/scroll_stitcher.cpp \
+    ./src/scroll_capture.cpp \
+    ./src/image_diff.cpp \
+    ./src/diff_command.cpp \
+    ./src/stroke.cpp \
+    ./src/mipmap_pyramid.cpp \
+    ./src/delta_command.cpp
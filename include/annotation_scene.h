@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QPainter>
+#include <QPixmap>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "rtree.h"
+
+// One editable markup item on top of the capture. Geometry is kept in
+// capture pixels; nothing is written into the screenshot itself.
+struct Annotation {
+    enum Kind {
+        Pen,
+        Rectangle,
+        Ellipse,
+        Line,
+        Arrow,
+        Text
+    };
+
+    int id = 0;
+    Kind kind = Pen;
+    QColor color = Qt::black;
+    int width = 5;
+    QVector<QPoint> points;  // Pen samples, or start and end of Line/Arrow
+    QRect rect;              // Rectangle/Ellipse
+    QString text;            // Text, one line per '\n'
+    QFont font;
+    QPoint textOrigin;       // baseline of the first text line
+
+    QRect bounds() const;
+    bool hitTest(const QPoint& point, int tolerance) const;
+    void translate(const QPoint& offset);
+    void paint(QPainter& painter) const;
+};
+
+// Retained list of annotations. An R-tree over their bounds answers hit tests
+// and damage queries, and each shape keeps its own rasterized tiles so that
+// repainting part of the overlay only blits pixmaps. Stacking order follows
+// ids: a shape restored by undo keeps its id and therefore its place.
+class AnnotationScene {
+public:
+    static constexpr int TileSize = 256;
+
+    AnnotationScene();
+
+    int add(Annotation annotation);
+    void restore(const Annotation& annotation);
+    bool remove(int id);
+    void replace(const Annotation& annotation);
+    void clear();
+
+    const Annotation* find(int id) const;
+    QRect boundsOf(int id) const;
+    bool isEmpty() const { return shapes.isEmpty(); }
+    bool intersects(const QRect& area) const;
+    int topmostAt(const QPoint& point, int tolerance) const;
+
+    // Overlay drawing from the per-shape tile cache, rasterized at the
+    // painter's device pixel ratio.
+    void paint(QPainter& painter, const QRect& area);
+    // Drawing straight from the vector data, limited to area: exports and
+    // the zoomed overlay.
+    void render(QPainter& painter, const QRect& area) const;
+
+private:
+    QVector<int> shapesIn(const QRect& area) const;
+    const QPixmap& tile(const Annotation& annotation, int column, int row, qreal ratio);
+    void invalidate(int id);
+
+    QHash<int, Annotation> shapes;
+    QHash<int, QRect> extents;
+    RTree<int> index;
+    QHash<int, QHash<quint64, QPixmap>> tiles;
+    qint64 cacheBytes;
+    int nextId;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+class QStringList;
+
+// `ScreenMe --make-delta old new patch`: writes the delta patch turning the
+// old installer into the new one, applies it back to old to check that it
+// reproduces new byte for byte, and prints the SHA-256 values that go into
+// the update manifest. Returns 0 on success, 1 when the check fails and 2 on
+// bad arguments or unreadable files.
+int runMakeDeltaCommand(const QStringList& arguments);
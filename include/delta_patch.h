@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// Binary delta in bsdiff layout (control triples, diff bytes, extra bytes) with
+// each block zlib-compressed through qCompress:
+//
+//   "SMDELTA1" | int64 ctrlSize | int64 diffSize | int64 newSize
+//   | ctrl block | diff block | extra block
+//
+// Integers are bsdiff "offtin" encoded (8 bytes, little endian, sign bit in
+// the top byte). ctrlSize and diffSize are the compressed sizes of the first
+// two blocks; the extra block runs to the end of the patch.
+//
+// Each control triple (add, copy, seek) means: add `add` bytes of the diff
+// block to as many bytes of the base file, bytewise modulo 256, starting at
+// the current base position; append `copy` bytes of the extra block as they
+// are; then move the base position by `add + seek`.
+
+// Applies patch to the file at basePath. The base file is memory mapped and
+// the output is streamed to disk, but the three blocks are decompressed in
+// memory first: the diff and extra blocks together are about the size of the
+// new file.
+bool applyDeltaPatch(const QString& basePath, const QByteArray& patch, const QString& outputPath,
+                     QByteArray* sha256Hex, QString* error);
+
+// Builds the patch turning base into target, with the bsdiff 4 algorithm
+// (suffix array of base, approximate matches extended both ways). Needs two
+// 64-bit words per base byte on top of both files, so it belongs in the
+// release tooling, not the client.
+QByteArray createDeltaPatch(const QByteArray& base, const QByteArray& target);
@@ -0,0 +1,9 @@
+#pragma once
+
+class QStringList;
+
+// `ScreenMe --diff before after [--threshold N] [--mask out.png]`: compares
+// two images without showing anything, prints the changed regions and
+// returns 0 when they match, 1 when they differ and 2 on bad arguments or
+// unreadable files, for use in scripts and CI.
+int runDiffCommand(const QStringList& arguments);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Strong horizontal and vertical edges of an image, for snapping. A pixel
+// boundary is an edge when the luma step across it reaches threshold along a
+// straight run of at least minLength pixels; text and noise produce shorter
+// runs and are dropped. The result is two bit planes (about two bits per
+// pixel), so a lookup is a shift and a mask.
+class EdgeMap {
+public:
+    static EdgeMap build(const QImage& image, int threshold = 12, int minLength = 32);
+
+    bool isNull() const { return width == 0; }
+
+    // Nearest column boundary (between pixels x - 1 and x) within radius of
+    // x that is a vertical edge on row y, or -1.
+    int nearestVertical(int x, int y, int radius) const;
+    // Nearest row boundary (between rows y - 1 and y) within radius of y
+    // that is a horizontal edge at column x, or -1.
+    int nearestHorizontal(int x, int y, int radius) const;
+
+private:
+    bool test(const std::vector<quint64>& plane, int bit, int row) const;
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    // Bit x - 1 of row y: boundary x on row y. Bit x of row y: boundary y at
+    // column x.
+    std::vector<quint64> vertical;
+    std::vector<quint64> horizontal;
+};
+
+// Builds an EdgeMap on its own thread (the build itself fans out over the
+// global pool) and hands it to done on receiver's thread. After cancel()
+// returns, done is not called.
+class EdgeMapBuild {
+public:
+    using Callback = std::function<void(std::shared_ptr<const EdgeMap>)>;
+
+    static std::shared_ptr<EdgeMapBuild> start(const QImage& image, QObject* receiver, Callback done);
+    void cancel();
+
+private:
+    EdgeMapBuild() = default;
+    bool isCancelled();
+
+    QMutex mutex;
+    bool cancelled = false;
+};
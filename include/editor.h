@@ -18,7 +18,10 @@ public:
         Rectangle,
         Ellipse,
         Line,
-        Arrow
+        Arrow,
+        Pixelate,
+        Blur,
+        Select
     };
     QColor currentColor;
 
@@ -36,6 +39,7 @@ signals:
     void searchRequested();
     void closeRequested();
     void printRequested();
+    void scrollCaptureRequested();
 
 public slots:
     void deselectTools();
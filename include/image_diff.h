@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <vector>
+
+// Pixel difference between two captures. A pixel has changed when any of its
+// channels differs by at least threshold; the result is a bit plane (one bit
+// per pixel) and the changed areas clustered into bounding boxes. Images of
+// different sizes are compared over their common part and everything outside
+// it counts as changed.
+//
+// The comparison runs four pixels per SSE2 instruction over row bands on the
+// global pool, and the clustering works on 32x32 cells whose exact bounds
+// are collected in the same pass, so boxes cost nothing extra per pixel.
+class ImageDiff {
+public:
+    static constexpr int kDefaultThreshold = 16;
+
+    static ImageDiff compute(const QImage& before, const QImage& after, int threshold = kDefaultThreshold);
+
+    bool isNull() const { return width == 0; }
+    QSize size() const { return QSize(width, height); }
+    qint64 changedPixels() const { return changed; }
+    // Bounding boxes of the changed areas, in image pixels.
+    const QVector<QRect>& regions() const { return boxes; }
+
+    // Format_Grayscale8, white where pixels changed.
+    QImage maskImage() const;
+
+private:
+    void cluster(const std::vector<QRect>& cells, int columns, int rows);
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    qint64 changed = 0;
+    std::vector<quint64> bits;
+    QVector<QRect> boxes;
+};
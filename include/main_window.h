@@ -10,29 +10,47 @@
 #include "config_manager.h"
 #include "uglobalhotkeys.h"
 
+class QProgressDialog;
+class UpdateDownloader;
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
     explicit MainWindow(ConfigManager* configManager, QWidget* parent = nullptr);
+    ~MainWindow() override;
 
 public slots:
     void takeScreenshot();
     void takeFullscreenScreenshot();
+    void takeWindowScreenshot();
+    void compareCaptures();
     void handleHotkeyActivated(size_t id);
     void handleScreenshotClosed();
     void reloadHotkeys();
     void onUpdateCheckFinished(QNetworkReply* reply, bool fromAction);
-    void downloadUpdate(const QString& downloadUrl);
-    void onDownloadFinished(QNetworkReply* reply);
+    void downloadUpdate(const QJsonObject& manifest);
+    void onDownloadFinished(const QString& installerPath, const QString& version);
 
 public:
     void checkForUpdates(bool fromAction);
+    void scheduleUpdateCheck();
 
 signals:
     void screenshotClosed();
     void fullscreenSaved(const QString& path);
+    void windowSaved(const QString& path);
+    void scrollCaptureSaved(const QString& path);
 
 private:
+    void registerHotkeys();
+    void ensureScreenshotDisplay();
+    QString saveToDefaultFolder(const QPixmap& pixmap, const QString& baseName);
+    void processUpdateManifest(const QJsonObject& manifest, bool fromAction);
+    void downloadFullUpdate(const QJsonObject& manifest);
+    void downloadDeltaUpdate(const QJsonObject& manifest, const QJsonObject& delta, const QString& basePath);
+    QProgressDialog* createDownloadProgress(UpdateDownloader* downloader, const QString& label);
+    static QString cachedInstallerPath(const QString& version);
+
     QPointer<ScreenshotDisplay> screenshotDisplay;
     ConfigManager* configManager;
     UGlobalHotkeys* hotkeyManager;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QImage>
+#include <QVector>
+
+// Successive half-size copies of an image for drawing it scaled down. Level 0
+// is the image itself and level n has 1/2^n of its width and height (rounded
+// up); each level is built from the one above on first use, so a view that
+// never zooms out never pays for one. Drawing from the right level leaves
+// less than a 2x reduction to the painter, which keeps the cost of a scaled
+// draw proportional to the pixels shown, and averages instead of skipping
+// pixels.
+class MipmapPyramid {
+public:
+    // Starts over from image (32-bit formats; others are converted).
+    void reset(const QImage& image);
+    void clear();
+
+    bool isNull() const { return levels.isEmpty(); }
+    // Index of the smallest level, a single pixel on its longer side.
+    int maxLevel() const { return top; }
+    // Level index, clamped to [0, maxLevel()].
+    const QImage& level(int index);
+
+    // Level to draw from when source pixels end up scale device pixels wide.
+    static int levelFor(qreal scale);
+
+    qint64 memoryUsage() const;
+
+private:
+    QVector<QImage> levels;
+    int top = 0;
+};
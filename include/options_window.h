@@ -28,17 +28,23 @@ private slots:
     void browseFolder();
     void startRecordingHotkey();
     void startRecordingFullscreenHotkey();
+    void startRecordingWindowHotkey();
     void handleGlobalKeyPress(QKeySequence keySequence);
 
 private:
     ConfigManager* configManager;
     QLineEdit* hotkeyEdit;
     QLineEdit* fullscreenHotkeyEdit;
+    QLineEdit* windowHotkeyEdit;
     QLineEdit* hotkeyEditing;
     QComboBox* extensionCombo;
     QSpinBox* qualitySpinbox;
     QLineEdit* folderEdit;
+    QSpinBox* uploadLimitSpinbox;
+    QSpinBox* perUploadLimitSpinbox;
     QCheckBox* startWithSystemCheckbox;
+    QCheckBox* autoTrimCheckbox;
+    QSpinBox* trimToleranceSpinbox;
     QComboBox* languageCombo;
 };
 
@@ -0,0 +1,9 @@
+#pragma once
+
+class ConfigManager;
+
+// `ScreenMe --benchmark [iterations]`: grabs the desktop repeatedly and
+// reports capture-to-visible latency for an overlay constructed per capture
+// against the pre-warmed overlay that is only reset. Prints to stdout and
+// returns the process exit code.
+int runOverlayBenchmark(ConfigManager* configManager, int iterations);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QPointer>
+#include <QScreen>
+#include <QWidget>
+
+class ScreenshotDisplay;
+
+// One frameless window per QScreen. A surface owns no capture state: it shows
+// its screen's slice of the shared overlay and forwards input, translated to
+// view coordinates (origin at the top-left of the virtual desktop), to the
+// ScreenshotDisplay that owns the selection, annotations and editor. The
+// middle button pans the view instead.
+class OverlaySurface : public QWidget {
+    Q_OBJECT
+public:
+    OverlaySurface(ScreenshotDisplay* display, QScreen* screen);
+
+    QScreen* targetScreen() const { return screen; }
+
+    // Places the surface over its screen; desktopOrigin is the global
+    // top-left of the captured virtual desktop.
+    void attach(const QPoint& desktopOrigin);
+
+    // Offset of this surface inside the overlay.
+    QPoint origin() const { return offset; }
+    QRect overlayRect() const { return rect().translated(offset); }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void closeEvent(QCloseEvent* event) override;
+
+private:
+    ScreenshotDisplay* display;
+    QPointer<QScreen> screen;
+    QPoint offset;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+
+// Process-wide counters and timing samples for the capture overlay. Values are
+// only accumulated here; logSummary() prints them through qDebug so they show
+// up next to the rest of the diagnostics without any extra UI.
+class PerfMetrics {
+public:
+    static PerfMetrics& instance();
+
+    // One rendered frame. latencyUs is the time between the first input sample
+    // of the batch and the frame that consumed it; anything beyond budgetUs is
+    // a late frame, and every whole budget it spans is a missed vsync.
+    void recordFrame(qint64 latencyUs, qint64 budgetUs);
+
+    void addCounter(const QString& name, qint64 delta = 1);
+    qint64 counter(const QString& name) const;
+
+    // Duration-like samples (microseconds, bytes, ...): count, total and max.
+    void addSample(const QString& name, qint64 value);
+
+    void logSummary(const QString& scope) const;
+    void reset();
+
+private:
+    struct Sample {
+        qint64 count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+    };
+
+    PerfMetrics() = default;
+
+    QHash<QString, qint64> counters;
+    QHash<QString, Sample> samples;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QImage>
+#include <QtGlobal>
+#include <functional>
+
+// Runs body(begin, end) over [0, count) in contiguous chunks on the global
+// thread pool (the calling thread takes the first one) and returns when all
+// are done. Work touching fewer than about 256K pixels stays on the calling
+// thread.
+void parallelFor(int count, qint64 pixels, const std::function<void(int, int)>& body);
+
+// Source-over compositing of premultiplied ARGB32 pixels:
+//   dst = src + dst * (255 - src.alpha) / 255
+// Uses SSE2 four pixels at a time where the compiler targets it, with a
+// scalar loop for the remainder and for other architectures.
+void blendPremultipliedRow(quint32* destination, const quint32* source, int count);
+
+// Blends source over destination, both Format_ARGB32_Premultiplied and of the
+// same size. Fully transparent and fully opaque source blocks take a shortcut.
+void blendPremultiplied(QImage& destination, const QImage& source);
+
+// Redaction kernels for 32-bit images (RGB32, ARGB32 or premultiplied).
+// They work in place, only read pixels inside area and split large areas
+// across the global thread pool.
+
+// Replaces every blockSize x blockSize block of area with its average.
+void pixelate(QImage& image, const QRect& area, int blockSize);
+
+// Approximate Gaussian blur: passes rounds of a separable box filter with
+// the given radius. Edges are clamped to area.
+void boxBlur(QImage& image, const QRect& area, int radius, int passes = 3);
+
+// Nearest-neighbour resample of sourceRect into all of target (32-bit
+// formats only). Used for cheap previews without copying the source first.
+void resampleNearest(const QImage& source, const QRect& sourceRect, QImage& target);
+
+// Part of a 32-bit image left once uniform margins are cropped. A side loses
+// the rows or columns whose pixels all stay within tolerance (per channel)
+// of the colour at that side's corner. Every scan stops at the first pixel
+// that differs, so the cost follows the size of the margins, not of the
+// image. An image that is uniform throughout comes back whole.
+QRect trimUniformBorders(const QImage& image, int tolerance);
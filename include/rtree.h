@@ -0,0 +1,243 @@
+#pragma once
+
+#include <QRect>
+#include <QVector>
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Small in-memory R-tree keyed by integer rectangles. Overflowing nodes are
+// split by sorting their entries along the axis with the larger spread of
+// centres, which keeps the tree balanced without the cost of a quadratic
+// split. Removal reinserts the entries of underfull nodes.
+template <typename T, int MaxEntries = 8>
+class RTree {
+public:
+    RTree() : root(new Node()), count(0) {}
+
+    RTree(const RTree&) = delete;
+    RTree& operator=(const RTree&) = delete;
+
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    void clear() {
+        root.reset(new Node());
+        count = 0;
+    }
+
+    void insert(const QRect& rect, const T& value) {
+        insertEntry(rect, value);
+        ++count;
+    }
+
+    bool remove(const QRect& rect, const T& value) {
+        std::vector<std::pair<QRect, T>> orphans;
+        if (!removeFrom(root.get(), rect, value, orphans)) {
+            return false;
+        }
+        --count;
+
+        while (!root->leaf && root->children.size() == 1) {
+            std::unique_ptr<Node> child = std::move(root->children.front());
+            root = std::move(child);
+        }
+        if (!root->leaf && root->children.empty()) {
+            root.reset(new Node());
+        }
+        for (const auto& orphan : orphans) {
+            insertEntry(orphan.first, orphan.second);
+        }
+        return true;
+    }
+
+    // Calls visit(value, rect) for every entry whose rectangle intersects area.
+    template <typename Visitor>
+    void search(const QRect& area, Visitor visit) const {
+        searchIn(root.get(), area, visit);
+    }
+
+    QVector<T> query(const QRect& area) const {
+        QVector<T> result;
+        search(area, [&result](const T& value, const QRect&) {
+            result.append(value);
+        });
+        return result;
+    }
+
+private:
+    static constexpr int MinEntries = std::max(1, MaxEntries * 2 / 5);
+
+    struct Node {
+        bool leaf = true;
+        std::vector<QRect> rects;
+        std::vector<std::unique_ptr<Node>> children;
+        std::vector<T> values;
+
+        int size() const { return static_cast<int>(rects.size()); }
+    };
+
+    static QRect boundsOf(const Node& node) {
+        QRect bounds;
+        for (const QRect& rect : node.rects) {
+            bounds = bounds.united(rect);
+        }
+        return bounds;
+    }
+
+    static qint64 area(const QRect& rect) {
+        return static_cast<qint64>(rect.width()) * rect.height();
+    }
+
+    static int chooseSubtree(const Node& node, const QRect& rect) {
+        int best = 0;
+        qint64 bestGrowth = -1;
+        qint64 bestArea = 0;
+        for (int i = 0; i < node.size(); ++i) {
+            const qint64 currentArea = area(node.rects[i]);
+            const qint64 growth = area(node.rects[i].united(rect)) - currentArea;
+            if (bestGrowth < 0 || growth < bestGrowth || (growth == bestGrowth && currentArea < bestArea)) {
+                best = i;
+                bestGrowth = growth;
+                bestArea = currentArea;
+            }
+        }
+        return best;
+    }
+
+    void insertEntry(const QRect& rect, const T& value) {
+        std::unique_ptr<Node> sibling = insertInto(root.get(), rect, value);
+        if (sibling) {
+            std::unique_ptr<Node> newRoot(new Node());
+            newRoot->leaf = false;
+            newRoot->rects.push_back(boundsOf(*root));
+            newRoot->rects.push_back(boundsOf(*sibling));
+            newRoot->children.push_back(std::move(root));
+            newRoot->children.push_back(std::move(sibling));
+            root = std::move(newRoot);
+        }
+    }
+
+    std::unique_ptr<Node> insertInto(Node* node, const QRect& rect, const T& value) {
+        if (node->leaf) {
+            node->rects.push_back(rect);
+            node->values.push_back(value);
+        }
+        else {
+            const int best = chooseSubtree(*node, rect);
+            std::unique_ptr<Node> sibling = insertInto(node->children[best].get(), rect, value);
+            node->rects[best] = boundsOf(*node->children[best]);
+            if (sibling) {
+                node->rects.push_back(boundsOf(*sibling));
+                node->children.push_back(std::move(sibling));
+            }
+        }
+        return node->size() > MaxEntries ? split(node) : nullptr;
+    }
+
+    std::unique_ptr<Node> split(Node* node) {
+        const int n = node->size();
+        int minX = INT_MAX, maxX = INT_MIN, minY = INT_MAX, maxY = INT_MIN;
+        for (const QRect& rect : node->rects) {
+            const QPoint c = rect.center();
+            minX = std::min(minX, c.x());
+            maxX = std::max(maxX, c.x());
+            minY = std::min(minY, c.y());
+            maxY = std::max(maxY, c.y());
+        }
+        const bool alongX = (maxX - minX) >= (maxY - minY);
+
+        std::vector<int> order(n);
+        for (int i = 0; i < n; ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [node, alongX](int a, int b) {
+            const QPoint ca = node->rects[a].center();
+            const QPoint cb = node->rects[b].center();
+            return alongX ? ca.x() < cb.x() : ca.y() < cb.y();
+        });
+
+        Node kept;
+        kept.leaf = node->leaf;
+        std::unique_ptr<Node> sibling(new Node());
+        sibling->leaf = node->leaf;
+        for (int i = 0; i < n; ++i) {
+            Node& target = i < n / 2 ? kept : *sibling;
+            const int index = order[i];
+            target.rects.push_back(node->rects[index]);
+            if (node->leaf) {
+                target.values.push_back(std::move(node->values[index]));
+            }
+            else {
+                target.children.push_back(std::move(node->children[index]));
+            }
+        }
+        *node = std::move(kept);
+        return sibling;
+    }
+
+    bool removeFrom(Node* node, const QRect& rect, const T& value, std::vector<std::pair<QRect, T>>& orphans) {
+        if (node->leaf) {
+            for (int i = 0; i < node->size(); ++i) {
+                if (node->values[i] == value && node->rects[i] == rect) {
+                    node->rects.erase(node->rects.begin() + i);
+                    node->values.erase(node->values.begin() + i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        for (int i = 0; i < node->size(); ++i) {
+            if (!node->rects[i].contains(rect)) {
+                continue;
+            }
+            Node* child = node->children[i].get();
+            if (!removeFrom(child, rect, value, orphans)) {
+                continue;
+            }
+            if (child->size() < MinEntries) {
+                collect(*child, orphans);
+                node->rects.erase(node->rects.begin() + i);
+                node->children.erase(node->children.begin() + i);
+            }
+            else {
+                node->rects[i] = boundsOf(*child);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    static void collect(const Node& node, std::vector<std::pair<QRect, T>>& out) {
+        if (node.leaf) {
+            for (int i = 0; i < node.size(); ++i) {
+                out.emplace_back(node.rects[i], node.values[i]);
+            }
+            return;
+        }
+        for (const auto& child : node.children) {
+            collect(*child, out);
+        }
+    }
+
+    template <typename Visitor>
+    static void searchIn(const Node* node, const QRect& area, Visitor& visit) {
+        for (int i = 0; i < node->size(); ++i) {
+            if (!node->rects[i].intersects(area)) {
+                continue;
+            }
+            if (node->leaf) {
+                visit(node->values[i], node->rects[i]);
+            }
+            else {
+                searchIn(node->children[i].get(), area, visit);
+            }
+        }
+    }
+
+    std::unique_ptr<Node> root;
+    int count;
+};
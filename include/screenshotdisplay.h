@@ -1,23 +1,69 @@
 #ifndef SCREENSHOTDISPLAY_H
 #define SCREENSHOTDISPLAY_H
 
-#include <stack> 
 #include <QWidget>
 #include <QPixmap>
+#include <QPainter>
 #include <QLabel>
 #include <QPushButton>
 #include <QWheelEvent>
 #include <QPainterPath>
 #include <QGraphicsOpacityEffect>
 #include <QTextEdit>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPointer>
+#include <QCache>
 #include "editor.h"
 #include "config_manager.h"
 #include "customTextEdit.h"
+#include "upload_cache.h"
+#include "undo_history.h"
+#include "annotation_scene.h"
+#include "tiled_layer.h"
+#include "edge_map.h"
+#include "window_tree.h"
+#include "scroll_capture.h"
+#include "image_diff.h"
+#include "stroke.h"
+#include "mipmap_pyramid.h"
+#include "utils.h"
 
-class ScreenshotDisplay : public QWidget {
+class OverlaySurface;
+class QNetworkAccessManager;
+
+// Owns one capture: the image, the shared selection, the annotations and the
+// floating editor. It is shown through one OverlaySurface per screen; every
+// rectangle here is in overlay coordinates, i.e. relative to the top-left of
+// the captured virtual desktop. The surfaces show the overlay through a view
+// transform (Ctrl+wheel zooms, a middle-button drag pans); unzoomed, view and
+// overlay coordinates are the same.
+class ScreenshotDisplay : public QObject {
     Q_OBJECT
 public:
-    explicit ScreenshotDisplay(const QPixmap& pixmap, const QRect& desktopGeometry, QWidget* parent = nullptr, ConfigManager* configManager = nullptr);
+    explicit ScreenshotDisplay(ConfigManager* configManager, QObject* parent = nullptr);
+    ScreenshotDisplay(const DesktopCapture& capture, QObject* parent = nullptr, ConfigManager* configManager = nullptr);
+    ~ScreenshotDisplay() override;
+
+    // Loads a new capture into the (possibly reused) overlay and shows it.
+    void reset(const DesktopCapture& capture);
+    // Same, for a single image covering desktopGeometry.
+    void reset(const QPixmap& pixmap, const QRect& desktopGeometry);
+    // Shows after on the screen under the cursor with the regions that
+    // differ from before outlined; the mouse wheel sets the threshold.
+    void showDiff(const QImage& before, const QImage& after);
+    void close();
+
+    // Called by the surfaces with positions and areas in view coordinates.
+    void paintArea(QPainter& painter, const QRect& exposed);
+    void pointerPressed(OverlaySurface* surface, const QPoint& viewPosition);
+    void pointerMoved(OverlaySurface* surface, const QPoint& viewPosition);
+    void pointerReleased(const QPoint& viewPosition);
+    void panPressed(const QPoint& viewPosition);
+    void panMoved(const QPoint& viewPosition);
+    void panReleased();
+    void keyPressed(QKeyEvent* event);
+    void wheelTurned(QWheelEvent* event);
 
     enum HandlePosition {
         None,
@@ -33,15 +79,11 @@ public:
 
 signals:
     void screenshotClosed();
+    void overlayShown();
+    void scrollCaptureSaved(const QString& path);
 
 protected:
-    void closeEvent(QCloseEvent* event) override;
-    void mousePressEvent(QMouseEvent* event) override;
-    void mouseMoveEvent(QMouseEvent* event) override;
-    void mouseReleaseEvent(QMouseEvent* event) override;
-    void keyPressEvent(QKeyEvent* event) override;
-    void paintEvent(QPaintEvent* event) override;
-    void wheelEvent(QWheelEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
 
 private slots:
     void onToolSelected(Editor::Tool tool);
@@ -49,32 +91,115 @@ private slots:
     void onPublishRequested(bool searchImage);
     void onCloseRequested();
     void onPrintRequested();
+    void onScrollCaptureRequested();
+    void saveScrollCapture(const QImage& image);
     void copySelectionToClipboard();
     void undo();
+    void redo();
 
 private:
     void initializeEditor();
-    void configureShortcuts();
+    void syncSurfaces();
+    void removeSurface(int index);
+    void damage(const QRect& area);
+    void damageAll();
+    void setOverlayCursor(Qt::CursorShape shape);
+    OverlaySurface* surfaceAt(const QPoint& position) const;
+    QRect overlayRect() const;
+    bool isZoomed() const { return zoom != 1.0; }
+    QPoint toCanvas(const QPoint& viewPoint) const;
+    QRect toCanvas(const QRect& viewRect) const;
+    QPoint toView(const QPoint& point) const;
+    QRect toView(const QRect& rect) const;
+    void setZoom(qreal factor, const QPoint& anchor);
+    void clampView();
+    void applyView();
+    void drawZoomedCapture(QPainter& painter, const QRect& exposed);
+    QPixmap renderZoomTile(const QRect& tile, qreal ratio);
+    void releaseCapturePyramid();
+    void requestFrame();
+    void processPendingInput();
+    void applyPointerSamples(const QVector<QPoint>& samples);
+    void configureShortcuts(QWidget* host);
     void updateTooltip();
     void updateEditorPosition();
     void drawHandles(QPainter& painter);
-    void drawArrow(QPainter& painter, const QPoint& start, const QPoint& end);
     void drawBorderCircle(QPainter& painter, const QPoint& position);
-    void saveStateForUndo();
+    QRect segmentBounds(const QPoint& start, const QPoint& end) const;
+    QRect selectionBounds(const QRect& rect) const;
+    QRect shapePreviewBounds() const;
+    Annotation previewAnnotation() const;
+    QRect annotationDamage(const Annotation& annotation) const;
+    void addAnnotation(const Annotation& annotation);
+    void replaceAnnotation(Annotation before, Annotation after);
+    void deleteSelectedAnnotation();
+    void selectAnnotation(int id);
+    bool showsBorderCircle() const;
+    bool isRedactionTool() const;
+    bool showsLoupe() const;
+    QRect loupeBounds(const QPoint& position) const;
+    void drawLoupe(QPainter& painter, const QPoint& position);
+    void runRedactionKernel(QImage& image, const QRect& area, qreal scale) const;
+    void updateRedactionPreview();
+    void applyRedaction(const QRect& area);
+    QPixmap renderCapture(const QRect& selection) const;
+    QRect exportRect() const;
+    QRect borderCircleBounds(const QPoint& position) const;
+    void commitStroke();
     void finalizeTextEdit();
+    void uploadCapture(const QPixmap& selectedPixmap, const QByteArray& contentHash, bool searchImage,
+                       const QRect& screenGeometry, const QJsonObject& loginInfo, const QJsonObject& config);
+    void showUploadResult(const UploadRecord& record, bool searchImage, const QRect& screenGeometry, const QJsonObject& loginInfo);
     void adjustTextEditSize();
     HandlePosition handleAtPoint(const QPoint& point);
     void resizeSelection(const QPoint& point);
+    int snapEdge(Qt::Orientation edge, const QPoint& position, bool trailing) const;
+    void startEdgeMap();
+    void setHoveredWindow(const QRect& rect);
+    void updateDiff();
+    QRect diffRegionRect(const QRect& region) const;
     Qt::CursorShape cursorForHandle(HandlePosition handle);
     QRect toPixmapRect(const QRect& rect) const;
 
-    std::stack<QPixmap> undoStack;
+    QVector<OverlaySurface*> surfaces;
+    OverlaySurface* activeSurface;
+
+    // View transform: an overlay point p is shown at p * zoom + viewOffset.
+    qreal zoom;
+    QPoint viewOffset;
+    QPoint panOrigin;
+    bool panning;
+    // Built from originalPixmap on the first zoomed paint and rebuilt when
+    // its cache key changes; the tiles hold the capture at the current zoom.
+    MipmapPyramid capturePyramid;
+    qint64 capturePyramidKey;
+    QCache<quint64, QPixmap> zoomTiles;
+
+    UndoHistory undoHistory;
     QPixmap originalPixmap;
-    QPixmap drawingPixmap;
+    TiledLayer drawingLayer;
+    QImage redactionSource;
+    QImage redactionPreview;
+    QRect redactionPreviewRect;
+    QImage loupeCache;
+    QRect loupeCacheRect;
+    qint64 loupeCacheKey;
+    std::shared_ptr<const EdgeMap> edgeMap;
+    std::shared_ptr<EdgeMapBuild> edgeMapBuild;
+    QElapsedTimer edgeMapTimer;
+    WindowTree windowTree;
+    QRect hoveredWindow;
+    QPointer<ScrollCapture> scrollCapture;
+    QImage diffBefore;
+    QImage diffAfter;
+    ImageDiff diffResult;
+    QRectF diffPlacement;
+    int diffThreshold;
     QPoint origin;
     QPoint drawingEnd;
     QRect selectionRect;
     QRect currentShapeRect;
+    QRect strokeBounds;
     QPoint selectionOffset;
     QPoint lastPoint;
     QPoint handleOffset;
@@ -83,6 +208,7 @@ private:
     QRect textBoundingRect;
     QPoint endPoint;
     QRect desktopGeometry;
+    QVector<CapturedScreen> captureScreens;
 
     bool selectionStarted;
     bool movingSelection;
@@ -91,7 +217,6 @@ private:
     bool showBorderCircle;
 
     int borderWidth;
-    qreal pixmapDeviceRatio;
 
     QVBoxLayout* actionLayout;
 
@@ -103,9 +228,23 @@ private:
     CustomTextEdit* textEdit;
     QScopedPointer<Editor> editor;
     ConfigManager* configManager;
+    // One manager for the life of the pooled overlay, shared by every publish.
+    QNetworkAccessManager* networkManager;
 
     HandlePosition currentHandle;
-    QPainterPath drawingPath;
+
+    AnnotationScene scene;
+    StrokeBuilder strokeBuilder;
+    Annotation draggedAnnotation;
+    QPoint annotationDragOrigin;
+    int selectedAnnotation;
+    bool movingAnnotation;
+
+    QVector<QPoint> pendingSamples;
+    QElapsedTimer batchTimer;
+    bool frameRequested;
+    QElapsedTimer firstFrameTimer;
+    bool awaitingFirstFrame;
 };
 
 #endif // SCREENSHOTDISPLAY_H
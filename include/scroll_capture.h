@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QWidget>
+#include <QTimer>
+#include <QLabel>
+#include <QPushButton>
+#include <QRect>
+#include "scroll_stitcher.h"
+
+// Small floating panel that drives a scrolling capture: the area (global
+// logical coordinates) is grabbed on a timer while the user scrolls the
+// window underneath, and every grab is handed to a ScrollStitcher. Where the
+// platform allows it, auto-scroll sends one wheel notch after each grab and
+// stops once the page no longer moves. The panel places itself outside the
+// area so it never shows up in the grabs.
+class ScrollCapture : public QWidget {
+    Q_OBJECT
+public:
+    explicit ScrollCapture(const QRect& area, QWidget* parent = nullptr);
+
+    void start();
+
+signals:
+    void finished(const QImage& image);
+    void cancelled();
+
+private slots:
+    void grabFrame();
+    void finish();
+    void cancel();
+
+private:
+    static bool canAutoScroll();
+    void scrollOnce();
+    void updateStatus(ScrollStitcher::Result result);
+
+    QRect area;
+    ScrollStitcher stitcher;
+    QTimer grabTimer;
+    QLabel* statusLabel;
+    QPushButton* autoScrollButton;
+    int idleFrames;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QImage>
+#include <QTemporaryFile>
+#include <QVector>
+
+// Stitches frames of a scrolling region into one tall image. Every frame is
+// reduced to one 64-bit hash per row; rows that did not move between two
+// frames (a sticky header or footer) are split off by comparing hashes in
+// place, and the scroll distance of the rest is found by looking up one
+// window of rows of the new frame among the rolling window hashes of the
+// previous one. Matching is therefore linear in the frame height, and only
+// candidate shifts are verified, row hash by row hash.
+//
+// The stitched rows live in a memory-mapped temporary file rather than on the
+// heap, so long pages do not hold hundreds of megabytes of process memory.
+// Nothing here needs a display: frames are plain images.
+class ScrollStitcher {
+public:
+    enum Result {
+        Appended,   // The frame scrolled; its new rows were added.
+        Unchanged,  // Nothing moved since the last accepted frame.
+        NoOverlap,  // No shift matches: scrolled too far, or backwards.
+        Failed      // Wrong size, buffer error, or maxHeight reached.
+    };
+
+    explicit ScrollStitcher(int maxHeight = 60000);
+    ~ScrollStitcher();
+    ScrollStitcher(const ScrollStitcher&) = delete;
+    ScrollStitcher& operator=(const ScrollStitcher&) = delete;
+
+    Result addFrame(const QImage& frame);
+    void clear();
+
+    int width() const { return frameWidth; }
+    int height() const { return rows; }
+    int frameCount() const { return frames; }
+    // Rows the last appended frame added, header and footer excluded.
+    int lastShift() const { return shift; }
+
+    // Copy of the stitched image, Format_RGB32; null before the first frame.
+    QImage image() const;
+
+private:
+    bool reserveRows(int count);
+    void writeRows(int destination, const QImage& frame, int first, int count);
+
+    int maxHeight;
+    int frameWidth;
+    int frameHeight;
+    int rows;
+    int frames;
+    int shift;
+    qint64 capacity;
+    QTemporaryFile buffer;
+    uchar* mapped;
+    // Row hashes of the last accepted frame.
+    QVector<quint64> previous;
+};
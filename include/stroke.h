@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QPainterPath>
+#include <QPoint>
+#include <QVector>
+
+// Ramer-Douglas-Peucker: the fewest of points such that none of the dropped
+// ones lies farther than tolerance from the polyline that is kept. Distances
+// are measured to segments, so strokes that double back keep their turns.
+QVector<QPoint> simplifyPolyline(const QVector<QPoint>& points, qreal tolerance);
+
+// Curve through every point: each segment is the cubic Bezier form of a
+// Catmull-Rom spline, so sparse simplified points still draw round strokes.
+QPainterPath smoothStrokePath(const QVector<QPoint>& points);
+
+// Samples of the stroke being drawn. They are simplified in batches while
+// the pointer moves, so a long stroke holds at most one batch of raw
+// samples; batch ends are kept as vertices, which bounds the error of the
+// whole stroke by tolerance as well.
+class StrokeBuilder {
+public:
+    explicit StrokeBuilder(qreal tolerance = 0.75);
+
+    void begin(const QPoint& point);
+    void add(const QPoint& point);
+    // Simplified points so far followed by the raw samples of the open batch.
+    QVector<QPoint> points() const;
+    // Closes the last batch and hands over the stroke; the builder is empty
+    // afterwards.
+    QVector<QPoint> finish();
+    void clear();
+
+    // Samples received since begin(), duplicates excluded.
+    int sampleCount() const { return samples; }
+
+private:
+    void flush();
+
+    qreal tolerance;
+    QVector<QPoint> simplified;
+    QVector<QPoint> pending;
+    int samples;
+};
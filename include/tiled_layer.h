@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QHash>
+#include <QPainter>
+#include <QPixmap>
+#include <QRect>
+#include <functional>
+
+// Transparent ARGB layer stored as 256x256 tiles that are only allocated when
+// something is painted into them. An untouched layer costs nothing, and a
+// stroke costs the tiles it crosses rather than a desktop-sized buffer.
+// Tiles hold ratio device pixels per layer pixel, so what is painted into
+// them is as sharp as the screen it is shown on.
+class TiledLayer {
+public:
+    static constexpr int TileSize = 256;
+
+    // Drops every tile and sets the logical size and pixel ratio of the
+    // layer.
+    void reset(const QSize& size, qreal ratio = 1.0);
+    // Drops every tile, keeping the size.
+    void clear();
+
+    // Calls draw once per tile touching area, with a painter in layer
+    // coordinates clipped to that tile. Missing tiles are created first.
+    void paint(const QRect& area, const std::function<void(QPainter&)>& draw);
+    // Draws the allocated tiles intersecting area; painter is in layer
+    // coordinates and may be scaled.
+    void draw(QPainter& painter, const QRect& area) const;
+
+    bool isEmpty() const { return tiles.isEmpty(); }
+    QRect rect() const { return QRect(QPoint(0, 0), layerSize); }
+
+    qint64 memoryUsage() const;
+    qint64 peakMemoryUsage() const { return peakBytes; }
+    // What the same layer costs as one full-size ARGB buffer.
+    qint64 denseMemoryUsage() const;
+
+private:
+    QHash<quint64, QPixmap> tiles;
+    QSize layerSize;
+    qreal ratio = 1.0;
+    qint64 peakBytes = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPixmap>
+#include <QRect>
+#include <QTemporaryFile>
+#include <QVector>
+#include <deque>
+#include <functional>
+
+// Undo/redo for the capture image that stores, per operation, only the
+// 256x256 tiles inside the area it changed: the pixels before and after,
+// each compressed on its own. Undo and redo therefore cost the size of the
+// edit, not of the desktop.
+//
+// Compressed tiles are kept in memory up to the configured limit; beyond it
+// the oldest steps are moved to a temporary file and read back on demand.
+class UndoHistory {
+public:
+    static constexpr int TileSize = 256;
+
+    explicit UndoHistory(qint64 memoryLimit = 256 * 1024 * 1024);
+
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryUsage() const { return inMemoryBytes; }
+
+    // Call beginStep() before painting into area and endStep() once the
+    // painting is done; unchanged tiles are dropped from the step. damage is
+    // what undo() and redo() report for the step (e.g. in display
+    // coordinates); by default it is the changed pixel bounds.
+    void beginStep(const QPixmap& image, const QRect& area);
+    void endStep(const QPixmap& image, const QRect& damage = QRect());
+
+    // Records an edit that changes no pixels, such as adding or moving an
+    // annotation. Both callbacks return the area that needs repainting.
+    void pushAction(std::function<QRect()> undoAction, std::function<QRect()> redoAction);
+
+    bool canUndo() const { return !undoSteps.empty(); }
+    bool canRedo() const { return !redoSteps.empty(); }
+    QRect undo(QPixmap& image);
+    QRect redo(QPixmap& image);
+
+    void clear();
+
+private:
+    struct TileBlob {
+        QByteArray data;
+        qint64 fileOffset = -1;
+        int fileSize = 0;
+    };
+
+    struct TileDelta {
+        QRect rect;
+        TileBlob before;
+        TileBlob after;
+    };
+
+    struct Step {
+        QVector<TileDelta> tiles;
+        QRect bounds;
+        QRect damage;
+        qint64 bytes = 0;
+        bool spilled = false;
+        std::function<QRect()> undoAction;
+        std::function<QRect()> redoAction;
+    };
+
+    void push(Step step);
+    static QByteArray grabTile(const QPixmap& image, const QRect& rect);
+    QByteArray load(const TileBlob& blob);
+    void restore(QPixmap& image, const Step& step, bool useAfter);
+    void enforceLimit();
+    bool spill(Step& step);
+    bool spillBlob(TileBlob& blob);
+
+    std::deque<Step> undoSteps;
+    std::deque<Step> redoSteps;
+    Step pending;
+    QVector<QByteArray> pendingRaw;
+    bool stepOpen;
+    qint64 memoryLimit;
+    qint64 inMemoryBytes;
+    QTemporaryFile spillFile;
+};
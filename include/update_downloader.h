@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QUrl>
+
+// Streams the installer to "<target>.part" as it arrives, hashing on the fly.
+// An interrupted download resumes with a Range request (guarded by If-Range),
+// the result is checked against the SHA-256 from update.json and only then
+// renamed over the target path in one step. A download without a SHA-256
+// fails before it starts. Memory use does not depend on installer size.
+class UpdateDownloader : public QObject {
+    Q_OBJECT
+public:
+    UpdateDownloader(const QUrl& url, const QString& targetPath, const QByteArray& expectedSha256, QObject* parent = nullptr);
+
+    void start();
+    void cancel();
+    bool isCancelled() const { return cancelled; }
+
+signals:
+    void progress(qint64 received, qint64 total);
+    void finished(const QString& path);
+    void failed(const QString& reason);
+
+private slots:
+    void onMetaDataChanged();
+    void onReadyRead();
+    void onReplyFinished();
+
+private:
+    bool preparePartFile();
+    void sendRequest();
+    void restartFromScratch();
+    void loadValidator();
+    void saveValidator(const QByteArray& validator);
+    QString partPath() const;
+    QString validatorPath() const;
+
+    QNetworkAccessManager* manager;
+    QNetworkReply* reply;
+    QFile partFile;
+    QCryptographicHash hash;
+    QUrl url;
+    QString targetPath;
+    QByteArray expectedSha256;
+    QByteArray validator;
+    qint64 offset;
+    qint64 received;
+    qint64 totalSize;
+    int retries;
+    bool cancelled;
+    bool restartRequested;
+    bool responseChecked;
+};
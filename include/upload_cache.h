@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <list>
+
+struct UploadRecord {
+    QString id;
+    QString url;
+    QString imageUrl;
+};
+
+// Maps the content hash of an uploaded capture to the server response so a
+// repeated Upload/Search of the same pixels returns the existing link without
+// re-encoding or re-sending anything. Bounded, least recently used entries are
+// evicted first, and persisted to upload_cache.json between sessions. A hit
+// only reorders entries in memory; the order is written with the next insert
+// or when the application quits.
+class UploadCache {
+public:
+    static UploadCache& instance();
+
+    static QByteArray contentHash(const QImage& image, const QByteArray& settings);
+
+    bool lookup(const QByteArray& hash, UploadRecord& record);
+    void insert(const QByteArray& hash, const UploadRecord& record);
+    void setCapacity(int capacity);
+    // Writes the recency order if a lookup changed it since the last save.
+    void flush();
+
+private:
+    explicit UploadCache(int capacity);
+    void load();
+    void save();
+    void evict();
+
+    using Entry = std::pair<QByteArray, UploadRecord>;
+    std::list<Entry> entries;
+    QHash<QByteArray, std::list<Entry>::iterator> index;
+    int capacity;
+    bool dirty;
+};
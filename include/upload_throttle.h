@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QIODevice>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// Token bucket shaping upload traffic. The burst window adapts: it shrinks
+// while readers keep finding the bucket empty (smoother pacing under
+// contention) and grows back while tokens overflow unused.
+class TokenBucket {
+public:
+    explicit TokenBucket(qint64 bytesPerSecond = 0);
+
+    void setRate(qint64 bytesPerSecond);
+    qint64 rate() const { return bytesPerSecond; }
+    bool isUnlimited() const { return bytesPerSecond <= 0; }
+
+    qint64 available();
+    void consume(qint64 bytes);
+    qint64 msUntilAvailable(qint64 bytes) const;
+
+    void attachStream();
+    void detachStream();
+
+private:
+    void refill();
+    qint64 capacity() const;
+
+    qint64 bytesPerSecond;
+    double tokens;
+    qint64 windowMs;
+    int activeStreams;
+    qint64 lastRefillNs;
+    QElapsedTimer clock;
+};
+
+TokenBucket& globalUploadBucket();
+
+// Sequential body device handed to QNetworkAccessManager. Reads are clamped to
+// the tokens granted by both the per-upload and the global bucket; when none
+// are left readData() returns 0 and readyRead() fires once tokens are back,
+// so the network stack simply waits instead of a thread sleeping.
+class ThrottledUploadDevice : public QIODevice {
+    Q_OBJECT
+public:
+    ThrottledUploadDevice(QIODevice* source, qint64 perUploadRate, QObject* parent = nullptr);
+    ~ThrottledUploadDevice() override;
+
+    static ThrottledUploadDevice* fromConfig(QIODevice* source, const QJsonObject& config, QObject* parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+    qint64 bytesSent() const { return sent; }
+    double averageThroughput() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    void scheduleResume(qint64 delayMs);
+
+    QIODevice* source;
+    TokenBucket localBucket;
+    qint64 sent;
+    bool resumePending;
+    QElapsedTimer transferClock;
+};
@@ -2,20 +2,52 @@
 
 #include <QPixmap>
 #include <QRect>
+#include <QRectF>
 #include <QString>
+#include <QVector>
 
+// One screen of a DesktopCapture. logical is where the screen sits in the
+// capture, in logical pixels relative to DesktopCapture::geometry; physical is
+// where its native pixels were copied into DesktopCapture::pixmap.
+struct CapturedScreen {
+    QRect logical;
+    QRect physical;
+    qreal ratio = 1.0;
+
+    QRectF toPhysical(const QRectF& rect) const {
+        return QRectF(QPointF(physical.topLeft()) + (rect.topLeft() - QPointF(logical.topLeft())) * ratio,
+                      rect.size() * ratio);
+    }
+};
+
+// Every screen is grabbed at its native resolution and copied 1:1 into
+// pixmap, at its logical offset times the highest device pixel ratio. A
+// screen with a lower ratio therefore fills only the top-left part of its
+// cell; use flattened() when one evenly scaled image is needed.
 struct DesktopCapture {
     QPixmap pixmap;
     QRect geometry;
+    QVector<CapturedScreen> screens;
+    qreal ratio = 1.0;
 
     bool isValid() const { return !pixmap.isNull() && geometry.isValid(); }
+    bool isUniform() const;
+    QPixmap flattened() const;
 };
 
 QString getUniqueFilePath(const QString& folder, const QString& baseName, const QString& extension);
 DesktopCapture captureEntireDesktop();
+// Contents of the focused top-level window only, read from the window itself
+// so windows covering it are not included and the cost follows its size.
+// Null when the platform offers no way to do that.
+QPixmap captureActiveWindow();
 void CaptureScreenshot(const QString& savePath);
 void displayScreenshotOnScreen(const QPixmap& pixmap, const QRect& geometry = QRect());
 QString getConfigFilePath(const QString& file);
+// Renames source over target in a single step, replacing target if it
+// exists, so an interruption leaves either the old or the new file.
+bool replaceFile(const QString& source, const QString& target);
+int compareVersions(const QString& lhs, const QString& rhs);
 
 void saveLoginInfo(const QString& id, const QString& email, const QString& nickname, const QString& token);
 QString loadLoginInfo();
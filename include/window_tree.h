@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+#include "rtree.h"
+
+// Rectangles of the windows visible at capture time, in overlay coordinates
+// (logical pixels relative to the captured desktop), for hover selection.
+// On X11 the window tree is read through Qt's xcb connection with every
+// request of a level sent before any reply is read, so the whole snapshot
+// costs one round trip per level. Lookups afterwards only search the
+// in-memory R-tree. Other platforms get an empty tree.
+class WindowTree {
+public:
+    WindowTree() = default;
+    WindowTree(const WindowTree&) = delete;
+    WindowTree& operator=(const WindowTree&) = delete;
+
+    void capture(const QRect& desktopGeometry);
+    void clear();
+
+    bool isEmpty() const { return entries.isEmpty(); }
+    int size() const { return entries.size(); }
+
+    // Innermost window under position, taking the topmost top-level window
+    // that contains it; a null rect when there is none.
+    QRect windowAt(const QPoint& position) const;
+
+private:
+    struct Entry {
+        QRect rect;
+        int toplevel;
+        int depth;
+    };
+
+    void add(const QRect& rect, int toplevel, int depth);
+
+    QVector<Entry> entries;
+    RTree<int> index;
+};
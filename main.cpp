@@ -25,6 +25,9 @@
 #include "include/utils.h"
 #include "include/credits_dialog.h"
 #include "include/simpletranslator.h"
+#include "include/overlay_benchmark.h"
+#include "include/diff_command.h"
+#include "include/delta_command.h"
 #ifdef Q_OS_WIN
 #include "include/hotkeyEventFilter.h"
 #endif
@@ -39,6 +42,19 @@ static void showAboutDialog() {
 
 int main(int argc, char* argv[])
 {
+    // The diff and make-delta commands need no display, so they run before
+    // any GUI object exists and work on headless machines.
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--diff") == 0) {
+            QCoreApplication core(argc, argv);
+            return runDiffCommand(QCoreApplication::arguments());
+        }
+        if (qstrcmp(argv[i], "--make-delta") == 0) {
+            QCoreApplication core(argc, argv);
+            return runMakeDeltaCommand(QCoreApplication::arguments());
+        }
+    }
+
     QApplication app(argc, argv);
     QApplication::setQuitOnLastWindowClosed(false);
 
@@ -46,6 +62,15 @@ int main(int argc, char* argv[])
 
     app.setWindowIcon(QIcon(":/resources/icon.png"));
 
+    const QStringList arguments = QApplication::arguments();
+    const int benchmarkIndex = arguments.indexOf(QStringLiteral("--benchmark"));
+    if (benchmarkIndex >= 0) {
+        bool ok = false;
+        const int iterations = arguments.value(benchmarkIndex + 1).toInt(&ok);
+        ConfigManager benchmarkConfig("config.json");
+        return runOverlayBenchmark(&benchmarkConfig, ok ? iterations : 20);
+    }
+
     QSharedMemory sharedMemory(SHARED_MEM_KEY);
     if (!sharedMemory.create(1)) {
         QMessageBox::warning(nullptr,
@@ -87,12 +112,13 @@ int main(int argc, char* argv[])
 #endif
 
     MainWindow mainWindow(&configManager);
-    mainWindow.checkForUpdates(false);
+    mainWindow.scheduleUpdateCheck();
     mainWindow.hide();
 
     QAction loginAction(QObject::tr("Login to ScreenMe"), &trayMenu);
     QAction takeScreenshotAction(QObject::tr("Take Screenshot"), &trayMenu);
     QAction takeFullscreenScreenshotAction(QObject::tr("Take Fullscreen Screenshot"), &trayMenu);
+    QAction compareCapturesAction(QObject::tr("Compare captures..."), &trayMenu);
     QAction aboutAction(QObject::tr("Credits"), &trayMenu);
     QAction helpAction(QObject::tr("❓Help"), &trayMenu);
     QAction reportBugAction(QObject::tr("🛠️ Report a bug"), &trayMenu);
@@ -117,6 +143,7 @@ int main(int argc, char* argv[])
 
     trayMenu.addAction(&takeScreenshotAction);
     trayMenu.addAction(&takeFullscreenScreenshotAction);
+    trayMenu.addAction(&compareCapturesAction);
     trayMenu.addSeparator();
     trayMenu.addAction(&aboutAction);
     trayMenu.addAction(&helpAction);
@@ -177,6 +204,10 @@ int main(int argc, char* argv[])
         mainWindow.takeFullscreenScreenshot();
     });
 
+    QObject::connect(&compareCapturesAction, &QAction::triggered, [&]() {
+        mainWindow.compareCaptures();
+    });
+
     QObject::connect(&mainWindow, &MainWindow::fullscreenSaved, [&](const QString& path) {
         trayIcon.showMessage(QObject::tr("Screenshot saved"),
                              QObject::tr("Fullscreen capture stored at %1").arg(QDir::toNativeSeparators(path)),
@@ -184,6 +215,20 @@ int main(int argc, char* argv[])
                              3000);
     });
 
+    QObject::connect(&mainWindow, &MainWindow::windowSaved, [&](const QString& path) {
+        trayIcon.showMessage(QObject::tr("Screenshot saved"),
+                             QObject::tr("Window capture stored at %1").arg(QDir::toNativeSeparators(path)),
+                             QSystemTrayIcon::Information,
+                             3000);
+    });
+
+    QObject::connect(&mainWindow, &MainWindow::scrollCaptureSaved, [&](const QString& path) {
+        trayIcon.showMessage(QObject::tr("Screenshot saved"),
+                             QObject::tr("Scrolling capture stored at %1").arg(QDir::toNativeSeparators(path)),
+                             QSystemTrayIcon::Information,
+                             3000);
+    });
+
     QObject::connect(&aboutAction, &QAction::triggered, [&]() {
         showAboutDialog();
     });
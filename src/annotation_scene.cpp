@@ -0,0 +1,336 @@
+#include "../include/annotation_scene.h"
+#include "../include/stroke.h"
+#include <QFontMetrics>
+#include <QPainterPath>
+#include <QPainterPathStroker>
+#include <QPolygon>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Rasterized shape tiles are cheap to rebuild; drop them all rather than
+// letting a long session keep hundreds of megabytes of transparent pixels.
+constexpr qint64 kTileCacheLimit = 128 * 1024 * 1024;
+
+// 24 bits each for row and column, and the device pixel ratio in
+// hundredths, so a shape shown on screens of different density keeps one
+// set of tiles per density.
+quint64 tileKey(int column, int row, qreal ratio) {
+    return (static_cast<quint64>(static_cast<quint32>(row) & 0xFFFFFF) << 40)
+        | (static_cast<quint64>(static_cast<quint32>(column) & 0xFFFFFF) << 16)
+        | static_cast<quint16>(qRound(ratio * 100));
+}
+
+qint64 tileBytes(const QPixmap& tile) {
+    return static_cast<qint64>(tile.width()) * tile.height() * 4;
+}
+
+QPolygon arrowHead(const QPoint& start, const QPoint& end, int width) {
+    const double angle = std::atan2(start.y() - end.y(), start.x() - end.x());
+    const double headLength = width * 5;
+    const double headAngle = M_PI / 15;
+
+    QPolygon head;
+    head << end
+         << end + QPoint(std::cos(angle + headAngle) * headLength, std::sin(angle + headAngle) * headLength)
+         << end + QPoint(std::cos(angle - headAngle) * headLength, std::sin(angle - headAngle) * headLength);
+    return head;
+}
+
+QPainterPath outline(const Annotation& annotation) {
+    QPainterPath path;
+    switch (annotation.kind) {
+    case Annotation::Pen:
+        path = smoothStrokePath(annotation.points);
+        break;
+    case Annotation::Line:
+    case Annotation::Arrow:
+        if (!annotation.points.isEmpty()) {
+            path.moveTo(annotation.points.first());
+            for (int i = 1; i < annotation.points.size(); ++i) {
+                path.lineTo(annotation.points[i]);
+            }
+        }
+        break;
+    case Annotation::Rectangle:
+        path.addRect(annotation.rect);
+        break;
+    case Annotation::Ellipse:
+        path.addEllipse(annotation.rect);
+        break;
+    case Annotation::Text:
+        break;
+    }
+    return path;
+}
+}
+
+QRect Annotation::bounds() const {
+    QRect area;
+    int margin = width / 2 + 2;
+    switch (kind) {
+    case Pen:
+        // The curve may bulge past its points, never past its control points.
+        if (!points.isEmpty()) {
+            area = smoothStrokePath(points).controlPointRect().toAlignedRect().adjusted(0, 0, 1, 1);
+        }
+        break;
+    case Line:
+    case Arrow:
+        for (const QPoint& point : points) {
+            area = area.united(QRect(point, QSize(1, 1)));
+        }
+        if (kind == Arrow) {
+            margin += width * 5;
+        }
+        break;
+    case Rectangle:
+    case Ellipse:
+        area = rect.normalized();
+        break;
+    case Text: {
+        const QFontMetrics fm(font);
+        QPoint position = textOrigin;
+        for (const QString& line : text.split('\n')) {
+            area = area.united(fm.boundingRect(line).translated(position));
+            position.setY(position.y() + fm.height());
+        }
+        margin = 2;
+        break;
+    }
+    }
+    return area.isValid() ? area.adjusted(-margin, -margin, margin, margin) : QRect();
+}
+
+bool Annotation::hitTest(const QPoint& point, int tolerance) const {
+    if (!bounds().adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(point)) {
+        return false;
+    }
+    if (kind == Text) {
+        return true;
+    }
+
+    QPainterPathStroker stroker;
+    stroker.setWidth(width + tolerance * 2);
+    stroker.setCapStyle(Qt::RoundCap);
+    stroker.setJoinStyle(Qt::RoundJoin);
+    if (stroker.createStroke(outline(*this)).contains(point)) {
+        return true;
+    }
+    return kind == Arrow && points.size() == 2
+        && arrowHead(points.first(), points.last(), width).containsPoint(point, Qt::OddEvenFill);
+}
+
+void Annotation::translate(const QPoint& offset) {
+    for (QPoint& point : points) {
+        point += offset;
+    }
+    rect.translate(offset);
+    textOrigin += offset;
+}
+
+void Annotation::paint(QPainter& painter) const {
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(color, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter.setBrush(Qt::NoBrush);
+
+    switch (kind) {
+    case Pen:
+        if (points.size() == 1) {
+            painter.drawPoint(points.first());
+        }
+        else {
+            painter.drawPath(smoothStrokePath(points));
+        }
+        break;
+    case Rectangle:
+        painter.drawRect(rect);
+        break;
+    case Ellipse:
+        painter.drawEllipse(rect);
+        break;
+    case Line:
+        if (points.size() == 2) {
+            painter.drawLine(points.first(), points.last());
+        }
+        break;
+    case Arrow:
+        if (points.size() == 2) {
+            painter.drawLine(points.first(), points.last());
+            painter.setBrush(color);
+            painter.drawPolygon(arrowHead(points.first(), points.last(), width));
+        }
+        break;
+    case Text: {
+        painter.setFont(font);
+        painter.setPen(QPen(color));
+        const QFontMetrics fm(font);
+        QPoint position = textOrigin;
+        for (const QString& line : text.split('\n')) {
+            painter.drawText(position, line);
+            position.setY(position.y() + fm.height());
+        }
+        break;
+    }
+    }
+    painter.restore();
+}
+
+AnnotationScene::AnnotationScene()
+    : cacheBytes(0),
+    nextId(1) {
+}
+
+int AnnotationScene::add(Annotation annotation) {
+    annotation.id = nextId++;
+    restore(annotation);
+    return annotation.id;
+}
+
+void AnnotationScene::restore(const Annotation& annotation) {
+    remove(annotation.id);
+    shapes.insert(annotation.id, annotation);
+    const QRect bounds = annotation.bounds();
+    if (bounds.isValid()) {
+        index.insert(bounds, annotation.id);
+        extents.insert(annotation.id, bounds);
+    }
+    nextId = std::max(nextId, annotation.id + 1);
+}
+
+bool AnnotationScene::remove(int id) {
+    auto it = shapes.find(id);
+    if (it == shapes.end()) {
+        return false;
+    }
+    const QRect bounds = extents.take(id);
+    if (bounds.isValid()) {
+        index.remove(bounds, id);
+    }
+    shapes.erase(it);
+    invalidate(id);
+    return true;
+}
+
+void AnnotationScene::replace(const Annotation& annotation) {
+    if (shapes.contains(annotation.id)) {
+        restore(annotation);
+    }
+}
+
+void AnnotationScene::clear() {
+    shapes.clear();
+    extents.clear();
+    index.clear();
+    tiles.clear();
+    cacheBytes = 0;
+}
+
+const Annotation* AnnotationScene::find(int id) const {
+    auto it = shapes.constFind(id);
+    return it == shapes.constEnd() ? nullptr : &it.value();
+}
+
+QVector<int> AnnotationScene::shapesIn(const QRect& area) const {
+    QVector<int> ids = index.query(area);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool AnnotationScene::intersects(const QRect& area) const {
+    bool found = false;
+    index.search(area, [&found](int, const QRect&) {
+        found = true;
+    });
+    return found;
+}
+
+QRect AnnotationScene::boundsOf(int id) const {
+    return extents.value(id);
+}
+
+int AnnotationScene::topmostAt(const QPoint& point, int tolerance) const {
+    const QRect probe = QRect(point, QSize(1, 1)).adjusted(-tolerance, -tolerance, tolerance, tolerance);
+    const QVector<int> ids = shapesIn(probe);
+    for (auto it = ids.crbegin(); it != ids.crend(); ++it) {
+        if (shapes.constFind(*it)->hitTest(point, tolerance)) {
+            return *it;
+        }
+    }
+    return 0;
+}
+
+const QPixmap& AnnotationScene::tile(const Annotation& annotation, int column, int row, qreal ratio) {
+    QHash<quint64, QPixmap>& shapeTiles = tiles[annotation.id];
+    const quint64 key = tileKey(column, row, ratio);
+    auto it = shapeTiles.find(key);
+    if (it != shapeTiles.end()) {
+        return it.value();
+    }
+
+    if (cacheBytes > kTileCacheLimit) {
+        tiles.clear();
+        cacheBytes = 0;
+    }
+
+    // Rasterized at the density of the screen it is shown on, so shapes
+    // stay as sharp as the capture under them.
+    const int side = qCeil(TileSize * ratio);
+    QPixmap pixmap(side, side);
+    pixmap.setDevicePixelRatio(ratio);
+    pixmap.fill(Qt::transparent);
+    QPainter painter(&pixmap);
+    painter.translate(-column * TileSize, -row * TileSize);
+    annotation.paint(painter);
+    painter.end();
+
+    cacheBytes += tileBytes(pixmap);
+    return tiles[annotation.id].insert(key, pixmap).value();
+}
+
+void AnnotationScene::paint(QPainter& painter, const QRect& area) {
+    const qreal ratio = painter.device()->devicePixelRatioF();
+    for (int id : shapesIn(area)) {
+        const Annotation& annotation = shapes.constFind(id).value();
+        const QRect visible = extents.value(id).intersected(area);
+        if (visible.isEmpty()) {
+            continue;
+        }
+        const int firstColumn = static_cast<int>(std::floor(visible.left() / double(TileSize)));
+        const int lastColumn = static_cast<int>(std::floor(visible.right() / double(TileSize)));
+        const int firstRow = static_cast<int>(std::floor(visible.top() / double(TileSize)));
+        const int lastRow = static_cast<int>(std::floor(visible.bottom() / double(TileSize)));
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                const QRect tileRect(column * TileSize, row * TileSize, TileSize, TileSize);
+                const QRect target = tileRect.intersected(visible);
+                // The source rectangle is in tile pixels, ratio per layer pixel.
+                const QPoint offset = target.topLeft() - tileRect.topLeft();
+                const QRectF source(QPointF(offset) * ratio, QSizeF(target.size()) * ratio);
+                painter.drawPixmap(QRectF(target), tile(annotation, column, row, ratio), source);
+            }
+        }
+    }
+}
+
+void AnnotationScene::render(QPainter& painter, const QRect& area) const {
+    painter.save();
+    painter.setClipRect(area, Qt::IntersectClip);
+    for (int id : shapesIn(area)) {
+        shapes.constFind(id)->paint(painter);
+    }
+    painter.restore();
+}
+
+void AnnotationScene::invalidate(int id) {
+    auto it = tiles.find(id);
+    if (it == tiles.end()) {
+        return;
+    }
+    for (const QPixmap& tile : *it) {
+        cacheBytes -= tileBytes(tile);
+    }
+    tiles.erase(it);
+}
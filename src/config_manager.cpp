@@ -5,20 +5,54 @@
 #include <QJsonObject>
 #include <QDir>
 
+namespace {
+QJsonObject defaultConfig() {
+    QJsonObject config;
+    config["screenshot_hotkey"] = "Print";
+    config["fullscreen_hotkey"] = "Ctrl+Shift+Print";
+    config["window_hotkey"] = "Alt+Print";
+    config["file_extension"] = "png";
+    config["image_quality"] = 90;
+    config["default_save_folder"] = QDir::homePath() + "/Pictures/ScreenMe";
+    config["start_with_system"] = true;
+    config["skipVersion"] = "";
+    config["language"] = "en";
+    config["upload_rate_limit"] = 0;
+    config["upload_rate_limit_per_upload"] = 0;
+    config["upload_cache_size"] = 64;
+    config["update_check_delay_seconds"] = 30;
+    config["update_check_interval_hours"] = 24;
+    config["undo_memory_limit_mb"] = 256;
+    config["auto_trim"] = false;
+    config["trim_tolerance"] = 8;
+    return config;
+}
+}
+
 ConfigManager::ConfigManager(const QString& configPath) : configPath(configPath) {
     QString filePath = getConfigFilePath("config.json");
     QFile configFile(filePath);
     if (!configFile.exists()) {
-        QJsonObject defaultConfig;
-        defaultConfig["screenshot_hotkey"] = "Print";
-        defaultConfig["fullscreen_hotkey"] = "Ctrl+Shift+Print";
-        defaultConfig["file_extension"] = "png";
-        defaultConfig["image_quality"] = 90;
-        defaultConfig["default_save_folder"] = QDir::homePath() + "/Pictures/ScreenMe";
-        defaultConfig["start_with_system"] = true;
-        defaultConfig["skipVersion"] = "";
-        defaultConfig["language"] = "en";
-        saveConfig(defaultConfig);
+        saveConfig(defaultConfig());
+        return;
+    }
+
+    // Settings added by later versions get their defaults on existing
+    // installs too; values already present, even empty ones, are kept.
+    QJsonObject config = loadConfig();
+    if (config.isEmpty()) {
+        return;
+    }
+    bool changed = false;
+    const QJsonObject defaults = defaultConfig();
+    for (auto it = defaults.constBegin(); it != defaults.constEnd(); ++it) {
+        if (!config.contains(it.key())) {
+            config.insert(it.key(), it.value());
+            changed = true;
+        }
+    }
+    if (changed) {
+        saveConfig(config);
     }
 }
 
@@ -0,0 +1,69 @@
+#include "../include/delta_command.h"
+#include "../include/delta_patch.h"
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <iostream>
+
+namespace {
+
+bool readFile(const QString& path, QByteArray* data) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Unable to read " << path.toStdString() << std::endl;
+        return false;
+    }
+    *data = file.readAll();
+    return true;
+}
+
+}
+
+int runMakeDeltaCommand(const QStringList& arguments) {
+    const int index = arguments.indexOf(QStringLiteral("--make-delta"));
+    const QString oldPath = arguments.value(index + 1);
+    const QString newPath = arguments.value(index + 2);
+    const QString patchPath = arguments.value(index + 3);
+    if (index < 0 || oldPath.isEmpty() || newPath.isEmpty() || patchPath.isEmpty()) {
+        std::cerr << "Usage: ScreenMe --make-delta <old> <new> <patch>" << std::endl;
+        return 2;
+    }
+
+    QByteArray base;
+    QByteArray target;
+    if (!readFile(oldPath, &base) || !readFile(newPath, &target)) {
+        return 2;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray patch = createDeltaPatch(base, target);
+    const qint64 elapsed = timer.elapsed();
+
+    QFile output(patchPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(patch) != patch.size()) {
+        std::cerr << "Unable to write " << patchPath.toStdString() << std::endl;
+        return 2;
+    }
+    output.close();
+
+    // Round trip through the same code the client runs.
+    const QString checkPath = patchPath + QStringLiteral(".check");
+    QByteArray appliedSha256;
+    QString error;
+    const bool applied = applyDeltaPatch(oldPath, patch, checkPath, &appliedSha256, &error);
+    QFile::remove(checkPath);
+    const QByteArray targetSha256 = QCryptographicHash::hash(target, QCryptographicHash::Sha256).toHex();
+    if (!applied || appliedSha256 != targetSha256) {
+        std::cerr << "The patch does not reproduce " << newPath.toStdString()
+                  << (applied ? std::string() : ": " + error.toStdString()) << std::endl;
+        return 1;
+    }
+
+    const QByteArray patchSha256 = QCryptographicHash::hash(patch, QCryptographicHash::Sha256).toHex();
+    std::cout << patch.size() << " bytes for a " << target.size() << " byte target, " << elapsed << " ms" << std::endl;
+    std::cout << "  sha256 (patch):  " << patchSha256.constData() << std::endl;
+    std::cout << "  sha256 (target): " << targetSha256.constData() << std::endl;
+    return 0;
+}
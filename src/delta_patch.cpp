@@ -0,0 +1,460 @@
+#include "../include/delta_patch.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[] = "SMDELTA1";
+constexpr int kHeaderSize = 32;
+constexpr qint64 kWriteChunk = 64 * 1024;
+
+qint64 offtin(const uchar* buf) {
+    qint64 y = buf[7] & 0x7F;
+    for (int i = 6; i >= 0; --i) {
+        y = y * 256 + buf[i];
+    }
+    return (buf[7] & 0x80) ? -y : y;
+}
+
+void offtout(qint64 x, uchar* buf) {
+    quint64 y = static_cast<quint64>(x < 0 ? -x : x);
+    for (int i = 0; i < 8; ++i) {
+        buf[i] = static_cast<uchar>(y & 0xFF);
+        y >>= 8;
+    }
+    if (x < 0) {
+        buf[7] |= 0x80;
+    }
+}
+
+// Larsson-Sadakane suffix sorting, as in bsdiff: I ends up as the suffix
+// array of old (with the empty suffix first), V holds the group numbers.
+void split(qint64* I, qint64* V, qint64 start, qint64 length, qint64 h) {
+    if (length < 16) {
+        for (qint64 k = start, j = 1; k < start + length; k += j) {
+            j = 1;
+            qint64 x = V[I[k] + h];
+            for (qint64 i = 1; k + i < start + length; ++i) {
+                if (V[I[k + i] + h] < x) {
+                    x = V[I[k + i] + h];
+                    j = 0;
+                }
+                if (V[I[k + i] + h] == x) {
+                    std::swap(I[k + j], I[k + i]);
+                    ++j;
+                }
+            }
+            for (qint64 i = 0; i < j; ++i) {
+                V[I[k + i]] = k + j - 1;
+            }
+            if (j == 1) {
+                I[k] = -1;
+            }
+        }
+        return;
+    }
+
+    const qint64 x = V[I[start + length / 2] + h];
+    qint64 jj = 0;
+    qint64 kk = 0;
+    for (qint64 i = start; i < start + length; ++i) {
+        if (V[I[i] + h] < x) {
+            ++jj;
+        }
+        if (V[I[i] + h] == x) {
+            ++kk;
+        }
+    }
+    jj += start;
+    kk += jj;
+
+    qint64 i = start;
+    qint64 j = 0;
+    qint64 k = 0;
+    while (i < jj) {
+        if (V[I[i] + h] < x) {
+            ++i;
+        }
+        else if (V[I[i] + h] == x) {
+            std::swap(I[i], I[jj + j]);
+            ++j;
+        }
+        else {
+            std::swap(I[i], I[kk + k]);
+            ++k;
+        }
+    }
+    while (jj + j < kk) {
+        if (V[I[jj + j] + h] == x) {
+            ++j;
+        }
+        else {
+            std::swap(I[jj + j], I[kk + k]);
+            ++k;
+        }
+    }
+
+    if (jj > start) {
+        split(I, V, start, jj - start, h);
+    }
+    for (i = 0; i < kk - jj; ++i) {
+        V[I[jj + i]] = kk - 1;
+    }
+    if (jj == kk - 1) {
+        I[jj] = -1;
+    }
+    if (start + length > kk) {
+        split(I, V, kk, start + length - kk, h);
+    }
+}
+
+std::vector<qint64> suffixArray(const uchar* old, qint64 oldSize) {
+    std::vector<qint64> I(static_cast<size_t>(oldSize) + 1);
+    std::vector<qint64> V(static_cast<size_t>(oldSize) + 1);
+    qint64 buckets[256] = {};
+    for (qint64 i = 0; i < oldSize; ++i) {
+        ++buckets[old[i]];
+    }
+    for (int i = 1; i < 256; ++i) {
+        buckets[i] += buckets[i - 1];
+    }
+    for (int i = 255; i > 0; --i) {
+        buckets[i] = buckets[i - 1];
+    }
+    buckets[0] = 0;
+
+    for (qint64 i = 0; i < oldSize; ++i) {
+        I[++buckets[old[i]]] = i;
+    }
+    I[0] = oldSize;
+    for (qint64 i = 0; i < oldSize; ++i) {
+        V[i] = buckets[old[i]];
+    }
+    V[oldSize] = 0;
+    for (int i = 1; i < 256; ++i) {
+        if (buckets[i] == buckets[i - 1] + 1) {
+            I[buckets[i]] = -1;
+        }
+    }
+    I[0] = -1;
+
+    for (qint64 h = 1; I[0] != -(oldSize + 1); h += h) {
+        qint64 length = 0;
+        qint64 i = 0;
+        while (i < oldSize + 1) {
+            if (I[i] < 0) {
+                length -= I[i];
+                i -= I[i];
+            }
+            else {
+                if (length) {
+                    I[i - length] = -length;
+                }
+                length = V[I[i]] + 1 - i;
+                split(I.data(), V.data(), i, length, h);
+                i += length;
+                length = 0;
+            }
+        }
+        if (length) {
+            I[i - length] = -length;
+        }
+    }
+    for (qint64 i = 0; i < oldSize + 1; ++i) {
+        I[V[i]] = i;
+    }
+    return I;
+}
+
+qint64 matchLength(const uchar* a, qint64 aSize, const uchar* b, qint64 bSize) {
+    qint64 i = 0;
+    while (i < aSize && i < bSize && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// Longest prefix of target found in old, by binary search over the suffixes.
+qint64 search(const qint64* I, const uchar* old, qint64 oldSize, const uchar* target, qint64 targetSize,
+              qint64 first, qint64 last, qint64* position) {
+    while (last - first >= 2) {
+        const qint64 middle = first + (last - first) / 2;
+        if (std::memcmp(old + I[middle], target, static_cast<size_t>(std::min(oldSize - I[middle], targetSize))) < 0) {
+            first = middle;
+        }
+        else {
+            last = middle;
+        }
+    }
+    const qint64 x = matchLength(old + I[first], oldSize - I[first], target, targetSize);
+    const qint64 y = matchLength(old + I[last], oldSize - I[last], target, targetSize);
+    *position = x > y ? I[first] : I[last];
+    return std::max(x, y);
+}
+
+bool fail(QString* error, const QString& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+class HashedWriter {
+public:
+    explicit HashedWriter(QFile& file)
+        : file(file), hash(QCryptographicHash::Sha256) {
+        buffer.reserve(kWriteChunk);
+    }
+
+    void append(char byte) {
+        buffer.append(byte);
+        if (buffer.size() >= kWriteChunk) {
+            flush();
+        }
+    }
+
+    void append(const char* data, qint64 length) {
+        buffer.append(data, static_cast<int>(length));
+        if (buffer.size() >= kWriteChunk) {
+            flush();
+        }
+    }
+
+    bool flush() {
+        if (buffer.isEmpty()) {
+            return ok;
+        }
+        hash.addData(buffer);
+        ok = ok && file.write(buffer) == buffer.size();
+        buffer.clear();
+        return ok;
+    }
+
+    QByteArray digest() const { return hash.result().toHex(); }
+
+private:
+    QFile& file;
+    QCryptographicHash hash;
+    QByteArray buffer;
+    bool ok = true;
+};
+
+}
+
+bool applyDeltaPatch(const QString& basePath, const QByteArray& patch, const QString& outputPath,
+                     QByteArray* sha256Hex, QString* error) {
+    if (patch.size() < kHeaderSize || !patch.startsWith(kMagic)) {
+        return fail(error, QStringLiteral("Not a ScreenMe delta patch"));
+    }
+
+    const uchar* header = reinterpret_cast<const uchar*>(patch.constData());
+    const qint64 ctrlSize = offtin(header + 8);
+    const qint64 diffSize = offtin(header + 16);
+    const qint64 newSize = offtin(header + 24);
+    if (ctrlSize < 0 || diffSize < 0 || newSize < 0 || kHeaderSize + ctrlSize + diffSize > patch.size()) {
+        return fail(error, QStringLiteral("Corrupt delta header"));
+    }
+
+    const QByteArray ctrl = qUncompress(patch.mid(kHeaderSize, static_cast<int>(ctrlSize)));
+    const QByteArray diff = qUncompress(patch.mid(kHeaderSize + static_cast<int>(ctrlSize), static_cast<int>(diffSize)));
+    const QByteArray extra = qUncompress(patch.mid(kHeaderSize + static_cast<int>(ctrlSize + diffSize)));
+    if (ctrl.size() % 24 != 0) {
+        return fail(error, QStringLiteral("Corrupt delta control block"));
+    }
+
+    QFile baseFile(basePath);
+    if (!baseFile.open(QIODevice::ReadOnly)) {
+        return fail(error, QStringLiteral("Unable to open %1").arg(basePath));
+    }
+    const qint64 oldSize = baseFile.size();
+    QByteArray baseFallback;
+    const uchar* oldData = oldSize > 0 ? baseFile.map(0, oldSize) : nullptr;
+    if (!oldData && oldSize > 0) {
+        baseFallback = baseFile.readAll();
+        oldData = reinterpret_cast<const uchar*>(baseFallback.constData());
+    }
+
+    QFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return fail(error, QStringLiteral("Unable to write %1").arg(outputPath));
+    }
+    HashedWriter writer(output);
+
+    const uchar* ctrlData = reinterpret_cast<const uchar*>(ctrl.constData());
+    const uchar* diffData = reinterpret_cast<const uchar*>(diff.constData());
+    qint64 ctrlPos = 0;
+    qint64 diffPos = 0;
+    qint64 extraPos = 0;
+    qint64 oldPos = 0;
+    qint64 newPos = 0;
+
+    while (newPos < newSize) {
+        if (ctrlPos + 24 > ctrl.size()) {
+            return fail(error, QStringLiteral("Delta control block ended early"));
+        }
+        const qint64 addLength = offtin(ctrlData + ctrlPos);
+        const qint64 copyLength = offtin(ctrlData + ctrlPos + 8);
+        const qint64 seek = offtin(ctrlData + ctrlPos + 16);
+        ctrlPos += 24;
+
+        if (addLength < 0 || copyLength < 0 || newPos + addLength + copyLength > newSize
+            || diffPos + addLength > diff.size() || extraPos + copyLength > extra.size()) {
+            return fail(error, QStringLiteral("Corrupt delta control entry"));
+        }
+
+        for (qint64 i = 0; i < addLength; ++i) {
+            const qint64 source = oldPos + i;
+            const uchar base = (source >= 0 && source < oldSize) ? oldData[source] : 0;
+            writer.append(static_cast<char>(diffData[diffPos + i] + base));
+        }
+        diffPos += addLength;
+        oldPos += addLength;
+        newPos += addLength;
+
+        writer.append(extra.constData() + extraPos, copyLength);
+        extraPos += copyLength;
+        newPos += copyLength;
+
+        oldPos += seek;
+    }
+
+    if (!writer.flush()) {
+        return fail(error, QStringLiteral("Unable to write %1").arg(outputPath));
+    }
+    output.close();
+
+    if (sha256Hex) {
+        *sha256Hex = writer.digest();
+    }
+    return true;
+}
+
+QByteArray createDeltaPatch(const QByteArray& base, const QByteArray& target) {
+    const uchar* old = reinterpret_cast<const uchar*>(base.constData());
+    const uchar* next = reinterpret_cast<const uchar*>(target.constData());
+    const qint64 oldSize = base.size();
+    const qint64 newSize = target.size();
+    const std::vector<qint64> I = suffixArray(old, oldSize);
+
+    QByteArray ctrl;
+    QByteArray diff;
+    QByteArray extra;
+    diff.reserve(static_cast<int>(newSize));
+    uchar triple[24];
+
+    qint64 scan = 0;
+    qint64 length = 0;
+    qint64 position = 0;
+    qint64 lastScan = 0;
+    qint64 lastPosition = 0;
+    qint64 lastOffset = 0;
+    while (scan < newSize) {
+        qint64 oldScore = 0;
+        qint64 scored = scan += length;
+        // Moves forward until an exact match is found that is clearly better
+        // than just continuing the previous alignment.
+        for (; scan < newSize; ++scan) {
+            length = search(I.data(), old, oldSize, next + scan, newSize - scan, 0, oldSize, &position);
+            for (; scored < scan + length; ++scored) {
+                if (scored + lastOffset < oldSize && old[scored + lastOffset] == next[scored]) {
+                    ++oldScore;
+                }
+            }
+            if ((length == oldScore && length != 0) || length > oldScore + 8) {
+                break;
+            }
+            if (scan + lastOffset < oldSize && old[scan + lastOffset] == next[scan]) {
+                --oldScore;
+            }
+        }
+
+        if (length == oldScore && scan != newSize) {
+            continue;
+        }
+
+        // Extends the previous match forward and this one backward as far as
+        // at least half the bytes still agree.
+        qint64 score = 0;
+        qint64 bestForward = 0;
+        qint64 forward = 0;
+        for (qint64 i = 0; lastScan + i < scan && lastPosition + i < oldSize;) {
+            if (old[lastPosition + i] == next[lastScan + i]) {
+                ++score;
+            }
+            ++i;
+            if (score * 2 - i > bestForward * 2 - forward) {
+                bestForward = score;
+                forward = i;
+            }
+        }
+
+        qint64 backward = 0;
+        if (scan < newSize) {
+            score = 0;
+            qint64 bestBackward = 0;
+            for (qint64 i = 1; scan >= lastScan + i && position >= i; ++i) {
+                if (old[position - i] == next[scan - i]) {
+                    ++score;
+                }
+                if (score * 2 - i > bestBackward * 2 - backward) {
+                    bestBackward = score;
+                    backward = i;
+                }
+            }
+        }
+
+        // Overlapping extensions are split where the split scores best.
+        if (lastScan + forward > scan - backward) {
+            const qint64 overlap = (lastScan + forward) - (scan - backward);
+            score = 0;
+            qint64 bestSplit = 0;
+            qint64 split = 0;
+            for (qint64 i = 0; i < overlap; ++i) {
+                if (next[lastScan + forward - overlap + i] == old[lastPosition + forward - overlap + i]) {
+                    ++score;
+                }
+                if (next[scan - backward + i] == old[position - backward + i]) {
+                    --score;
+                }
+                if (score > bestSplit) {
+                    bestSplit = score;
+                    split = i + 1;
+                }
+            }
+            forward += split - overlap;
+            backward -= split;
+        }
+
+        for (qint64 i = 0; i < forward; ++i) {
+            diff.append(static_cast<char>(next[lastScan + i] - old[lastPosition + i]));
+        }
+        const qint64 copy = (scan - backward) - (lastScan + forward);
+        extra.append(reinterpret_cast<const char*>(next + lastScan + forward), static_cast<int>(copy));
+
+        offtout(forward, triple);
+        offtout(copy, triple + 8);
+        offtout((position - backward) - (lastPosition + forward), triple + 16);
+        ctrl.append(reinterpret_cast<const char*>(triple), sizeof(triple));
+
+        lastScan = scan - backward;
+        lastPosition = position - backward;
+        lastOffset = position - scan;
+    }
+
+    const QByteArray ctrlBlock = qCompress(ctrl, 9);
+    const QByteArray diffBlock = qCompress(diff, 9);
+    const QByteArray extraBlock = qCompress(extra, 9);
+    QByteArray patch(kHeaderSize, '\0');
+    std::memcpy(patch.data(), kMagic, 8);
+    uchar* header = reinterpret_cast<uchar*>(patch.data());
+    offtout(ctrlBlock.size(), header + 8);
+    offtout(diffBlock.size(), header + 16);
+    offtout(newSize, header + 24);
+    patch.append(ctrlBlock);
+    patch.append(diffBlock);
+    patch.append(extraBlock);
+    return patch;
+}
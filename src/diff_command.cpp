@@ -0,0 +1,54 @@
+#include "../include/diff_command.h"
+#include "../include/image_diff.h"
+#include <QElapsedTimer>
+#include <QImage>
+#include <QStringList>
+#include <iostream>
+
+int runDiffCommand(const QStringList& arguments) {
+    const int index = arguments.indexOf(QStringLiteral("--diff"));
+    const QString beforePath = arguments.value(index + 1);
+    const QString afterPath = arguments.value(index + 2);
+    if (index < 0 || beforePath.isEmpty() || afterPath.isEmpty()) {
+        std::cerr << "Usage: ScreenMe --diff <before> <after> [--threshold N] [--mask out.png]" << std::endl;
+        return 2;
+    }
+
+    int threshold = ImageDiff::kDefaultThreshold;
+    const int thresholdIndex = arguments.indexOf(QStringLiteral("--threshold"));
+    if (thresholdIndex >= 0) {
+        bool ok = false;
+        threshold = arguments.value(thresholdIndex + 1).toInt(&ok);
+        if (!ok || threshold < 1 || threshold > 255) {
+            std::cerr << "--threshold expects a value from 1 to 255" << std::endl;
+            return 2;
+        }
+    }
+    const int maskIndex = arguments.indexOf(QStringLiteral("--mask"));
+    const QString maskPath = maskIndex >= 0 ? arguments.value(maskIndex + 1) : QString();
+
+    const QImage before(beforePath);
+    const QImage after(afterPath);
+    if (before.isNull() || after.isNull()) {
+        std::cerr << "Unable to read " << (before.isNull() ? beforePath : afterPath).toStdString() << std::endl;
+        return 2;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const ImageDiff diff = ImageDiff::compute(before, after, threshold);
+    const qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+    const qint64 total = static_cast<qint64>(diff.size().width()) * diff.size().height();
+    std::cout << diff.regions().size() << " changed regions, " << diff.changedPixels() << " of " << total
+              << " pixels, threshold " << threshold << ", " << elapsed / 1000.0 << " ms" << std::endl;
+    for (const QRect& region : diff.regions()) {
+        std::cout << "  " << region.x() << "," << region.y() << " " << region.width() << "x" << region.height() << std::endl;
+    }
+
+    if (!maskPath.isEmpty() && !diff.maskImage().save(maskPath)) {
+        std::cerr << "Unable to write " << maskPath.toStdString() << std::endl;
+        return 2;
+    }
+    return diff.changedPixels() == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#include "../include/edge_map.h"
+#include "../include/pixel_ops.h"
+#include "../include/simd.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+constexpr int kWordBits = 64;
+
+inline uchar lumaOf(quint32 pixel) {
+    return static_cast<uchar>((((pixel >> 16) & 0xFF) * 77 + ((pixel >> 8) & 0xFF) * 150 + (pixel & 0xFF) * 29) >> 8);
+}
+
+void lumaRow(const quint32* pixels, uchar* luma, int width) {
+    for (int x = 0; x < width; ++x) {
+        luma[x] = lumaOf(pixels[x]);
+    }
+}
+
+// Sets bit i of bits for every i in [0, count) where |a[i] - b[i]| >= threshold.
+void markSteps(const uchar* a, const uchar* b, int count, uchar threshold, quint64* bits) {
+    int i = 0;
+#ifdef SCREENME_HAVE_SSE2
+    // Sixteen bytes at a time: saturating differences both ways give |a - b|,
+    // and one more saturating subtract leaves non-zero lanes for the steps.
+    const __m128i below = _mm_set1_epi8(static_cast<char>(threshold - 1));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const __m128i difference = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        const __m128i flat = _mm_cmpeq_epi8(_mm_subs_epu8(difference, below), zero);
+        const quint64 mask = static_cast<quint64>(~_mm_movemask_epi8(flat) & 0xFFFF);
+        bits[i / kWordBits] |= mask << (i % kWordBits);
+    }
+#endif
+    for (; i < count; ++i) {
+        if (std::abs(int(a[i]) - int(b[i])) >= threshold) {
+            bits[i / kWordBits] |= quint64(1) << (i % kWordBits);
+        }
+    }
+}
+
+// Calls step(offset) so that windows of one row grow to exactly length by
+// doubling: 1, 2, 4, ... and a final overlapping step.
+template <typename Step>
+void growWindow(int length, Step step) {
+    int window = 1;
+    while (window * 2 <= length) {
+        step(window);
+        window *= 2;
+    }
+    if (window < length) {
+        step(length - window);
+    }
+}
+
+// Keeps the bits that lie on a vertical run of at least length set bits: an
+// AND over the next rows (erosion) followed by an OR over the previous ones
+// (dilation), word columns [first, last) only.
+void keepColumnRuns(quint64* plane, int stride, int height, int length, int first, int last) {
+    growWindow(length, [=](int offset) {
+        for (int y = 0; y < height; ++y) {
+            quint64* row = plane + static_cast<qint64>(y) * stride;
+            const quint64* next = y + offset < height ? row + static_cast<qint64>(offset) * stride : nullptr;
+            for (int w = first; w < last; ++w) {
+                row[w] &= next ? next[w] : 0;
+            }
+        }
+    });
+    growWindow(length, [=](int offset) {
+        for (int y = height - 1; y >= offset; --y) {
+            quint64* row = plane + static_cast<qint64>(y) * stride;
+            const quint64* previous = row - static_cast<qint64>(offset) * stride;
+            for (int w = first; w < last; ++w) {
+                row[w] |= previous[w];
+            }
+        }
+    });
+}
+
+// Same along one row of bits; offsets stay below kWordBits.
+void keepRowRuns(quint64* row, int words, int length) {
+    growWindow(length, [=](int offset) {
+        for (int w = 0; w < words; ++w) {
+            const quint64 next = w + 1 < words ? row[w + 1] : 0;
+            row[w] &= (row[w] >> offset) | (next << (kWordBits - offset));
+        }
+    });
+    growWindow(length, [=](int offset) {
+        for (int w = words - 1; w >= 0; --w) {
+            const quint64 previous = w > 0 ? row[w - 1] : 0;
+            row[w] |= (row[w] << offset) | (previous >> (kWordBits - offset));
+        }
+    });
+}
+
+}
+
+EdgeMap EdgeMap::build(const QImage& source, int threshold, int minLength) {
+    EdgeMap map;
+    if (source.width() < 2 || source.height() < 2) {
+        return map;
+    }
+    const QImage image = source.depth() == 32 ? source : source.convertToFormat(QImage::Format_RGB32);
+    const uchar step = static_cast<uchar>(std::clamp(threshold, 1, 255));
+    const int length = std::clamp(minLength, 2, kWordBits);
+
+    map.width = image.width();
+    map.height = image.height();
+    map.stride = (map.width + kWordBits - 1) / kWordBits;
+    map.vertical.assign(static_cast<size_t>(map.stride) * map.height, 0);
+    map.horizontal.assign(static_cast<size_t>(map.stride) * map.height, 0);
+
+    const int width = map.width;
+    const int stride = map.stride;
+    const qint64 pixels = static_cast<qint64>(map.width) * map.height;
+
+    // Luma steps, by row bands; each band recomputes the row above it.
+    parallelFor(map.height, pixels, [&](int begin, int end) {
+        std::vector<uchar> previous(width);
+        std::vector<uchar> current(width);
+        if (begin > 0) {
+            lumaRow(reinterpret_cast<const quint32*>(image.constScanLine(begin - 1)), previous.data(), width);
+        }
+        for (int y = begin; y < end; ++y) {
+            lumaRow(reinterpret_cast<const quint32*>(image.constScanLine(y)), current.data(), width);
+            markSteps(current.data() + 1, current.data(), width - 1, step, &map.vertical[static_cast<size_t>(y) * stride]);
+            if (y > 0) {
+                markSteps(current.data(), previous.data(), width, step, &map.horizontal[static_cast<size_t>(y) * stride]);
+            }
+            current.swap(previous);
+        }
+    });
+
+    // Vertical edges run down the columns, horizontal ones along the rows.
+    quint64* vertical = map.vertical.data();
+    const int height = map.height;
+    parallelFor(stride, pixels, [=](int begin, int end) {
+        keepColumnRuns(vertical, stride, height, length, begin, end);
+    });
+    quint64* horizontal = map.horizontal.data();
+    parallelFor(height, pixels, [=](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            keepRowRuns(horizontal + static_cast<qint64>(y) * stride, stride, length);
+        }
+    });
+    return map;
+}
+
+bool EdgeMap::test(const std::vector<quint64>& plane, int bit, int row) const {
+    if (bit < 0 || bit >= width || row < 0 || row >= height) {
+        return false;
+    }
+    return (plane[static_cast<size_t>(row) * stride + bit / kWordBits] >> (bit % kWordBits)) & 1;
+}
+
+int EdgeMap::nearestVertical(int x, int y, int radius) const {
+    for (int d = 0; d <= radius; ++d) {
+        if (test(vertical, x - d - 1, y)) {
+            return x - d;
+        }
+        if (d > 0 && test(vertical, x + d - 1, y)) {
+            return x + d;
+        }
+    }
+    return -1;
+}
+
+int EdgeMap::nearestHorizontal(int x, int y, int radius) const {
+    for (int d = 0; d <= radius; ++d) {
+        if (test(horizontal, x, y - d)) {
+            return y - d;
+        }
+        if (d > 0 && test(horizontal, x, y + d)) {
+            return y + d;
+        }
+    }
+    return -1;
+}
+
+std::shared_ptr<EdgeMapBuild> EdgeMapBuild::start(const QImage& image, QObject* receiver, Callback done) {
+    std::shared_ptr<EdgeMapBuild> build(new EdgeMapBuild());
+    QThread* thread = QThread::create([build, image, receiver, done]() {
+        std::shared_ptr<const EdgeMap> map = std::make_shared<const EdgeMap>(EdgeMap::build(image));
+        // Posting under the lock means cancel() either wins or the event is
+        // queued while the receiver is alive; events for a deleted receiver
+        // are dropped by Qt.
+        QMutexLocker locker(&build->mutex);
+        if (build->cancelled) {
+            return;
+        }
+        QMetaObject::invokeMethod(receiver, [build, map, done]() {
+            if (!build->isCancelled()) {
+                done(map);
+            }
+        }, Qt::QueuedConnection);
+    });
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start(QThread::LowPriority);
+    return build;
+}
+
+void EdgeMapBuild::cancel() {
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+}
+
+bool EdgeMapBuild::isCancelled() {
+    QMutexLocker locker(&mutex);
+    return cancelled;
+}
@@ -97,6 +97,9 @@ Editor::Editor(QWidget* parent)
     createToolButton(tr("Ellipse"), Ellipse, QIcon(":/resources/icons/ellipse.png"));
     createToolButton(tr("Line"), Line, QIcon(":/resources/icons/line.png"));
     createToolButton(tr("Arrow"), Arrow, QIcon(":/resources/icons/arrow.png"));
+    createToolButton(tr("Pixelate"), Pixelate, QIcon(":/resources/icons/pixelate.png"));
+    createToolButton(tr("Blur"), Blur, QIcon(":/resources/icons/blur.png"));
+    createToolButton(tr("Select"), Select, QIcon(":/resources/icons/select.png"));
 
     addDivider();
 
@@ -113,6 +116,7 @@ Editor::Editor(QWidget* parent)
     createActionButton(tr("Upload"), QIcon(":/resources/icons/upload.png"), "publishRequested");
     QIcon printIcon = QApplication::style()->standardIcon(QStyle::SP_FileDialogDetailedView);
     createActionButton(tr("Print"), printIcon, "printRequested");
+    createActionButton(tr("Scrolling capture"), QIcon(":/resources/icons/scroll_capture.png"), "scrollCaptureRequested");
     createActionButton(tr("Search"), QIcon(":/resources/icons/search.png"), "searchRequested");
     createActionButton(tr("Close"), QIcon(":/resources/icons/close.png"), "closeRequested");
 }
@@ -0,0 +1,198 @@
+#include "../include/image_diff.h"
+#include "../include/pixel_ops.h"
+#include "../include/simd.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+constexpr int kWordBits = 64;
+// Cluster cell edge; two cells per bit-plane word.
+constexpr int kCellSize = 32;
+
+// Both sides as 32-bit pixels with the same channel layout.
+QImage comparable(const QImage& image) {
+    if (image.isNull() || image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32) {
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_ARGB32);
+}
+
+// Sets bit i of bits for every pixel i in [0, count) where a channel of a and
+// b differs by at least threshold.
+void diffRow(const quint32* a, const quint32* b, int count, uchar threshold, quint64* bits) {
+    int i = 0;
+#ifdef SCREENME_HAVE_SSE2
+    // |a - b| per byte from two saturating subtracts; subtracting
+    // threshold - 1 leaves a non-zero byte where a channel changed enough,
+    // and a non-zero 32-bit lane marks the pixel.
+    const __m128i below = _mm_set1_epi8(static_cast<char>(threshold - 1));
+    const __m128i zero = _mm_setzero_si128();
+    auto changedLanes = [&](int at) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + at));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + at));
+        const __m128i difference = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        const __m128i same = _mm_cmpeq_epi32(_mm_subs_epu8(difference, below), zero);
+        return ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xF;
+    };
+    // Sixteen pixels per step, so the unchanged case is one test per step.
+    for (; i + 16 <= count; i += 16) {
+        const int mask = changedLanes(i) | changedLanes(i + 4) << 4 | changedLanes(i + 8) << 8 | changedLanes(i + 12) << 12;
+        if (mask) {
+            bits[i / kWordBits] |= static_cast<quint64>(mask) << (i % kWordBits);
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        const int mask = changedLanes(i);
+        if (mask) {
+            bits[i / kWordBits] |= static_cast<quint64>(mask) << (i % kWordBits);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const quint32 x = a[i];
+        const quint32 y = b[i];
+        for (int shift = 0; shift < 32; shift += 8) {
+            if (std::abs(int((x >> shift) & 0xFF) - int((y >> shift) & 0xFF)) >= threshold) {
+                bits[i / kWordBits] |= quint64(1) << (i % kWordBits);
+                break;
+            }
+        }
+    }
+}
+
+// Sets bits [first, last) of a row.
+void setRange(quint64* bits, int first, int last) {
+    for (int i = first; i < last; ++i) {
+        bits[i / kWordBits] |= quint64(1) << (i % kWordBits);
+    }
+}
+
+}
+
+ImageDiff ImageDiff::compute(const QImage& beforeSource, const QImage& afterSource, int threshold) {
+    ImageDiff diff;
+    const QImage before = comparable(beforeSource);
+    const QImage after = comparable(afterSource);
+    diff.width = std::max(before.width(), after.width());
+    diff.height = std::max(before.height(), after.height());
+    if (diff.width == 0 || diff.height == 0) {
+        diff.width = 0;
+        diff.height = 0;
+        return diff;
+    }
+    diff.stride = (diff.width + kWordBits - 1) / kWordBits;
+    diff.bits.assign(static_cast<size_t>(diff.stride) * diff.height, 0);
+
+    const bool both = !before.isNull() && !after.isNull();
+    const int commonWidth = both ? std::min(before.width(), after.width()) : 0;
+    const int commonHeight = both ? std::min(before.height(), after.height()) : 0;
+    const uchar step = static_cast<uchar>(std::clamp(threshold, 1, 255));
+
+    const int columns = (diff.width + kCellSize - 1) / kCellSize;
+    const int rows = (diff.height + kCellSize - 1) / kCellSize;
+    std::vector<QRect> cells(static_cast<size_t>(columns) * rows);
+    std::vector<qint64> counts(rows, 0);
+
+    // One band of cell rows per task, so a cell is only ever touched by one
+    // thread; its exact bounds are gathered while the row is still hot.
+    const int width = diff.width;
+    const int height = diff.height;
+    const int stride = diff.stride;
+    quint64* plane = diff.bits.data();
+    parallelFor(rows, static_cast<qint64>(width) * height, [&](int begin, int end) {
+        for (int cellRow = begin; cellRow < end; ++cellRow) {
+            qint64 count = 0;
+            const int last = std::min(height, (cellRow + 1) * kCellSize);
+            for (int y = cellRow * kCellSize; y < last; ++y) {
+                quint64* row = plane + static_cast<qint64>(y) * stride;
+                if (y < commonHeight) {
+                    diffRow(reinterpret_cast<const quint32*>(before.constScanLine(y)),
+                            reinterpret_cast<const quint32*>(after.constScanLine(y)), commonWidth, step, row);
+                    setRange(row, commonWidth, width);
+                }
+                else {
+                    setRange(row, 0, width);
+                }
+                for (int w = 0; w < stride; ++w) {
+                    const quint64 word = row[w];
+                    if (!word) {
+                        continue;
+                    }
+                    count += qPopulationCount(word);
+                    for (int half = 0; half < 2; ++half) {
+                        const quint32 part = static_cast<quint32>(word >> (half * kCellSize));
+                        const int column = w * 2 + half;
+                        if (!part || column >= columns) {
+                            continue;
+                        }
+                        const int left = column * kCellSize + static_cast<int>(qCountTrailingZeroBits(part));
+                        const int right = column * kCellSize + 31 - static_cast<int>(qCountLeadingZeroBits(part));
+                        QRect& cell = cells[static_cast<size_t>(cellRow) * columns + column];
+                        cell = cell.united(QRect(QPoint(left, y), QPoint(right, y)));
+                    }
+                }
+            }
+            counts[cellRow] = count;
+        }
+    });
+
+    for (qint64 count : counts) {
+        diff.changed += count;
+    }
+    diff.cluster(cells, columns, rows);
+    return diff;
+}
+
+// Touching changed cells (8-neighbourhood) form one region; its box is the
+// union of the cells' exact bounds.
+void ImageDiff::cluster(const std::vector<QRect>& cells, int columns, int rows) {
+    std::vector<bool> visited(cells.size(), false);
+    std::vector<int> stack;
+    for (int start = 0; start < static_cast<int>(cells.size()); ++start) {
+        if (visited[start] || cells[start].isNull()) {
+            continue;
+        }
+        QRect box;
+        visited[start] = true;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            const int index = stack.back();
+            stack.pop_back();
+            box = box.united(cells[index]);
+            const int cx = index % columns;
+            const int cy = index / columns;
+            for (int ny = std::max(0, cy - 1); ny <= std::min(rows - 1, cy + 1); ++ny) {
+                for (int nx = std::max(0, cx - 1); nx <= std::min(columns - 1, cx + 1); ++nx) {
+                    const int neighbour = ny * columns + nx;
+                    if (!visited[neighbour] && !cells[neighbour].isNull()) {
+                        visited[neighbour] = true;
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+        }
+        boxes.append(box);
+    }
+}
+
+QImage ImageDiff::maskImage() const {
+    if (isNull()) {
+        return QImage();
+    }
+    QImage mask(width, height, QImage::Format_Grayscale8);
+    mask.fill(0);
+    for (int y = 0; y < height; ++y) {
+        uchar* line = mask.scanLine(y);
+        const quint64* row = bits.data() + static_cast<qint64>(y) * stride;
+        for (int w = 0; w < stride; ++w) {
+            quint64 word = row[w];
+            while (word) {
+                line[w * kWordBits + qCountTrailingZeroBits(word)] = 255;
+                word &= word - 1;
+            }
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,113 @@
+#include "../include/mipmap_pyramid.h"
+#include "../include/pixel_ops.h"
+#include "../include/simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Rounded average of four pixels, per channel.
+inline quint32 average(quint32 a, quint32 b, quint32 c, quint32 d) {
+    quint32 result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const quint32 sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+        result |= ((sum + 2) >> 2) << shift;
+    }
+    return result;
+}
+
+// Halves two source rows into one: every output pixel is the average of a
+// 2x2 block. The last column of an odd width averages with itself.
+void halveRow(const quint32* upper, const quint32* lower, int sourceWidth, quint32* out) {
+    const int pairs = sourceWidth / 2;
+    int x = 0;
+#ifdef SCREENME_HAVE_SSE2
+    // Channels widened to 16 bits, so the four-pixel sums cannot overflow.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    auto halveFour = [&](int at) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + at * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + at * 2));
+        const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        // Each 128-bit lane holds two horizontally adjacent sums; adding the
+        // upper half onto the lower one finishes the 2x2 block.
+        const __m128i left = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+        const __m128i right = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+        const __m128i sums = _mm_unpacklo_epi64(left, right);
+        return _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+    };
+    for (; x + 4 <= pairs; x += 4) {
+        const __m128i packed = _mm_packus_epi16(halveFour(x), halveFour(x + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), packed);
+    }
+#endif
+    for (; x < pairs; ++x) {
+        out[x] = average(upper[x * 2], upper[x * 2 + 1], lower[x * 2], lower[x * 2 + 1]);
+    }
+    if (sourceWidth % 2) {
+        const int last = sourceWidth - 1;
+        out[pairs] = average(upper[last], upper[last], lower[last], lower[last]);
+    }
+}
+
+QImage halve(const QImage& source) {
+    const int width = (source.width() + 1) / 2;
+    const int height = (source.height() + 1) / 2;
+    QImage result(width, height, source.format());
+    if (result.isNull()) {
+        return result;
+    }
+    const int sourceWidth = source.width();
+    const int lastRow = source.height() - 1;
+    parallelFor(height, static_cast<qint64>(sourceWidth) * source.height(), [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            halveRow(reinterpret_cast<const quint32*>(source.constScanLine(y * 2)),
+                     reinterpret_cast<const quint32*>(source.constScanLine(std::min(y * 2 + 1, lastRow))),
+                     sourceWidth, reinterpret_cast<quint32*>(result.scanLine(y)));
+        }
+    });
+    return result;
+}
+
+}
+
+void MipmapPyramid::reset(const QImage& image) {
+    clear();
+    if (image.isNull()) {
+        return;
+    }
+    levels.append(image.depth() == 32 ? image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+    for (int side = std::max(image.width(), image.height()); side > 1; side = (side + 1) / 2) {
+        ++top;
+    }
+}
+
+void MipmapPyramid::clear() {
+    levels.clear();
+    top = 0;
+}
+
+const QImage& MipmapPyramid::level(int index) {
+    index = std::clamp(index, 0, top);
+    while (levels.size() <= index) {
+        levels.append(halve(levels.last()));
+    }
+    return levels[index];
+}
+
+int MipmapPyramid::levelFor(qreal scale) {
+    if (scale >= 1.0 || scale <= 0.0) {
+        return 0;
+    }
+    // The small bias keeps exact powers of two on their own level.
+    return static_cast<int>(std::floor(std::log2(1.0 / scale) + 1e-9));
+}
+
+qint64 MipmapPyramid::memoryUsage() const {
+    qint64 bytes = 0;
+    for (int i = 1; i < levels.size(); ++i) {
+        bytes += levels[i].sizeInBytes();
+    }
+    return bytes;
+}
@@ -46,6 +46,18 @@ OptionsWindow::OptionsWindow(ConfigManager* configManager, QWidget* parent)
     fullscreenHotkeyEdit->installEventFilter(this);  // Install event filter
     layout->addWidget(fullscreenHotkeyEdit);
 
+    QLabel* windowHotkeyLabel = new QLabel(tr("Active Window Hotkey:"), this);
+    layout->addWidget(windowHotkeyLabel);
+    windowHotkeyEdit = new QLineEdit(this);
+    windowHotkeyEdit->setPlaceholderText(tr("Press any key..."));
+#ifdef Q_OS_WIN
+    windowHotkeyEdit->setReadOnly(true);
+#else
+    windowHotkeyEdit->setReadOnly(false);
+#endif
+    windowHotkeyEdit->installEventFilter(this);  // Install event filter
+    layout->addWidget(windowHotkeyEdit);
+
     QLabel* extensionLabel = new QLabel(tr("File Extension:"), this);
     layout->addWidget(extensionLabel);
     extensionCombo = new QComboBox(this);
@@ -72,6 +84,28 @@ OptionsWindow::OptionsWindow(ConfigManager* configManager, QWidget* parent)
     languageCombo->addItem(tr("Français"), QStringLiteral("fr_FR"));
     layout->addWidget(languageCombo);
 
+    QLabel* uploadLimitLabel = new QLabel(tr("Total upload limit (KB/s, 0 = unlimited):"), this);
+    layout->addWidget(uploadLimitLabel);
+    uploadLimitSpinbox = new QSpinBox(this);
+    uploadLimitSpinbox->setRange(0, 1024 * 1024);
+    layout->addWidget(uploadLimitSpinbox);
+
+    QLabel* perUploadLimitLabel = new QLabel(tr("Per upload limit (KB/s, 0 = unlimited):"), this);
+    layout->addWidget(perUploadLimitLabel);
+    perUploadLimitSpinbox = new QSpinBox(this);
+    perUploadLimitSpinbox->setRange(0, 1024 * 1024);
+    layout->addWidget(perUploadLimitSpinbox);
+
+    autoTrimCheckbox = new QCheckBox(tr("Trim uniform borders on export"), this);
+    layout->addWidget(autoTrimCheckbox);
+
+    QLabel* trimToleranceLabel = new QLabel(tr("Trim tolerance (per channel):"), this);
+    layout->addWidget(trimToleranceLabel);
+    trimToleranceSpinbox = new QSpinBox(this);
+    trimToleranceSpinbox->setRange(0, 64);
+    layout->addWidget(trimToleranceSpinbox);
+    connect(autoTrimCheckbox, &QCheckBox::toggled, trimToleranceSpinbox, &QSpinBox::setEnabled);
+
     startWithSystemCheckbox = new QCheckBox(tr("Start with system"), this);
 #ifndef Q_OS_WIN
     startWithSystemCheckbox->setVisible(false);
@@ -98,10 +132,16 @@ void OptionsWindow::loadOptions() {
     QJsonObject config = configManager->loadConfig();
     hotkeyEdit->setText(config["screenshot_hotkey"].toString());
     fullscreenHotkeyEdit->setText(config["fullscreen_hotkey"].toString());
+    windowHotkeyEdit->setText(config["window_hotkey"].toString());
     extensionCombo->setCurrentText(config["file_extension"].toString());
     qualitySpinbox->setValue(config["image_quality"].toInt());
     folderEdit->setText(config["default_save_folder"].toString());
+    uploadLimitSpinbox->setValue(static_cast<int>(config["upload_rate_limit"].toDouble(0) / 1024));
+    perUploadLimitSpinbox->setValue(static_cast<int>(config["upload_rate_limit_per_upload"].toDouble(0) / 1024));
     startWithSystemCheckbox->setChecked(config["start_with_system"].toBool());
+    autoTrimCheckbox->setChecked(config["auto_trim"].toBool(false));
+    trimToleranceSpinbox->setValue(config["trim_tolerance"].toInt(8));
+    trimToleranceSpinbox->setEnabled(autoTrimCheckbox->isChecked());
     const QString language = config["language"].toString(QStringLiteral("en"));
     int idx = languageCombo->findData(language);
     if (idx < 0) {
@@ -116,10 +156,15 @@ void OptionsWindow::saveOptions() {
 
     config["screenshot_hotkey"] = hotkeyEdit->text();
     config["fullscreen_hotkey"] = fullscreenHotkeyEdit->text();
+    config["window_hotkey"] = windowHotkeyEdit->text();
     config["file_extension"] = extensionCombo->currentText();
     config["image_quality"] = qualitySpinbox->value();
     config["default_save_folder"] = folderEdit->text();
+    config["upload_rate_limit"] = static_cast<double>(uploadLimitSpinbox->value()) * 1024;
+    config["upload_rate_limit_per_upload"] = static_cast<double>(perUploadLimitSpinbox->value()) * 1024;
     config["start_with_system"] = startWithSystemCheckbox->isChecked();
+    config["auto_trim"] = autoTrimCheckbox->isChecked();
+    config["trim_tolerance"] = trimToleranceSpinbox->value();
     config["language"] = languageCombo->currentData().toString();
 
     configManager->saveConfig(config);
@@ -156,6 +201,13 @@ void OptionsWindow::startRecordingFullscreenHotkey() {
     fullscreenHotkeyEdit->setFocus(Qt::MouseFocusReason);
 }
 
+void OptionsWindow::startRecordingWindowHotkey() {
+    windowHotkeyEdit->setText("");
+    windowHotkeyEdit->setPlaceholderText(tr("Press any key..."));
+    hotkeyEditing = windowHotkeyEdit;
+    windowHotkeyEdit->setFocus(Qt::MouseFocusReason);
+}
+
 void OptionsWindow::handleGlobalKeyPress(QKeySequence keySequence) {
     if (hotkeyEditing) {
         hotkeyEditing->setText(keySequence.toString(QKeySequence::NativeText));
@@ -165,14 +217,17 @@ void OptionsWindow::handleGlobalKeyPress(QKeySequence keySequence) {
 }
 
 bool OptionsWindow::eventFilter(QObject* watched, QEvent* event) {
-    if (watched == hotkeyEdit || watched == fullscreenHotkeyEdit) {
+    if (watched == hotkeyEdit || watched == fullscreenHotkeyEdit || watched == windowHotkeyEdit) {
         if (event->type() == QEvent::MouseButtonPress) {
             if (watched == hotkeyEdit) {
                 startRecordingHotkey();
             }
-            else {
+            else if (watched == fullscreenHotkeyEdit) {
                 startRecordingFullscreenHotkey();
             }
+            else {
+                startRecordingWindowHotkey();
+            }
             return true;
         }
 #ifndef Q_OS_WIN
@@ -0,0 +1,94 @@
+#include "../include/overlay_benchmark.h"
+#include "../include/screenshotdisplay.h"
+#include "../include/utils.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+struct Timings {
+    QVector<qint64> grab;
+    QVector<qint64> visible;
+};
+
+// Spins the event loop until the overlay has painted its first frame.
+void waitForFirstFrame(ScreenshotDisplay* display) {
+    QEventLoop loop;
+    QObject::connect(display, &ScreenshotDisplay::overlayShown, &loop, &QEventLoop::quit);
+    QTimer::singleShot(5000, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+qint64 percentile(QVector<qint64> values, int percent) {
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const int index = std::min(static_cast<int>(values.size()) - 1, (static_cast<int>(values.size()) * percent) / 100);
+    return values[index];
+}
+
+void report(const char* label, const Timings& timings) {
+    std::cout << label
+              << "  grab p50 " << percentile(timings.grab, 50) / 1000.0 << " ms"
+              << "  capture-to-visible p50 " << percentile(timings.visible, 50) / 1000.0 << " ms"
+              << "  p95 " << percentile(timings.visible, 95) / 1000.0 << " ms"
+              << std::endl;
+}
+
+}
+
+int runOverlayBenchmark(ConfigManager* configManager, int iterations) {
+    iterations = std::max(1, iterations);
+    QElapsedTimer timer;
+
+    Timings cold;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        const DesktopCapture capture = captureEntireDesktop();
+        if (!capture.isValid()) {
+            std::cerr << "Unable to capture desktop" << std::endl;
+            return 1;
+        }
+        cold.grab.append(timer.nsecsElapsed() / 1000);
+        ScreenshotDisplay* display = new ScreenshotDisplay(capture, nullptr, configManager);
+        waitForFirstFrame(display);
+        cold.visible.append(timer.nsecsElapsed() / 1000);
+        display->close();
+        delete display;
+        QApplication::processEvents();
+    }
+
+    timer.start();
+    ScreenshotDisplay* pooled = new ScreenshotDisplay(configManager);
+    const qint64 prewarm = timer.nsecsElapsed() / 1000;
+
+    Timings warm;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        const DesktopCapture capture = captureEntireDesktop();
+        if (!capture.isValid()) {
+            std::cerr << "Unable to capture desktop" << std::endl;
+            delete pooled;
+            return 1;
+        }
+        warm.grab.append(timer.nsecsElapsed() / 1000);
+        pooled->reset(capture);
+        waitForFirstFrame(pooled);
+        warm.visible.append(timer.nsecsElapsed() / 1000);
+        pooled->close();
+        QApplication::processEvents();
+    }
+    delete pooled;
+
+    std::cout << "Overlay benchmark, " << iterations << " captures each" << std::endl;
+    report("new overlay per capture:", cold);
+    report("pre-warmed overlay:     ", warm);
+    std::cout << "one-time pre-warm cost: " << prewarm / 1000.0 << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../include/overlay_surface.h"
+#include "../include/screenshotdisplay.h"
+#include <QCloseEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWindow>
+
+OverlaySurface::OverlaySurface(ScreenshotDisplay* display, QScreen* screen)
+    : QWidget(nullptr),
+    display(display),
+    screen(screen) {
+    setWindowFlags(Qt::Window | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
+    setWindowTitle("ScreenMe");
+    setWindowIcon(QIcon("resources/icon.png"));
+    setAttribute(Qt::WA_QuitOnClose, false);
+
+    create();
+    if (QWindow* window = windowHandle()) {
+        window->setScreen(screen);
+    }
+}
+
+void OverlaySurface::attach(const QPoint& desktopOrigin) {
+    if (!screen) {
+        return;
+    }
+    const QRect geometry = screen->geometry();
+    offset = geometry.topLeft() - desktopOrigin;
+    if (QWindow* window = windowHandle()) {
+        window->setScreen(screen);
+    }
+    setGeometry(geometry);
+}
+
+void OverlaySurface::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+    painter.translate(-offset);
+    display->paintArea(painter, event->rect().translated(offset));
+}
+
+void OverlaySurface::mousePressEvent(QMouseEvent* event) {
+    if (event->button() == Qt::MiddleButton) {
+        display->panPressed(event->pos() + offset);
+        return;
+    }
+    display->pointerPressed(this, event->pos() + offset);
+}
+
+void OverlaySurface::mouseMoveEvent(QMouseEvent* event) {
+    // While a button is held Qt keeps delivering to the surface that got the
+    // press, with positions outside its rect; the offset still maps them to
+    // the right overlay point, so drags cross screen boundaries.
+    if (event->buttons() & Qt::MiddleButton) {
+        display->panMoved(event->pos() + offset);
+        return;
+    }
+    display->pointerMoved(this, event->pos() + offset);
+}
+
+void OverlaySurface::mouseReleaseEvent(QMouseEvent* event) {
+    if (event->button() == Qt::MiddleButton) {
+        display->panReleased();
+        return;
+    }
+    display->pointerReleased(event->pos() + offset);
+}
+
+void OverlaySurface::keyPressEvent(QKeyEvent* event) {
+    display->keyPressed(event);
+}
+
+void OverlaySurface::wheelEvent(QWheelEvent* event) {
+    display->wheelTurned(event);
+}
+
+void OverlaySurface::closeEvent(QCloseEvent* event) {
+    // Closing any one surface (Alt+F4, window manager) ends the whole capture.
+    event->ignore();
+    display->close();
+}
@@ -0,0 +1,59 @@
+#include "../include/perf_metrics.h"
+#include <QDebug>
+#include <QStringList>
+#include <algorithm>
+
+PerfMetrics& PerfMetrics::instance() {
+    static PerfMetrics metrics;
+    return metrics;
+}
+
+void PerfMetrics::recordFrame(qint64 latencyUs, qint64 budgetUs) {
+    addCounter(QStringLiteral("frames"));
+    addSample(QStringLiteral("frame_latency_us"), latencyUs);
+    if (budgetUs > 0 && latencyUs > budgetUs) {
+        addCounter(QStringLiteral("late_frames"));
+        addCounter(QStringLiteral("missed_vsyncs"), latencyUs / budgetUs);
+    }
+}
+
+void PerfMetrics::addCounter(const QString& name, qint64 delta) {
+    counters[name] += delta;
+}
+
+qint64 PerfMetrics::counter(const QString& name) const {
+    return counters.value(name, 0);
+}
+
+void PerfMetrics::addSample(const QString& name, qint64 value) {
+    Sample& sample = samples[name];
+    ++sample.count;
+    sample.total += value;
+    sample.max = std::max(sample.max, value);
+}
+
+void PerfMetrics::logSummary(const QString& scope) const {
+    if (counters.isEmpty() && samples.isEmpty()) {
+        return;
+    }
+
+    QStringList parts;
+    QStringList counterNames = counters.keys();
+    counterNames.sort();
+    for (const QString& name : counterNames) {
+        parts << QStringLiteral("%1=%2").arg(name).arg(counters.value(name));
+    }
+    QStringList sampleNames = samples.keys();
+    sampleNames.sort();
+    for (const QString& name : sampleNames) {
+        const Sample& sample = samples[name];
+        parts << QStringLiteral("%1 avg=%2 max=%3 n=%4").arg(name)
+            .arg(sample.count > 0 ? sample.total / sample.count : 0).arg(sample.max).arg(sample.count);
+    }
+    qDebug().noquote() << scope + ":" << parts.join(QStringLiteral(", "));
+}
+
+void PerfMetrics::reset() {
+    counters.clear();
+    samples.clear();
+}
@@ -0,0 +1,444 @@
+#include "../include/pixel_ops.h"
+#include "../include/simd.h"
+#include <QSemaphore>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace {
+
+inline quint32 blendPixel(quint32 dst, quint32 src) {
+    const quint32 alpha = src >> 24;
+    if (alpha == 255) {
+        return src;
+    }
+    if (alpha == 0) {
+        return dst;
+    }
+    const quint32 inverse = 255 - alpha;
+    // Two channels per multiply, rounded division by 255.
+    quint32 rb = (dst & 0x00FF00FFu) * inverse + 0x00800080u;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+    quint32 ag = ((dst >> 8) & 0x00FF00FFu) * inverse + 0x00800080u;
+    ag = (ag + ((ag >> 8) & 0x00FF00FFu)) & 0xFF00FF00u;
+    return src + (rb | ag);
+}
+
+// Below this many pixels a kernel runs on the calling thread; handing work to
+// the pool costs more than it saves.
+constexpr qint64 kParallelThreshold = 256 * 1024;
+
+// Per-channel running sum of 32-bit pixels.
+struct ChannelSum {
+    qint32 c[4] = { 0, 0, 0, 0 };
+};
+
+#ifdef SCREENME_HAVE_SSE2
+inline __m128i expandPixel(quint32 pixel) {
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(pixel)), zero), zero);
+}
+
+inline __m128i loadSum(const ChannelSum& sum) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum.c));
+}
+
+inline void storeSum(ChannelSum& sum, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sum.c), value);
+}
+
+inline quint32 packAverage(__m128i sum, __m128 scale) {
+    __m128i value = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+    value = _mm_packs_epi32(value, value);
+    value = _mm_packus_epi16(value, value);
+    return static_cast<quint32>(_mm_cvtsi128_si32(value));
+}
+#endif
+
+inline void addPixel(ChannelSum& sum, quint32 pixel) {
+    for (int i = 0; i < 4; ++i) {
+        sum.c[i] += (pixel >> (i * 8)) & 0xFF;
+    }
+}
+
+inline void slidePixel(ChannelSum& sum, quint32 incoming, quint32 outgoing) {
+#ifdef SCREENME_HAVE_SSE2
+    storeSum(sum, _mm_sub_epi32(_mm_add_epi32(loadSum(sum), expandPixel(incoming)), expandPixel(outgoing)));
+#else
+    for (int i = 0; i < 4; ++i) {
+        sum.c[i] += static_cast<qint32>((incoming >> (i * 8)) & 0xFF) - static_cast<qint32>((outgoing >> (i * 8)) & 0xFF);
+    }
+#endif
+}
+
+inline quint32 averageOf(const ChannelSum& sum, int count) {
+#ifdef SCREENME_HAVE_SSE2
+    return packAverage(loadSum(sum), _mm_set1_ps(1.0f / count));
+#else
+    quint32 pixel = 0;
+    for (int i = 0; i < 4; ++i) {
+        pixel |= static_cast<quint32>((sum.c[i] + count / 2) / count) << (i * 8);
+    }
+    return pixel;
+#endif
+}
+
+// Sums count consecutive pixels, four at a time with SSE2.
+ChannelSum sumRow(const quint32* row, int count) {
+    ChannelSum sum;
+    int i = 0;
+#ifdef SCREENME_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i accumulator = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        // 16-bit lanes hold pixel pairs (0+2, 1+3) per channel; widen and fold.
+        const __m128i pairs = _mm_add_epi16(_mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero));
+        accumulator = _mm_add_epi32(accumulator, _mm_unpacklo_epi16(pairs, zero));
+        accumulator = _mm_add_epi32(accumulator, _mm_unpackhi_epi16(pairs, zero));
+    }
+    storeSum(sum, accumulator);
+#endif
+    for (; i < count; ++i) {
+        addPixel(sum, row[i]);
+    }
+    return sum;
+}
+
+// Box filter along a row, with the edge pixels repeated beyond both ends.
+void boxRow(const quint32* source, quint32* target, int length, int radius) {
+    const int window = radius * 2 + 1;
+#ifdef SCREENME_HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f / window);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = -radius; i <= radius; ++i) {
+        sum = _mm_add_epi32(sum, expandPixel(source[std::clamp(i, 0, length - 1)]));
+    }
+    for (int i = 0; i < length; ++i) {
+        target[i] = packAverage(sum, scale);
+        sum = _mm_add_epi32(sum, expandPixel(source[std::min(i + radius + 1, length - 1)]));
+        sum = _mm_sub_epi32(sum, expandPixel(source[std::max(i - radius, 0)]));
+    }
+#else
+    ChannelSum sum;
+    for (int i = -radius; i <= radius; ++i) {
+        addPixel(sum, source[std::clamp(i, 0, length - 1)]);
+    }
+    for (int i = 0; i < length; ++i) {
+        target[i] = averageOf(sum, window);
+        slidePixel(sum, source[std::min(i + radius + 1, length - 1)], source[std::max(i - radius, 0)]);
+    }
+#endif
+}
+
+// Box filter down width columns at once. Walking row by row with one running
+// sum per column keeps every access sequential, unlike filtering each column
+// on its own.
+void boxColumns(const quint32* source, qsizetype sourceStride, quint32* target, qsizetype targetStride,
+                int width, int height, int radius) {
+    const int window = radius * 2 + 1;
+    std::vector<ChannelSum> sums(static_cast<size_t>(width));
+    for (int i = -radius; i <= radius; ++i) {
+        const quint32* row = source + std::clamp(i, 0, height - 1) * sourceStride;
+        for (int x = 0; x < width; ++x) {
+            addPixel(sums[x], row[x]);
+        }
+    }
+
+#ifdef SCREENME_HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f / window);
+#endif
+    for (int y = 0; y < height; ++y) {
+        const quint32* incoming = source + std::min(y + radius + 1, height - 1) * sourceStride;
+        const quint32* outgoing = source + std::max(y - radius, 0) * sourceStride;
+        quint32* out = target + y * targetStride;
+        for (int x = 0; x < width; ++x) {
+#ifdef SCREENME_HAVE_SSE2
+            const __m128i sum = loadSum(sums[x]);
+            out[x] = packAverage(sum, scale);
+            storeSum(sums[x], _mm_sub_epi32(_mm_add_epi32(sum, expandPixel(incoming[x])), expandPixel(outgoing[x])));
+#else
+            out[x] = averageOf(sums[x], window);
+            slidePixel(sums[x], incoming[x], outgoing[x]);
+#endif
+        }
+    }
+}
+
+#ifdef SCREENME_HAVE_SSE2
+// Multiplies eight 16-bit channels by their 16-bit factors and divides by 255
+// with rounding.
+inline __m128i multiplyDiv255(__m128i channels, __m128i factors) {
+    const __m128i half = _mm_set1_epi16(0x80);
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(channels, factors), half);
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+inline __m128i inverseAlpha(__m128i pixels16) {
+    // Broadcast the alpha word of each pixel (lanes 3 and 7) to its channels.
+    __m128i alpha = _mm_shufflelo_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+}
+
+// Bit i set when pixel i of the four at pixels is within limit of reference
+// in every channel.
+inline int uniformLanes(const quint32* pixels, __m128i reference, __m128i limit) {
+    const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+    const __m128i difference = _mm_or_si128(_mm_subs_epu8(value, reference), _mm_subs_epu8(reference, value));
+    const __m128i within = _mm_cmpeq_epi32(_mm_subs_epu8(difference, limit), _mm_setzero_si128());
+    return _mm_movemask_ps(_mm_castsi128_ps(within));
+}
+#endif
+
+inline bool withinTolerance(quint32 pixel, quint32 colour, int tolerance) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (std::abs(int((pixel >> shift) & 0xFF) - int((colour >> shift) & 0xFF)) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Number of leading pixels of row[0, count) within tolerance of colour. The
+// vector loops only skip matching blocks; the scalar loop pins down the
+// first pixel that differs.
+int uniformPrefix(const quint32* row, int count, quint32 colour, uchar tolerance) {
+    int i = 0;
+#ifdef SCREENME_HAVE_SSE2
+    const __m128i reference = _mm_set1_epi32(static_cast<int>(colour));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance));
+    for (; i + 16 <= count; i += 16) {
+        if ((uniformLanes(row + i, reference, limit) & uniformLanes(row + i + 4, reference, limit)
+             & uniformLanes(row + i + 8, reference, limit) & uniformLanes(row + i + 12, reference, limit)) != 0xF) {
+            break;
+        }
+    }
+    for (; i + 4 <= count && uniformLanes(row + i, reference, limit) == 0xF; i += 4) {
+    }
+#endif
+    while (i < count && withinTolerance(row[i], colour, tolerance)) {
+        ++i;
+    }
+    return i;
+}
+
+// Same from the end: number of trailing pixels of row[0, count) that match.
+int uniformSuffix(const quint32* row, int count, quint32 colour, uchar tolerance) {
+    int n = 0;
+#ifdef SCREENME_HAVE_SSE2
+    const __m128i reference = _mm_set1_epi32(static_cast<int>(colour));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(tolerance));
+    for (; n + 16 <= count; n += 16) {
+        const quint32* block = row + count - n - 16;
+        if ((uniformLanes(block, reference, limit) & uniformLanes(block + 4, reference, limit)
+             & uniformLanes(block + 8, reference, limit) & uniformLanes(block + 12, reference, limit)) != 0xF) {
+            break;
+        }
+    }
+    for (; n + 4 <= count && uniformLanes(row + count - n - 4, reference, limit) == 0xF; n += 4) {
+    }
+#endif
+    while (n < count && withinTolerance(row[count - 1 - n], colour, tolerance)) {
+        ++n;
+    }
+    return n;
+}
+
+}
+
+void parallelFor(int count, qint64 pixels, const std::function<void(int, int)>& body) {
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int chunks = pixels < kParallelThreshold ? 1 : std::min(count, std::max(1, pool->maxThreadCount()));
+    if (chunks <= 1) {
+        body(0, count);
+        return;
+    }
+
+    QSemaphore done;
+    for (int i = 1; i < chunks; ++i) {
+        const int begin = static_cast<int>(static_cast<qint64>(count) * i / chunks);
+        const int end = static_cast<int>(static_cast<qint64>(count) * (i + 1) / chunks);
+        pool->start([&body, &done, begin, end]() {
+            body(begin, end);
+            done.release();
+        });
+    }
+    body(0, count / chunks);
+    done.acquire(chunks - 1);
+}
+
+void blendPremultipliedRow(quint32* destination, const quint32* source, int count) {
+    int i = 0;
+#ifdef SCREENME_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; i + 4 <= count; i += 4) {
+        const __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m128i srcAlpha = _mm_and_si128(src, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, zero)) == 0xFFFF) {
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), src);
+            continue;
+        }
+
+        const __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        const __m128i srcLow = _mm_unpacklo_epi8(src, zero);
+        const __m128i srcHigh = _mm_unpackhi_epi8(src, zero);
+        const __m128i dstLow = multiplyDiv255(_mm_unpacklo_epi8(dst, zero), inverseAlpha(srcLow));
+        const __m128i dstHigh = multiplyDiv255(_mm_unpackhi_epi8(dst, zero), inverseAlpha(srcHigh));
+        const __m128i blended = _mm_packus_epi16(_mm_add_epi16(srcLow, dstLow), _mm_add_epi16(srcHigh, dstHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), blended);
+    }
+#endif
+    for (; i < count; ++i) {
+        destination[i] = blendPixel(destination[i], source[i]);
+    }
+}
+
+void blendPremultiplied(QImage& destination, const QImage& source) {
+    Q_ASSERT(destination.format() == QImage::Format_ARGB32_Premultiplied);
+    Q_ASSERT(source.format() == QImage::Format_ARGB32_Premultiplied);
+    Q_ASSERT(destination.size() == source.size());
+
+    for (int y = 0; y < destination.height(); ++y) {
+        blendPremultipliedRow(reinterpret_cast<quint32*>(destination.scanLine(y)),
+                              reinterpret_cast<const quint32*>(source.constScanLine(y)), destination.width());
+    }
+}
+
+void pixelate(QImage& image, const QRect& area, int blockSize) {
+    const QRect region = area.intersected(image.rect());
+    if (region.isEmpty() || blockSize < 2) {
+        return;
+    }
+    Q_ASSERT(image.depth() == 32);
+
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    const int blockRows = (region.height() + blockSize - 1) / blockSize;
+    const qint64 pixels = static_cast<qint64>(region.width()) * region.height();
+
+    parallelFor(blockRows, pixels, [&](int firstRow, int lastRow) {
+        for (int blockRow = firstRow; blockRow < lastRow; ++blockRow) {
+            const int top = region.top() + blockRow * blockSize;
+            const int height = std::min(blockSize, region.bottom() + 1 - top);
+            for (int left = region.left(); left <= region.right(); left += blockSize) {
+                const int width = std::min(blockSize, region.right() + 1 - left);
+                ChannelSum total;
+                for (int y = top; y < top + height; ++y) {
+                    const ChannelSum row = sumRow(reinterpret_cast<const quint32*>(bits + y * stride) + left, width);
+                    for (int i = 0; i < 4; ++i) {
+                        total.c[i] += row.c[i];
+                    }
+                }
+                const quint32 average = averageOf(total, width * height);
+                for (int y = top; y < top + height; ++y) {
+                    quint32* line = reinterpret_cast<quint32*>(bits + y * stride) + left;
+                    std::fill(line, line + width, average);
+                }
+            }
+        }
+    });
+}
+
+void boxBlur(QImage& image, const QRect& area, int radius, int passes) {
+    const QRect region = area.intersected(image.rect());
+    if (region.isEmpty() || radius < 1 || passes < 1) {
+        return;
+    }
+    Q_ASSERT(image.depth() == 32);
+
+    const int width = region.width();
+    const int height = region.height();
+    const qint64 pixels = static_cast<qint64>(width) * height;
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    // Horizontal passes run image -> scratch, vertical ones scratch -> image;
+    // threads take rows and columns respectively so no two write the same
+    // pixel.
+    std::vector<quint32> scratch(static_cast<size_t>(pixels));
+    const qsizetype pixelStride = stride / 4;
+    quint32* origin = reinterpret_cast<quint32*>(bits + region.top() * stride) + region.left();
+    const int horizontalRadius = std::min(radius, width);
+    const int verticalRadius = std::min(radius, height);
+
+    for (int pass = 0; pass < passes; ++pass) {
+        parallelFor(height, pixels, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                boxRow(origin + y * pixelStride, scratch.data() + static_cast<qsizetype>(y) * width, width, horizontalRadius);
+            }
+        });
+        parallelFor(width, pixels, [&](int first, int last) {
+            boxColumns(scratch.data() + first, width, origin + first, pixelStride, last - first, height, verticalRadius);
+        });
+    }
+}
+
+void resampleNearest(const QImage& source, const QRect& sourceRect, QImage& target) {
+    const QRect region = sourceRect.intersected(source.rect());
+    if (region.isEmpty() || target.isNull()) {
+        return;
+    }
+    Q_ASSERT(source.depth() == 32 && target.depth() == 32);
+
+    const int targetWidth = target.width();
+    std::vector<int> columns(static_cast<size_t>(targetWidth));
+    for (int x = 0; x < targetWidth; ++x) {
+        columns[x] = region.left() + static_cast<int>(static_cast<qint64>(x) * region.width() / targetWidth);
+    }
+    for (int y = 0; y < target.height(); ++y) {
+        const int sourceY = region.top() + static_cast<int>(static_cast<qint64>(y) * region.height() / target.height());
+        const quint32* in = reinterpret_cast<const quint32*>(source.constScanLine(sourceY));
+        quint32* out = reinterpret_cast<quint32*>(target.scanLine(y));
+        for (int x = 0; x < targetWidth; ++x) {
+            out[x] = in[columns[x]];
+        }
+    }
+}
+
+QRect trimUniformBorders(const QImage& image, int tolerance) {
+    const QRect whole = image.rect();
+    if (image.isNull() || image.depth() != 32) {
+        return whole;
+    }
+    const uchar limit = static_cast<uchar>(std::clamp(tolerance, 0, 255));
+    const int width = image.width();
+    const int height = image.height();
+    auto row = [&image](int y) {
+        return reinterpret_cast<const quint32*>(image.constScanLine(y));
+    };
+
+    const quint32 topColour = row(0)[0];
+    int top = 0;
+    while (top < height && uniformPrefix(row(top), width, topColour, limit) == width) {
+        ++top;
+    }
+    if (top == height) {
+        return whole;
+    }
+    const quint32 bottomColour = row(height - 1)[0];
+    int bottom = height - 1;
+    while (bottom > top && uniformPrefix(row(bottom), width, bottomColour, limit) == width) {
+        --bottom;
+    }
+
+    // Columns are found row by row, each row scanned only as far as the
+    // narrowest margin so far, and at least one column is always kept.
+    const quint32 leftColour = row(top)[0];
+    int left = width - 1;
+    for (int y = top; y <= bottom && left > 0; ++y) {
+        left = uniformPrefix(row(y), left, leftColour, limit);
+    }
+    const quint32 rightColour = row(top)[width - 1];
+    int right = width - 1 - left;
+    for (int y = top; y <= bottom && right > 0; ++y) {
+        right = uniformSuffix(row(y) + width - right, right, rightColour, limit);
+    }
+    return QRect(left, top, width - left - right, bottom - top + 1);
+}
@@ -1,12 +1,22 @@
 #include "../include/screenshotdisplay.h"
+#include "../include/overlay_surface.h"
 #include "../include/config_manager.h"
 #include "../include/utils.h"
+#include "../include/upload_throttle.h"
+#include "../include/upload_cache.h"
+#include "../include/undo_history.h"
+#include "../include/annotation_scene.h"
+#include "../include/perf_metrics.h"
+#include "../include/pixel_ops.h"
+#include "../include/tiled_layer.h"
+#include "../include/image_diff.h"
 #include <QApplication>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkRequest>
 #include <QtNetwork/QNetworkReply>
-#include <QtNetwork/QHttpMultiPart>
 #include <QStandardPaths>
+#include <QBuffer>
+#include <QDateTime>
 #include <QJsonDocument>
 #include <QDesktopServices>
 #include <QFileDialog>
@@ -18,17 +28,70 @@
 #include <QShortcut>
 #include <QToolTip>
 #include <QCursor>
+#include <QScreen>
+#include <QWindow>
 #include <QCheckBox>
 #include <QWheelEvent>
 #include <QPrinter>
 #include <QPrintDialog>
+#include <QDebug>
 #include <cmath>
 #include <algorithm>
+#include <utility>
+
+namespace {
+// Pixel budget of the pixelate/blur preview: enough to judge the effect,
+// small enough to filter within a frame whatever the selection size.
+constexpr qint64 kRedactionPreviewPixels = 512 * 1024;
+
+// The loupe shows kLoupeSamples x kLoupeSamples capture pixels, each drawn as
+// a kLoupeZoom-sized cell, and reads them from a small cached block around
+// the cursor instead of the whole capture.
+constexpr int kLoupeSamples = 15;
+constexpr int kLoupeZoom = 10;
+constexpr int kLoupeInfoHeight = 34;
+constexpr int kLoupeOffset = 24;
+constexpr int kLoupeCacheSize = 128;
+
+// Selection edges within this many logical pixels of a strong edge in the
+// capture snap onto it.
+constexpr int kSnapDistance = 8;
+
+// Diff threshold change per wheel notch.
+constexpr int kDiffThresholdStep = 4;
+
+// Zoom limits and the factor per Ctrl+wheel notch. Zooming out lets a
+// desktop wider than any one screen be seen whole.
+constexpr qreal kMinZoom = 0.125;
+constexpr qreal kMaxZoom = 16.0;
+constexpr qreal kZoomStep = 1.25;
+// Zoomed capture tiles, in view pixels per side, and what the tile cache may
+// hold, in KiB.
+constexpr int kZoomTileSize = 256;
+constexpr int kZoomTileBudgetKb = 96 * 1024;
+
+// Selection and highlight outlines keep their width in view pixels, so they
+// stay visible when zoomed out. Unzoomed this is the same as a plain pen.
+QPen outlinePen(const QColor& color, int width, Qt::PenStyle style = Qt::SolidLine) {
+    QPen pen(color, width, style);
+    pen.setCosmetic(true);
+    return pen;
+}
+
+quint64 zoomTileKey(int column, int row, qreal ratio) {
+    return (static_cast<quint64>(row) << 40) | (static_cast<quint64>(column) << 16) | static_cast<quint16>(qRound(ratio * 100));
+}
+}
 
-ScreenshotDisplay::ScreenshotDisplay(const QPixmap& pixmap, const QRect& geometry, QWidget* parent, ConfigManager* configManager)
-    : QWidget(parent),
-    originalPixmap(pixmap),
-    drawingPixmap(pixmap.size()),
+ScreenshotDisplay::ScreenshotDisplay(ConfigManager* configManager, QObject* parent)
+    : QObject(parent),
+    activeSurface(nullptr),
+    zoom(1.0),
+    panning(false),
+    capturePyramidKey(0),
+    zoomTiles(kZoomTileBudgetKb),
+    loupeCacheKey(0),
+    diffThreshold(ImageDiff::kDefaultThreshold),
     selectionRect(),
     currentShapeRect(),
     currentHandle(None),
@@ -38,47 +101,390 @@ ScreenshotDisplay::ScreenshotDisplay(const QPixmap& pixmap, const QRect& geometr
     shapeDrawing(false),
     showBorderCircle(false),
     borderWidth(5),
-    pixmapDeviceRatio(qFuzzyIsNull(pixmap.devicePixelRatio()) ? 1.0 : pixmap.devicePixelRatio()),
     currentColor(Qt::black),
     currentTool(Editor::None),
     currentFont("Arial", 16),
     text("Editable Text"),
     textEdit(nullptr),
     editor(nullptr),
-    configManager(configManager) {
+    configManager(configManager),
+    networkManager(new QNetworkAccessManager(this)),
+    selectedAnnotation(0),
+    movingAnnotation(false),
+    frameRequested(false),
+    awaitingFirstFrame(false) {
+
+    initializeEditor();
+
+    QFontMetrics fm(currentFont);
+    textBoundingRect = QRect(QPoint(100, 100), fm.size(0, text));
+
+    // Do the expensive parts now rather than on the first capture: the
+    // native windows, the editor stylesheet and its icons.
+    editor->ensurePolished();
+    editor->adjustSize();
+    syncSurfaces();
+
+    connect(qApp, &QGuiApplication::screenRemoved, this, [this](QScreen* screen) {
+        for (int i = surfaces.size() - 1; i >= 0; --i) {
+            if (surfaces[i]->targetScreen() == screen || !surfaces[i]->targetScreen()) {
+                removeSurface(i);
+            }
+        }
+    });
+}
+
+ScreenshotDisplay::ScreenshotDisplay(const DesktopCapture& capture, QObject* parent, ConfigManager* configManager)
+    : ScreenshotDisplay(configManager, parent) {
+    reset(capture);
+}
+
+ScreenshotDisplay::~ScreenshotDisplay() {
+    if (edgeMapBuild) {
+        edgeMapBuild->cancel();
+    }
+    delete scrollCapture.data();
+    // The surfaces own the text edit, if any.
+    textEdit = nullptr;
+    qDeleteAll(surfaces);
+}
+
+// Keeps exactly one surface per connected screen. Surfaces for screens that
+// are still present are reused, so a pre-warmed overlay keeps its native
+// windows across captures.
+void ScreenshotDisplay::syncSurfaces() {
+    const QList<QScreen*> screens = QGuiApplication::screens();
+    for (int i = surfaces.size() - 1; i >= 0; --i) {
+        if (!screens.contains(surfaces[i]->targetScreen())) {
+            removeSurface(i);
+        }
+    }
+    for (QScreen* screen : screens) {
+        const bool covered = std::any_of(surfaces.cbegin(), surfaces.cend(), [screen](const OverlaySurface* surface) {
+            return surface->targetScreen() == screen;
+        });
+        if (covered) {
+            continue;
+        }
+        OverlaySurface* surface = new OverlaySurface(this, screen);
+        configureShortcuts(surface);
+        if (QWindow* window = surface->windowHandle()) {
+            window->installEventFilter(this);
+        }
+        surfaces.append(surface);
+    }
+}
+
+void ScreenshotDisplay::removeSurface(int index) {
+    OverlaySurface* surface = surfaces.takeAt(index);
+    if (activeSurface == surface) {
+        activeSurface = nullptr;
+    }
+    if (textEdit && textEdit->parent() == surface) {
+        textEdit = nullptr;
+    }
+    surface->hide();
+    surface->deleteLater();
+}
+
+OverlaySurface* ScreenshotDisplay::surfaceAt(const QPoint& position) const {
+    for (OverlaySurface* surface : surfaces) {
+        if (surface->overlayRect().contains(position)) {
+            return surface;
+        }
+    }
+    return activeSurface ? activeSurface : surfaces.value(0, nullptr);
+}
+
+QRect ScreenshotDisplay::overlayRect() const {
+    return QRect(QPoint(0, 0), desktopGeometry.size());
+}
+
+QPoint ScreenshotDisplay::toCanvas(const QPoint& viewPoint) const {
+    const QPointF point = QPointF(viewPoint - viewOffset) / zoom;
+    return QPoint(int(std::floor(point.x())), int(std::floor(point.y())));
+}
+
+QRect ScreenshotDisplay::toCanvas(const QRect& viewRect) const {
+    return QRectF(QPointF(viewRect.topLeft() - viewOffset) / zoom, QSizeF(viewRect.size()) / zoom).toAlignedRect();
+}
+
+QPoint ScreenshotDisplay::toView(const QPoint& point) const {
+    return (QPointF(point) * zoom).toPoint() + viewOffset;
+}
+
+QRect ScreenshotDisplay::toView(const QRect& rect) const {
+    return QRectF(QPointF(rect.topLeft()) * zoom + QPointF(viewOffset), QSizeF(rect.size()) * zoom).toAlignedRect();
+}
+
+// Only the surfaces whose screen overlaps the damaged area repaint.
+void ScreenshotDisplay::damage(const QRect& area) {
+    if (area.isEmpty()) {
+        return;
+    }
+    // Zoomed out, outlines keep their width in view pixels and reach past
+    // the scaled bounds.
+    const QRect shown = isZoomed() ? toView(area).adjusted(-2, -2, 2, 2) : area;
+    for (OverlaySurface* surface : surfaces) {
+        const QRect local = shown.intersected(surface->overlayRect()).translated(-surface->origin());
+        if (!local.isEmpty()) {
+            surface->update(local);
+        }
+    }
+}
 
+void ScreenshotDisplay::damageAll() {
+    for (OverlaySurface* surface : surfaces) {
+        surface->update();
+    }
+}
+
+// Keeps the point under anchor (view coordinates) in place.
+void ScreenshotDisplay::setZoom(qreal factor, const QPoint& anchor) {
+    factor = std::clamp(factor, kMinZoom, kMaxZoom);
+    if (std::abs(factor - 1.0) < 0.01) {
+        factor = 1.0;
+    }
+    if (factor == zoom) {
+        return;
+    }
+    const QPointF fixed = QPointF(anchor - viewOffset) / zoom;
+    zoom = factor;
+    viewOffset = (QPointF(anchor) - fixed * zoom).toPoint();
+    zoomTiles.clear();
+    clampView();
+    applyView();
+}
+
+// A capture larger than the view always covers it and a smaller one stays
+// inside it, so the view never drifts off into nothing.
+void ScreenshotDisplay::clampView() {
+    const QSize view = overlayRect().size();
+    const QSize shown = toView(overlayRect()).size();
+    auto clampAxis = [](int offset, int viewLength, int shownLength) {
+        return shownLength >= viewLength ? std::clamp(offset, viewLength - shownLength, 0)
+                                         : std::clamp(offset, 0, viewLength - shownLength);
+    };
+    viewOffset = QPoint(clampAxis(viewOffset.x(), view.width(), shown.width()),
+                        clampAxis(viewOffset.y(), view.height(), shown.height()));
+}
+
+// Everything placed in view coordinates follows a zoom or pan.
+void ScreenshotDisplay::applyView() {
+    damageAll();
+    updateEditorPosition();
+    if (textEdit) {
+        if (const auto* host = qobject_cast<OverlaySurface*>(textEdit->parentWidget())) {
+            textEdit->move(toView(textEditPosition) - host->origin());
+        }
+    }
+}
+
+void ScreenshotDisplay::panPressed(const QPoint& viewPosition) {
+    panning = true;
+    panOrigin = viewPosition;
+    setOverlayCursor(Qt::ClosedHandCursor);
+}
+
+void ScreenshotDisplay::panMoved(const QPoint& viewPosition) {
+    if (!panning) {
+        return;
+    }
+    const QPoint previous = viewOffset;
+    viewOffset += viewPosition - panOrigin;
+    panOrigin = viewPosition;
+    clampView();
+    // The tiles are laid out from the capture's origin, so panning reuses
+    // them as they are.
+    if (viewOffset != previous) {
+        applyView();
+    }
+}
+
+void ScreenshotDisplay::panReleased() {
+    panning = false;
+    const Editor::Tool tool = editor->getCurrentTool();
+    setOverlayCursor(tool == Editor::None || tool == Editor::Select ? Qt::ArrowCursor : Qt::CrossCursor);
+}
+
+void ScreenshotDisplay::setOverlayCursor(Qt::CursorShape shape) {
+    for (OverlaySurface* surface : surfaces) {
+        surface->setCursor(shape);
+    }
+}
+
+void ScreenshotDisplay::reset(const QPixmap& pixmap, const QRect& geometry) {
+    DesktopCapture capture;
+    capture.pixmap = pixmap;
+    capture.pixmap.setDevicePixelRatio(1.0);
+    capture.geometry = geometry.isValid() ? geometry : QRect(QPoint(0, 0), (QSizeF(pixmap.size()) / pixmap.devicePixelRatio()).toSize());
+    CapturedScreen screen;
+    screen.logical = QRect(QPoint(0, 0), capture.geometry.size());
+    screen.physical = capture.pixmap.rect();
+    screen.ratio = screen.logical.width() > 0 ? qreal(screen.physical.width()) / screen.logical.width() : 1.0;
+    capture.screens = { screen };
+    capture.ratio = screen.ratio;
+    reset(capture);
+}
+
+void ScreenshotDisplay::reset(const DesktopCapture& capture) {
+    firstFrameTimer.start();
+
+    if (textEdit) {
+        textEdit->deleteLater();
+        textEdit = nullptr;
+    }
+    editor->deselectTools();
+    editor->hide();
+    if (scrollCapture) {
+        scrollCapture->deleteLater();
+    }
+
+    // The capture keeps every screen at its native resolution; all
+    // interaction happens in logical pixels and is mapped per screen.
+    originalPixmap = capture.pixmap;
     originalPixmap.setDevicePixelRatio(1.0);
-    drawingPixmap.setDevicePixelRatio(1.0);
-    pixmapDeviceRatio = 1.0;
+    desktopGeometry = capture.geometry;
+    captureScreens = capture.screens;
+    // The stroke layer allocates tiles on first use, so a plain
+    // select-and-copy never pays for a second desktop-sized buffer. Its
+    // tiles match the densest screen, like the capture.
+    drawingLayer.reset(desktopGeometry.size(), capture.ratio);
+
+    selectionRect = QRect();
+    currentShapeRect = QRect();
+    strokeBounds = QRect();
+    strokeBuilder.clear();
+    pendingSamples.clear();
+    currentHandle = None;
+    selectionStarted = false;
+    movingSelection = false;
+    drawing = false;
+    shapeDrawing = false;
+    movingAnnotation = false;
+    selectedAnnotation = 0;
+    redactionSource = QImage();
+    redactionPreview = QImage();
+    diffBefore = QImage();
+    diffAfter = QImage();
+    diffResult = ImageDiff();
+    scene.clear();
+    undoHistory.clear();
+    zoom = 1.0;
+    viewOffset = QPoint();
+    panning = false;
+    releaseCapturePyramid();
+
+    // Window geometry is read once, before the surfaces are mapped, so hover
+    // lookups never wait on the window system.
+    QElapsedTimer windowTimer;
+    windowTimer.start();
+    windowTree.capture(desktopGeometry);
+    hoveredWindow = QRect();
+    PerfMetrics::instance().addSample(QStringLiteral("window_tree_us"), windowTimer.nsecsElapsed() / 1000);
+
+    if (configManager) {
+        const QJsonObject config = configManager->loadConfig();
+        undoHistory.setMemoryLimit(static_cast<qint64>(config["undo_memory_limit_mb"].toInt(256)) * 1024 * 1024);
+    }
 
-    desktopGeometry = geometry.isValid() ? geometry : QRect(QPoint(0, 0), originalPixmap.size());
+    syncSurfaces();
+    awaitingFirstFrame = true;
+    for (OverlaySurface* surface : surfaces) {
+        surface->attach(desktopGeometry.topLeft());
+        surface->show();
+        surface->raise();
+    }
 
-    setWindowFlags(Qt::Window | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
-    setWindowTitle("ScreenMe");
-    setWindowIcon(QIcon("resources/icon.png"));
-    setAttribute(Qt::WA_QuitOnClose, false);
-    setGeometry(desktopGeometry);
+    // Keyboard focus goes to the screen the user is looking at.
+    cursorPosition = QCursor::pos() - desktopGeometry.topLeft();
+    activeSurface = surfaceAt(cursorPosition);
+    if (activeSurface) {
+        activeSurface->activateWindow();
+    }
 
-    drawingPixmap.setDevicePixelRatio(pixmapDeviceRatio);
-    drawingPixmap.fill(Qt::transparent);
+    startEdgeMap();
+}
 
-    initializeEditor();
-    configureShortcuts();
+void ScreenshotDisplay::showDiff(const QImage& before, const QImage& after) {
+    QScreen* screen = QGuiApplication::screenAt(QCursor::pos());
+    if (!screen) {
+        screen = QGuiApplication::primaryScreen();
+    }
+    const QRect geometry = screen->geometry();
+    const qreal ratio = screen->devicePixelRatio();
+
+    // The newer image is centred on one screen, shrunk only when it does not
+    // fit, and becomes the capture so selection and export work as usual.
+    const QSize canvasSize = (QSizeF(geometry.size()) * ratio).toSize();
+    QSize shown = after.size();
+    if (shown.width() > canvasSize.width() || shown.height() > canvasSize.height()) {
+        shown = shown.scaled(canvasSize, Qt::KeepAspectRatio);
+    }
+    const QRect target(QPoint((canvasSize.width() - shown.width()) / 2, (canvasSize.height() - shown.height()) / 2), shown);
+    QPixmap canvas(canvasSize);
+    canvas.fill(QColor(15, 23, 42));
+    QPainter painter(&canvas);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(target, after);
+    painter.end();
+
+    reset(canvas, geometry);
+    // The live window tree has nothing to do with the images.
+    windowTree.clear();
+
+    diffBefore = before;
+    diffAfter = after;
+    diffPlacement = QRectF(QPointF(target.topLeft()) / ratio, QSizeF(target.size()) / ratio);
+    updateDiff();
+}
 
-    QFontMetrics fm(currentFont);
-    textBoundingRect = QRect(QPoint(100, 100), fm.size(0, text));
-    show();
+void ScreenshotDisplay::updateDiff() {
+    QElapsedTimer diffTimer;
+    diffTimer.start();
+    diffResult = ImageDiff::compute(diffBefore, diffAfter, diffThreshold);
+    PerfMetrics::instance().addSample(QStringLiteral("diff_us"), diffTimer.nsecsElapsed() / 1000);
+    damageAll();
+    QToolTip::showText(QCursor::pos(), tr("Threshold %1: %2 changed regions").arg(diffThreshold).arg(diffResult.regions().size()));
+}
+
+QRect ScreenshotDisplay::diffRegionRect(const QRect& region) const {
+    const qreal scale = diffPlacement.width() / diffAfter.width();
+    return QRectF(diffPlacement.topLeft() + QPointF(region.topLeft()) * scale, QSizeF(region.size()) * scale).toAlignedRect();
+}
+
+void ScreenshotDisplay::startEdgeMap() {
+    if (edgeMapBuild) {
+        edgeMapBuild->cancel();
+    }
+    edgeMap.reset();
+
+    // Built off the GUI thread so the overlay shows without waiting; until it
+    // arrives the selection simply does not snap.
+    edgeMapTimer.start();
+    edgeMapBuild = EdgeMapBuild::start(originalPixmap.toImage(), this, [this](std::shared_ptr<const EdgeMap> map) {
+        edgeMap = std::move(map);
+        edgeMapBuild.reset();
+        PerfMetrics::instance().addSample(QStringLiteral("edge_map_us"), edgeMapTimer.nsecsElapsed() / 1000);
+    });
 }
 
 void ScreenshotDisplay::initializeEditor() {
-    editor.reset(new Editor(this));
+    editor.reset(new Editor());
     connect(editor.get(), &Editor::toolChanged, this, &ScreenshotDisplay::onToolSelected);
     connect(editor.get(), &Editor::colorChanged, this, [this](const QColor& color) {
         currentColor = color;
         if (textEdit) {
             textEdit->setTextColor(currentColor);
         }
-        update();
+        if (editor->getCurrentTool() == Editor::Select) {
+            if (const Annotation* selected = scene.find(selectedAnnotation)) {
+                Annotation recoloured = *selected;
+                recoloured.color = color;
+                replaceAnnotation(*selected, recoloured);
+            }
+        }
+        damage(borderCircleBounds(cursorPosition));
     });
     connect(editor.get(), &Editor::saveRequested, this, &ScreenshotDisplay::onSaveRequested);
     connect(editor.get(), &Editor::copyRequested, this, &ScreenshotDisplay::copySelectionToClipboard);
@@ -86,32 +492,41 @@ void ScreenshotDisplay::initializeEditor() {
         onPublishRequested(false);
     });
     connect(editor.get(), &Editor::printRequested, this, &ScreenshotDisplay::onPrintRequested);
+    connect(editor.get(), &Editor::scrollCaptureRequested, this, &ScreenshotDisplay::onScrollCaptureRequested);
     connect(editor.get(), &Editor::searchRequested, this, [this]() {
         onPublishRequested(true);
         });
     connect(editor.get(), &Editor::closeRequested, this, &ScreenshotDisplay::onCloseRequested);
 }
 
-void ScreenshotDisplay::configureShortcuts() {
-    QShortcut* escapeShortcut = new QShortcut(QKeySequence(Qt::Key_Escape), this);
-    connect(escapeShortcut, &QShortcut::activated, [this]() {
+void ScreenshotDisplay::configureShortcuts(QWidget* host) {
+    QShortcut* escapeShortcut = new QShortcut(QKeySequence(Qt::Key_Escape), host);
+    connect(escapeShortcut, &QShortcut::activated, this, [this]() {
         if (editor->getCurrentTool() != Editor::None) {
             editor->deselectTools();
-            setCursor(Qt::ArrowCursor);
+            setOverlayCursor(Qt::ArrowCursor);
         }
         else {
             close();
         }
     });
 
-    QShortcut* undoShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_Z), this);
+    QShortcut* undoShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_Z), host);
     connect(undoShortcut, &QShortcut::activated, this, &ScreenshotDisplay::undo);
 
-    QShortcut* copyShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_C), this);
+    QShortcut* redoShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_Z), host);
+    connect(redoShortcut, &QShortcut::activated, this, &ScreenshotDisplay::redo);
+
+    QShortcut* copyShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_C), host);
     connect(copyShortcut, &QShortcut::activated, this, &ScreenshotDisplay::copySelectionToClipboard);
+
+    QShortcut* resetZoomShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_0), host);
+    connect(resetZoomShortcut, &QShortcut::activated, this, [this]() {
+        setZoom(1.0, QPoint());
+    });
 }
 
-void ScreenshotDisplay::closeEvent(QCloseEvent* event) {
+void ScreenshotDisplay::close() {
     emit screenshotClosed();
     if (editor) {
         editor->hide();
@@ -121,45 +536,84 @@ void ScreenshotDisplay::closeEvent(QCloseEvent* event) {
         textEdit = nullptr;
     }
 
-    while (!undoStack.empty()) {
-        undoStack.pop();
+    undoHistory.clear();
+    scene.clear();
+    selectedAnnotation = 0;
+
+    // The overlay is kept for the next capture; only the images go.
+    PerfMetrics::instance().addSample(QStringLiteral("layer_bytes_saved"),
+        drawingLayer.denseMemoryUsage() - drawingLayer.peakMemoryUsage());
+    originalPixmap = QPixmap();
+    redactionSource = QImage();
+    redactionPreview = QImage();
+    loupeCache = QImage();
+    diffBefore = QImage();
+    diffAfter = QImage();
+    diffResult = ImageDiff();
+    PerfMetrics::instance().addSample(QStringLiteral("pyramid_bytes"), capturePyramid.memoryUsage());
+    releaseCapturePyramid();
+    if (edgeMapBuild) {
+        edgeMapBuild->cancel();
+        edgeMapBuild.reset();
+    }
+    edgeMap.reset();
+    loupeCacheRect = QRect();
+    windowTree.clear();
+    hoveredWindow = QRect();
+    drawingLayer.reset(QSize());
+
+    pendingSamples.clear();
+    PerfMetrics::instance().logSummary(QStringLiteral("Capture overlay"));
+    PerfMetrics::instance().reset();
+
+    for (OverlaySurface* surface : surfaces) {
+        surface->hide();
     }
-
-    QWidget::closeEvent(event);
 }
 
-void ScreenshotDisplay::mousePressEvent(QMouseEvent* event) {
+void ScreenshotDisplay::pointerPressed(OverlaySurface* surface, const QPoint& viewPosition) {
+    const QPoint position = toCanvas(viewPosition);
+    activeSurface = surface;
+    processPendingInput();
     if (editor->getCurrentTool() == Editor::None) {
-        HandlePosition handle = handleAtPoint(event->pos());
+        HandlePosition handle = handleAtPoint(position);
         if (handle != None) {
             currentHandle = handle;
-            handleOffset = event->pos() - selectionRect.topLeft();
+            handleOffset = position - selectionRect.topLeft();
         }
-        else if (selectionRect.contains(event->pos())) {
+        else if (selectionRect.contains(position)) {
             movingSelection = true;
-            selectionOffset = event->pos() - selectionRect.topLeft();
+            selectionOffset = position - selectionRect.topLeft();
         }
         else {
+            damage(selectionBounds(selectionRect));
             selectionStarted = true;
-            origin = event->pos();
+            origin = QPoint(snapEdge(Qt::Vertical, position, false), snapEdge(Qt::Horizontal, position, false));
+            setHoveredWindow(windowTree.windowAt(position));
             selectionRect = QRect(origin, QSize());
             currentHandle = None;
             movingSelection = false;
         }
+        if (showsLoupe()) {
+            damage(loupeBounds(cursorPosition));
+            cursorPosition = position;
+            damage(loupeBounds(cursorPosition));
+        }
     }
     else if (editor->getCurrentTool() == Editor::Text) {
         if (!textEdit) {
-            textEdit = new CustomTextEdit(this);
+            OverlaySurface* host = surfaceAt(viewPosition);
+            textEdit = new CustomTextEdit(host);
             textEdit->setFont(currentFont);
             textEdit->setTextColor(currentColor);
             textEdit->setStyleSheet("background: transparent;");
             textEdit->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
             textEdit->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
             textEdit->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Fixed);
-            textEdit->move(event->pos());
+            textEdit->move(viewPosition - host->origin());
             textEdit->show();
             textEdit->setFocus();
-            textEditPosition = event->pos();
+            textEditPosition = position;
             connect(textEdit, &CustomTextEdit::focusOut, this, &ScreenshotDisplay::finalizeTextEdit);
             connect(textEdit, &QTextEdit::textChanged, this, &ScreenshotDisplay::adjustTextEditSize);
         }
@@ -167,119 +621,243 @@ void ScreenshotDisplay::mousePressEvent(QMouseEvent* event) {
             finalizeTextEdit();
         }
     }
+    else if (editor->getCurrentTool() == Editor::Select) {
+        selectAnnotation(scene.topmostAt(position, 4));
+        if (const Annotation* selected = scene.find(selectedAnnotation)) {
+            movingAnnotation = true;
+            annotationDragOrigin = position;
+            draggedAnnotation = *selected;
+        }
+    }
     else {
-        saveStateForUndo();
         drawing = true;
-        lastPoint = event->pos();
-        origin = event->pos();
+        lastPoint = position;
+        origin = position;
+        drawingEnd = position;
+        strokeBounds = QRect();
+        strokeBuilder.begin(position);
         if (editor->getCurrentTool() != Editor::Pen) {
             shapeDrawing = true;
             currentShapeRect = QRect(lastPoint, QSize());
+            if (isRedactionTool()) {
+                // Shares the pixmap's pixels; only the preview reads from it.
+                redactionSource = originalPixmap.toImage();
+                if (redactionSource.depth() != 32) {
+                    redactionSource = redactionSource.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+                }
+            }
         }
     }
 }
 
-void ScreenshotDisplay::mouseMoveEvent(QMouseEvent* event) {
+void ScreenshotDisplay::pointerMoved(OverlaySurface* surface, const QPoint& viewPosition) {
+    // Samples are only collected here; they are applied once per display
+    // refresh in processPendingInput().
+    activeSurface = surface;
+    if (pendingSamples.isEmpty()) {
+        batchTimer.start();
+    }
+    pendingSamples.append(toCanvas(viewPosition));
+    requestFrame();
+}
+
+void ScreenshotDisplay::requestFrame() {
+    if (frameRequested) {
+        return;
+    }
+    QWindow* window = activeSurface ? activeSurface->windowHandle() : nullptr;
+    if (!window) {
+        processPendingInput();
+        return;
+    }
+    frameRequested = true;
+    window->requestUpdate();
+}
+
+bool ScreenshotDisplay::eventFilter(QObject* watched, QEvent* event) {
+    if (event->type() == QEvent::UpdateRequest && frameRequested) {
+        // Runs just before a surface flushes its dirty regions, so the damage
+        // produced by this batch is painted in the same frame.
+        processPendingInput();
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void ScreenshotDisplay::processPendingInput() {
+    frameRequested = false;
+    if (pendingSamples.isEmpty()) {
+        return;
+    }
+
+    QScreen* screen = activeSurface ? activeSurface->targetScreen() : nullptr;
+    const qreal refreshRate = screen ? screen->refreshRate() : 60.0;
+    const qint64 budgetUs = qRound64(1000000.0 / (refreshRate > 0.0 ? refreshRate : 60.0));
+    PerfMetrics::instance().recordFrame(batchTimer.nsecsElapsed() / 1000, budgetUs);
+
+    const QVector<QPoint> samples = std::exchange(pendingSamples, QVector<QPoint>());
+    applyPointerSamples(samples);
+}
+
+void ScreenshotDisplay::applyPointerSamples(const QVector<QPoint>& samples) {
+    const QPoint position = samples.last();
+
     if (selectionRect.isValid() && editor->isHidden()) {
         updateEditorPosition();
         editor->show();
+        editor->raise();
     }
-    if (selectionRect.isValid()) {
-        update();
+    if (showsBorderCircle()) {
+        damage(borderCircleBounds(cursorPosition));
+        cursorPosition = position;
+        damage(borderCircleBounds(cursorPosition));
     }
+    else if (showsLoupe()) {
+        damage(loupeBounds(cursorPosition));
+        cursorPosition = position;
+        damage(loupeBounds(cursorPosition));
+    }
+    if (editor->getCurrentTool() == Editor::None && !selectionRect.isValid()) {
+        setHoveredWindow(windowTree.windowAt(position));
+    }
+
+    const QRect previousSelection = selectionRect;
     if (selectionStarted) {
-        QRect newRect = QRect(origin, event->pos()).normalized();
-        QRect bounds(QPoint(0, 0), size());
-        selectionRect = newRect.intersected(bounds);
-        update();
+        // The dragged corner closes the rect, so it is the trailing edge on
+        // the side it is dragged towards.
+        const QPoint corner(snapEdge(Qt::Vertical, position, position.x() >= origin.x()),
+                            snapEdge(Qt::Horizontal, position, position.y() >= origin.y()));
+        QRect newRect = QRect(origin, corner).normalized();
+        selectionRect = newRect.intersected(overlayRect());
         updateTooltip();
         updateEditorPosition();
     }
     else if (drawing && editor->getCurrentTool() == Editor::Pen) {
-        QPixmap tempPixmap = originalPixmap.copy();
-        QPainter painter(&tempPixmap);
-        painter.setPen(QPen(editor->getCurrentColor(), borderWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        painter.drawLine(lastPoint, event->pos());
-        lastPoint = event->pos();
-        originalPixmap = tempPixmap;
-        update();
+        // Every sample of the batch becomes a segment so fast strokes keep their
+        // shape. Segments go to the transparent stroke layer; the base image is
+        // only touched once, on release, inside the stroke bounds.
+        QPolygon segments;
+        segments.reserve(samples.size() + 1);
+        segments << lastPoint;
+        QRect dirty;
+        for (const QPoint& sample : samples) {
+            dirty = dirty.united(segmentBounds(lastPoint, sample));
+            segments << sample;
+            lastPoint = sample;
+            strokeBuilder.add(sample);
+        }
+        const QPen pen(editor->getCurrentColor(), borderWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
+        drawingLayer.paint(dirty, [&segments, &pen](QPainter& painter) {
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(pen);
+            painter.drawPolyline(segments);
+        });
+        strokeBounds = strokeBounds.united(dirty);
+        damage(dirty);
+    }
+    else if (movingAnnotation) {
+        if (const Annotation* current = scene.find(selectedAnnotation)) {
+            Annotation moved = draggedAnnotation;
+            moved.translate(position - annotationDragOrigin);
+            const QRect previous = annotationDamage(*current);
+            scene.replace(moved);
+            damage(previous.united(annotationDamage(moved)));
+        }
     }
     else if (shapeDrawing) {
-        currentShapeRect = QRect(lastPoint, event->pos()).normalized();
-        drawingEnd = event->pos();
-        update();
+        const QRect previousPreview = shapePreviewBounds();
+        currentShapeRect = QRect(lastPoint, position).normalized();
+        drawingEnd = position;
+        if (isRedactionTool()) {
+            updateRedactionPreview();
+        }
+        damage(previousPreview.united(shapePreviewBounds()));
     }
     else if (movingSelection) {
-        QPoint topLeft = event->pos() - selectionOffset;
-        QRect bounds(QPoint(0, 0), size());
+        QPoint topLeft = position - selectionOffset;
+        const QRect bounds = overlayRect();
         const int maxX = std::max(bounds.left(), bounds.width() - selectionRect.width());
         const int maxY = std::max(bounds.top(), bounds.height() - selectionRect.height());
         topLeft.setX(std::clamp(topLeft.x(), bounds.left(), maxX));
         topLeft.setY(std::clamp(topLeft.y(), bounds.top(), maxY));
         selectionRect.moveTopLeft(topLeft);
-        update();
         updateTooltip();
         updateEditorPosition();
     }
     else if (currentHandle != None) {
-        resizeSelection(event->pos());
-        update();
+        resizeSelection(position);
         updateTooltip();
         updateEditorPosition();
     }
 
-    HandlePosition handle = handleAtPoint(event->pos());
-    setCursor(cursorForHandle(handle));
+    // Everything that changes (shade, border and handles of the old and new
+    // selection) lies within the bounding box of both, so that box is
+    // repainted and the shade elsewhere is left alone.
+    if (selectionRect != previousSelection) {
+        damage(selectionBounds(previousSelection).united(selectionBounds(selectionRect)));
+    }
+
+    HandlePosition handle = handleAtPoint(position);
+    setOverlayCursor(cursorForHandle(handle));
 }
 
-void ScreenshotDisplay::mouseReleaseEvent(QMouseEvent* event) {
+void ScreenshotDisplay::pointerReleased(const QPoint& viewPosition) {
+    const QPoint position = toCanvas(viewPosition);
+    processPendingInput();
+    if (showsLoupe()) {
+        damage(loupeBounds(cursorPosition));
+    }
+    // A click (or a drag of a few pixels) selects the window under the cursor.
+    if (selectionStarted && hoveredWindow.isValid() && selectionRect.width() < 4 && selectionRect.height() < 4) {
+        const QRect previousSelection = selectionRect;
+        selectionRect = hoveredWindow.intersected(overlayRect());
+        damage(selectionBounds(previousSelection).united(selectionBounds(selectionRect)));
+        updateEditorPosition();
+        editor->show();
+        editor->raise();
+    }
     selectionStarted = false;
     movingSelection = false;
     currentHandle = None;
+    if (drawing && strokeBounds.isValid()) {
+        commitStroke();
+    }
     drawing = false;
-    endPoint = QPoint(std::lround(event->pos().x() * pixmapDeviceRatio),
-                         std::lround(event->pos().y() * pixmapDeviceRatio));
+    endPoint = toPixmapRect(QRect(position, QSize(1, 1))).topLeft();
 
-    if (shapeDrawing) {
-        saveStateForUndo();
-        QPixmap tempPixmap = originalPixmap.copy();
-        QPainter painter(&tempPixmap);
-        painter.setPen(QPen(editor->getCurrentColor(), borderWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-
-        switch (editor->getCurrentTool()) {
-        case Editor::Rectangle:
-            painter.drawRect(currentShapeRect);
-            break;
-        case Editor::Ellipse:
-            painter.drawEllipse(currentShapeRect);
-            break;
-        case Editor::Line:
-            painter.drawLine(lastPoint, drawingEnd);
-            break;
-        case Editor::Arrow:
-            drawArrow(painter, lastPoint, drawingEnd);
-            break;
-        default:
-            break;
+    if (movingAnnotation) {
+        movingAnnotation = false;
+        const Annotation* current = scene.find(selectedAnnotation);
+        if (current && current->bounds() != draggedAnnotation.bounds()) {
+            replaceAnnotation(draggedAnnotation, *current);
         }
+    }
 
-        originalPixmap = tempPixmap;
-        shapeDrawing = false;
-        update();
+    if (shapeDrawing) {
+        if (isRedactionTool()) {
+            shapeDrawing = false;
+            applyRedaction(currentShapeRect);
+        }
+        else {
+            const Annotation shape = previewAnnotation();
+            shapeDrawing = false;
+            addAnnotation(shape);
+        }
     }
 
-    update();
     updateTooltip();
 }
 
-void ScreenshotDisplay::keyPressEvent(QKeyEvent* event) {
-    if (editor->getCurrentTool() != Editor::None && event->key() == Qt::Key_Escape) {
+void ScreenshotDisplay::keyPressed(QKeyEvent* event) {
+    if ((event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace) && selectedAnnotation) {
+        deleteSelectedAnnotation();
+    }
+    else if (editor->getCurrentTool() != Editor::None && event->key() == Qt::Key_Escape) {
         if (editor->getCurrentTool() == Editor::Text && textEdit) {
             finalizeTextEdit();
         }
         else {
             editor->deselectTools();
-            setCursor(Qt::ArrowCursor);
+            setOverlayCursor(Qt::ArrowCursor);
         }
     }
     else if (event->key() == Qt::Key_Escape) {
@@ -291,11 +869,25 @@ void ScreenshotDisplay::keyPressEvent(QKeyEvent* event) {
     }
 }
 
-void ScreenshotDisplay::wheelEvent(QWheelEvent* event) {
-    if (editor->getCurrentTool() != Editor::None && editor->getCurrentTool() != Editor::Text) {
+void ScreenshotDisplay::wheelTurned(QWheelEvent* event) {
+    if (event->modifiers() & Qt::ControlModifier) {
+        // Fractional notches too, so touchpads zoom smoothly.
+        const qreal notches = event->angleDelta().y() / 120.0;
+        if (notches != 0.0) {
+            setZoom(zoom * std::pow(kZoomStep, notches), QCursor::pos() - desktopGeometry.topLeft());
+        }
+        return;
+    }
+    if (!diffAfter.isNull() && editor->getCurrentTool() == Editor::None) {
+        diffThreshold = std::clamp(diffThreshold + event->angleDelta().y() / 120 * kDiffThresholdStep, 1, 255);
+        updateDiff();
+        return;
+    }
+    if (showsBorderCircle() && editor->getCurrentTool() != Editor::Text) {
+        const QRect previousCircle = borderCircleBounds(cursorPosition);
         borderWidth += event->angleDelta().y() / 120;
         borderWidth = std::clamp(borderWidth, 1, 20);
-        update();
+        damage(previousCircle.united(borderCircleBounds(cursorPosition)));
     }
     if (editor->getCurrentTool() == Editor::Text && textEdit) {
         int delta = event->angleDelta().y() / 120;
@@ -304,75 +896,217 @@ void ScreenshotDisplay::wheelEvent(QWheelEvent* event) {
             currentFont.setPointSize(newSize);
             textEdit->setFont(currentFont);
             adjustTextEditSize();
-            update();
+            damageAll();
         }
     }
 }
 
-void ScreenshotDisplay::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event);
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-
-    const QSize targetSize(originalPixmap.width() / pixmapDeviceRatio, originalPixmap.height() / pixmapDeviceRatio);
-    const QRect targetRect(QPoint(0, 0), targetSize);
+void ScreenshotDisplay::paintArea(QPainter& painter, const QRect& exposed) {
+    if (originalPixmap.isNull()) {
+        return;
+    }
+    painter.setClipRect(exposed);
+
+    // Zoomed, the capture comes from tiles and everything else is drawn in
+    // overlay coordinates through the view transform.
+    QRect dirty = exposed;
+    if (isZoomed()) {
+        drawZoomedCapture(painter, exposed);
+        painter.translate(viewOffset);
+        painter.scale(zoom, zoom);
+        dirty = toCanvas(exposed);
+    }
+    else {
+        // Each screen's slice is drawn from its native pixels; on the surface
+        // of that screen the device scale matches, so this is a plain copy.
+        for (const CapturedScreen& screen : captureScreens) {
+            const QRect piece = dirty.intersected(screen.logical);
+            if (!piece.isEmpty()) {
+                painter.drawPixmap(QRectF(piece), originalPixmap, screen.toPhysical(QRectF(piece)));
+            }
+        }
+    }
+    if (isZoomed()) {
+        // The tiles are rasterized at 1:1 and would be scaled into blocks, so
+        // the shapes and the stroke being drawn are painted as vectors at
+        // the view scale; the kept points are within 0.75 px of the samples.
+        scene.render(painter, dirty);
+        if (!strokeBounds.isEmpty() && dirty.intersects(strokeBounds)) {
+            painter.save();
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(QPen(editor->getCurrentColor(), borderWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+            painter.drawPolyline(QPolygon(strokeBuilder.points()));
+            painter.restore();
+        }
+    }
+    else {
+        scene.paint(painter, dirty);
+        drawingLayer.draw(painter, dirty);
+    }
 
-    painter.drawPixmap(targetRect, originalPixmap);
-    painter.drawPixmap(targetRect, drawingPixmap);
+    // The shade is the widget minus the selection: at most four rectangles,
+    // each clipped to the damaged area before filling.
+    // Until a selection exists, the hovered window is left unshaded instead.
+    const QColor shade(0, 0, 0, 140);
+    const QRect hole = selectionRect.isValid() ? selectionRect : hoveredWindow;
+    if (hole.isValid()) {
+        const QRect full = overlayRect();
+        const QRect bands[] = {
+            QRect(full.left(), full.top(), full.width(), hole.top() - full.top()),
+            QRect(full.left(), hole.bottom() + 1, full.width(), full.bottom() - hole.bottom()),
+            QRect(full.left(), hole.top(), hole.left() - full.left(), hole.height()),
+            QRect(hole.right() + 1, hole.top(), full.right() - hole.right(), hole.height())
+        };
+        for (const QRect& band : bands) {
+            const QRect area = band.intersected(dirty);
+            if (!area.isEmpty()) {
+                painter.fillRect(area, shade);
+            }
+        }
+    }
+    else if (diffAfter.isNull()) {
+        painter.fillRect(dirty, shade);
+    }
 
-    QPainterPath shadePath;
-    shadePath.addRect(rect());
-    if (selectionRect.isValid()) {
-        QPainterPath selectionPath;
-        selectionPath.addRect(selectionRect);
-        shadePath = shadePath.subtracted(selectionPath);
+    // Diff boxes stay readable over the shade.
+    if (!diffResult.isNull()) {
+        painter.setPen(outlinePen(QColor(239, 68, 68), 2));
+        for (const QRect& region : diffResult.regions()) {
+            const QRect box = diffRegionRect(region).adjusted(-2, -2, 2, 2);
+            if (dirty.intersects(box)) {
+                painter.fillRect(box, QColor(239, 68, 68, 50));
+                painter.drawRect(box);
+            }
+        }
     }
 
-    painter.save();
-    painter.setPen(Qt::NoPen);
-    painter.fillPath(shadePath, QColor(0, 0, 0, 140));
-    painter.restore();
+    painter.setRenderHint(QPainter::Antialiasing);
 
-    if (selectionRect.isValid()) {
-        painter.setPen(QPen(Qt::red, 2, Qt::DashLine));
+    if (!selectionRect.isValid() && hoveredWindow.isValid() && dirty.intersects(selectionBounds(hoveredWindow))) {
+        painter.setPen(outlinePen(QColor(37, 99, 235), 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(hoveredWindow);
+    }
+    if (selectionRect.isValid() && dirty.intersects(selectionBounds(selectionRect))) {
+        painter.setPen(outlinePen(Qt::red, 2, Qt::DashLine));
         painter.drawRect(selectionRect);
         drawHandles(painter);
     }
 
-    if (shapeDrawing) {
-        painter.setPen(QPen(editor->getCurrentColor(), borderWidth, Qt::SolidLine));
-        switch (editor->getCurrentTool()) {
-        case Editor::Pen:
-            painter.drawPath(drawingPath);
-            break;
-        case Editor::Rectangle:
-            painter.setBrush(Qt::NoBrush);
-            painter.drawRect(currentShapeRect);
-            break;
-        case Editor::Ellipse:
-            painter.setBrush(Qt::NoBrush);
-            painter.drawEllipse(currentShapeRect);
-            break;
-        case Editor::Line:
-            painter.drawLine(origin, drawingEnd);
-            break;
-        case Editor::Arrow:
-            drawArrow(painter, lastPoint, drawingEnd);
-            break;
-        case Editor::Text:
-            painter.setFont(currentFont);
-            painter.setPen(QPen(editor->getCurrentColor()));
-            painter.drawText(textBoundingRect, Qt::AlignLeft, text);
-            break;
-        default:
-            break;
+    if (shapeDrawing && isRedactionTool()) {
+        if (!redactionPreview.isNull()) {
+            painter.save();
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, editor->getCurrentTool() == Editor::Blur);
+            painter.drawImage(QRectF(redactionPreviewRect), redactionPreview);
+            painter.restore();
         }
+        painter.setPen(QPen(QColor(37, 99, 235), 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(currentShapeRect);
+    }
+    else if (shapeDrawing) {
+        previewAnnotation().paint(painter);
+    }
+
+    if (selectedAnnotation) {
+        painter.setPen(QPen(QColor(37, 99, 235), 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(scene.boundsOf(selectedAnnotation).adjusted(-2, -2, 1, 1));
     }
 
-    if (editor->getCurrentTool() != Editor::None) {
-        cursorPosition = mapFromGlobal(QCursor::pos());
+    if (showsBorderCircle() && dirty.intersects(borderCircleBounds(cursorPosition))) {
         drawBorderCircle(painter, cursorPosition);
     }
+    if (showsLoupe() && dirty.intersects(loupeBounds(cursorPosition))) {
+        drawLoupe(painter, cursorPosition);
+    }
+    if (awaitingFirstFrame) {
+        awaitingFirstFrame = false;
+        PerfMetrics::instance().addSample(QStringLiteral("overlay_visible_us"), firstFrameTimer.nsecsElapsed() / 1000);
+        emit overlayShown();
+    }
+}
+
+// Tiles hold the capture at the current zoom for one device pixel ratio, so
+// a repaint is a plain copy whatever the zoom. They are laid out from the
+// capture's origin in view pixels, which keeps them valid while panning.
+void ScreenshotDisplay::drawZoomedCapture(QPainter& painter, const QRect& exposed) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // The pixmap's cache key changes whenever it is painted on (redaction,
+    // undo), which drops the levels and tiles built from the old pixels.
+    if (capturePyramidKey != originalPixmap.cacheKey()) {
+        capturePyramid.reset(originalPixmap.toImage());
+        capturePyramidKey = originalPixmap.cacheKey();
+        zoomTiles.clear();
+    }
+
+    const QRect canvas = toView(overlayRect());
+    if (!canvas.contains(exposed)) {
+        painter.fillRect(exposed, QColor(15, 23, 42));
+    }
+    const QRect visible = exposed.intersected(canvas).translated(-viewOffset);
+    if (visible.isEmpty()) {
+        return;
+    }
+    const QRect tiled(QPoint(0, 0), canvas.size());
+    const qreal ratio = painter.device()->devicePixelRatioF();
+    for (int row = visible.top() / kZoomTileSize; row <= visible.bottom() / kZoomTileSize; ++row) {
+        for (int column = visible.left() / kZoomTileSize; column <= visible.right() / kZoomTileSize; ++column) {
+            const QRect tile = QRect(column * kZoomTileSize, row * kZoomTileSize, kZoomTileSize, kZoomTileSize).intersected(tiled);
+            const quint64 key = zoomTileKey(column, row, ratio);
+            QPixmap pixmap;
+            if (const QPixmap* cached = zoomTiles.object(key)) {
+                pixmap = *cached;
+            }
+            else {
+                pixmap = renderZoomTile(tile, ratio);
+                const qint64 bytes = static_cast<qint64>(pixmap.width()) * pixmap.height() * 4;
+                zoomTiles.insert(key, new QPixmap(pixmap), static_cast<int>(bytes / 1024) + 1);
+            }
+            painter.drawPixmap(tile.topLeft() + viewOffset, pixmap);
+        }
+    }
+    PerfMetrics::instance().addSample(QStringLiteral("zoom_paint_us"), timer.nsecsElapsed() / 1000);
+}
+
+// Each screen's part of the tile is drawn from the pyramid level closest
+// above the tile's resolution, so the painter never shrinks by 2x or more;
+// enlarged pixels stay sharp.
+QPixmap ScreenshotDisplay::renderZoomTile(const QRect& tile, qreal ratio) {
+    QImage image((QSizeF(tile.size()) * ratio).toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(ratio);
+    image.fill(QColor(15, 23, 42));
+
+    QPainter painter(&image);
+    painter.translate(-tile.topLeft());
+    painter.scale(zoom, zoom);
+    const QRectF area(QPointF(tile.topLeft()) / zoom, QSizeF(tile.size()) / zoom);
+    for (const CapturedScreen& screen : captureScreens) {
+        const QRectF piece = area.intersected(QRectF(screen.logical));
+        if (piece.isEmpty()) {
+            continue;
+        }
+        // Device pixels per native capture pixel.
+        const qreal scale = zoom * ratio / screen.ratio;
+        const int level = std::min(MipmapPyramid::levelFor(scale), capturePyramid.maxLevel());
+        const qreal shrink = std::ldexp(1.0, -level);
+        const QRectF source = screen.toPhysical(piece);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, scale < 1.0);
+        painter.drawImage(piece, capturePyramid.level(level), QRectF(source.topLeft() * shrink, source.size() * shrink));
+    }
+    painter.end();
+    return QPixmap::fromImage(std::move(image));
+}
+
+// Level 0 of the pyramid shares the capture's pixels, so any write to the
+// capture while it is alive would detach a full desktop-sized copy. Writers
+// drop it first; the next zoomed paint builds it again from the new pixels.
+void ScreenshotDisplay::releaseCapturePyramid() {
+    capturePyramid.clear();
+    capturePyramidKey = 0;
+    zoomTiles.clear();
 }
 
 void ScreenshotDisplay::onSaveRequested() {
@@ -389,11 +1123,11 @@ void ScreenshotDisplay::onSaveRequested() {
         fileFilter = "JPEG Files (*.jpg *.jpeg);;";
     }
 
-    QString filePath = QFileDialog::getSaveFileName(this, "Save As", defaultFileName, fileFilter);
-    QRect captureRect = selectionRect.isValid() ? toPixmapRect(selectionRect) : originalPixmap.rect();
+    QString filePath = QFileDialog::getSaveFileName(activeSurface, "Save As", defaultFileName, fileFilter);
+    QRect captureRect = exportRect();
 
     if (!filePath.isEmpty()) {
-        QPixmap selectedPixmap = originalPixmap.copy(captureRect);
+        QPixmap selectedPixmap = renderCapture(captureRect);
         selectedPixmap.save(filePath);
         close();
     }
@@ -403,164 +1137,222 @@ void ScreenshotDisplay::onPublishRequested(bool searchImage) {
     if (textEdit) {
         finalizeTextEdit();
     }
-    QPixmap resultPixmap = originalPixmap;
-    QPainter painter(&resultPixmap);
-    painter.drawPixmap(0, 0, drawingPixmap);
-
     editor->hide();
 
-    QRect captureRect = selectionRect.isValid() ? toPixmapRect(selectionRect) : originalPixmap.rect();
+    QRect captureRect = exportRect();
 
     QJsonObject config = configManager->loadConfig();
     QString defaultSaveFolder = config["default_save_folder"].toString();
     QString fileExtension = config["file_extension"].toString();
 
     if (selectionRect.isValid()) {
-        ScreenshotDisplay::hide();
-        QPixmap selectedPixmap = resultPixmap.copy(captureRect);
+        for (OverlaySurface* surface : surfaces) {
+            surface->hide();
+        }
+        QPixmap selectedPixmap = renderCapture(captureRect);
         QApplication::clipboard()->setPixmap(selectedPixmap);
 
-        QString tempFilePath = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/screenshot.png";
-        selectedPixmap.save(tempFilePath);
-
         QString savePath = getUniqueFilePath(defaultSaveFolder, "screenshot", fileExtension);
         selectedPixmap.save(savePath);
         qDebug() << "Saving screenshot to:" << savePath;
         QString jsonStr = loadLoginInfo();
         QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonStr.toUtf8());
         QJsonObject loginInfo = jsonDoc.object();
+        QRect screenGeometry = desktopGeometry;
 
-        QNetworkAccessManager* manager = new QNetworkAccessManager(this);
-        QUrl url(SCREEN_ME_HOST + "/api/screenshot");
-        QNetworkRequest request(url);
+        // Same pixels uploaded by the same account reuse the earlier link.
+        UploadCache& uploadCache = UploadCache::instance();
+        uploadCache.setCapacity(config["upload_cache_size"].toInt(64));
+        const QByteArray contentHash = UploadCache::contentHash(selectedPixmap.toImage(),
+            loginInfo["id"].toString().toUtf8() + "/png");
+        UploadRecord cached;
+        if (uploadCache.lookup(contentHash, cached)) {
+            qDebug() << "Upload skipped, content already published as" << cached.url;
+            showUploadResult(cached, searchImage, screenGeometry, loginInfo);
+            close();
+            return;
+        }
 
-        request.setRawHeader("Authorization", "Bearer " + loginInfo["token"].toString().toUtf8());
+        // The server is asked for the hash first; the capture is only encoded
+        // and sent when it has not seen these pixels before.
+        QNetworkRequest lookupRequest(QUrl(SCREEN_ME_HOST + "/api/screenshot/hash/" + QString::fromLatin1(contentHash)));
+        lookupRequest.setRawHeader("Authorization", "Bearer " + loginInfo["token"].toString().toUtf8());
+        QNetworkReply* lookupReply = networkManager->get(lookupRequest);
+        connect(lookupReply, &QNetworkReply::finished, this,
+                [this, lookupReply, selectedPixmap, contentHash, searchImage, screenGeometry, loginInfo, config]() {
+            lookupReply->deleteLater();
+            const int status = lookupReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (lookupReply->error() == QNetworkReply::NoError && status == 200) {
+                const QJsonObject jsonObject = QJsonDocument::fromJson(lookupReply->readAll()).object();
+                UploadRecord record;
+                record.id = QString::number(jsonObject["id"].toInt());
+                record.url = jsonObject["url"].toString();
+                record.imageUrl = jsonObject["imageUrl"].toString();
+                if (!record.url.isEmpty()) {
+                    qDebug() << "Upload skipped, server already has the content as" << record.url;
+                    UploadCache::instance().insert(contentHash, record);
+                    showUploadResult(record, searchImage, screenGeometry, loginInfo);
+                    close();
+                    return;
+                }
+            }
+            // 404, or a server without the lookup: the pixels are new.
+            uploadCapture(selectedPixmap, contentHash, searchImage, screenGeometry, loginInfo, config);
+        });
+    }
+}
 
-        QHttpMultiPart* multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+void ScreenshotDisplay::uploadCapture(const QPixmap& selectedPixmap, const QByteArray& contentHash, bool searchImage,
+                                      const QRect& screenGeometry, const QJsonObject& loginInfo, const QJsonObject& config) {
+    QByteArray pngData;
+    QBuffer pngBuffer(&pngData);
+    pngBuffer.open(QIODevice::WriteOnly);
+    selectedPixmap.save(&pngBuffer, "PNG");
+    pngBuffer.close();
+
+    QUrl url(SCREEN_ME_HOST + "/api/screenshot");
+    QNetworkRequest request(url);
+
+    request.setRawHeader("Authorization", "Bearer " + loginInfo["token"].toString().toUtf8());
+    request.setRawHeader("X-Content-Hash", contentHash);
+
+    // The multipart body is assembled by hand so it can be streamed through
+    // the throttled device; QHttpMultiPart does not expose its QIODevice.
+    const QByteArray boundary = "ScreenMeBoundary" + QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 16);
+    QByteArray body;
+    body.reserve(pngData.size() + 384);
+    body.append("--" + boundary + "\r\n");
+    body.append("Content-Disposition: form-data; name=\"hash\"\r\n\r\n");
+    body.append(contentHash);
+    body.append("\r\n--" + boundary + "\r\n");
+    body.append("Content-Disposition: form-data; name=\"screenshot\"; filename=\"screenshot.png\"\r\n");
+    body.append("Content-Type: image/png\r\n\r\n");
+    body.append(pngData);
+    body.append("\r\n--" + boundary + "--\r\n");
+
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("multipart/form-data; boundary=" + boundary));
+    request.setHeader(QNetworkRequest::ContentLengthHeader, body.size());
+
+    QBuffer* bodySource = new QBuffer();
+    bodySource->setData(body);
+    ThrottledUploadDevice* uploadDevice = ThrottledUploadDevice::fromConfig(bodySource, config);
+
+    QProgressDialog* progressDialog = new QProgressDialog("Publishing screenshot", "Cancel", 0, 100, activeSurface);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setAutoClose(false);
+    progressDialog->setAutoReset(false);
+    progressDialog->show();
+
+    // Position the progress dialog at the bottom right of the screen
+    QSize progressDialogSize = progressDialog->sizeHint();
+    progressDialog->move(screenGeometry.bottomRight() - QPoint(progressDialogSize.width() + 10, progressDialogSize.height() + 100));
+
+    QNetworkReply* reply = networkManager->post(request, uploadDevice);
+    uploadDevice->setParent(reply);
+
+    connect(progressDialog, &QProgressDialog::canceled, reply, &QNetworkReply::abort);
+
+    connect(reply, &QNetworkReply::uploadProgress, this, [progressDialog](qint64 bytesSent, qint64 bytesTotal) {
+        if (bytesTotal > 0) {
+            progressDialog->setMaximum(bytesTotal);
+            progressDialog->setValue(bytesSent);
+        }
+    });
 
-        QHttpPart imagePart;
-        imagePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("image/png"));
-        imagePart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"screenshot\"; filename=\"screenshot.png\""));
+    connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred), this, [reply]() {
+        qDebug() << "Network Error:" << reply->errorString();
+    });
 
-        QFile* file = new QFile(tempFilePath);
-        if (!file->open(QIODevice::ReadOnly)) {
-            QMessageBox::critical(this, "Error", "Failed to open the image file for upload.");
-            return;
-        }
-        imagePart.setBodyDevice(file);
-        file->setParent(multiPart);
+    connect(reply, &QNetworkReply::finished, this, [reply, uploadDevice, contentHash, this, progressDialog, searchImage, screenGeometry, loginInfo]() {
+        progressDialog->close();
+        qDebug() << "Upload throughput:" << qRound(uploadDevice->averageThroughput()) << "bytes/s over" << uploadDevice->bytesSent() << "bytes";
+
+        if (reply->error() == QNetworkReply::NoError) {
+            QByteArray response = reply->readAll();
+            QJsonDocument jsonResponse = QJsonDocument::fromJson(response);
+            QJsonObject jsonObject = jsonResponse.object();
+
+            UploadRecord record;
+            record.id = QString::number(jsonObject["id"].toInt());
+            record.url = jsonObject["url"].toString();
+            record.imageUrl = jsonObject["imageUrl"].toString();
+            if (!record.url.isEmpty()) {
+                UploadCache::instance().insert(contentHash, record);
+            }
 
-        multiPart->append(imagePart);
+            showUploadResult(record, searchImage, screenGeometry, loginInfo);
+        }
+        else {
+            QString errorString = reply->errorString();
+            qDebug() << "Upload Failed:" << errorString;
+            QString serverReply = errorString.section("server replied: ", 1, 1);
+            if (serverReply.contains("Forbidden")) {
+                QMessageBox::critical(activeSurface, "Upload Failed", "Failed to upload screenshot: " + serverReply + "\nPlease try to log in again.");
+            }
+            else {
+                QMessageBox::critical(activeSurface, "Upload Failed", "Failed to upload screenshot: " + serverReply);
+            }
+        }
+        reply->deleteLater();
+        delete progressDialog;
 
-        QProgressDialog* progressDialog = new QProgressDialog("Publishing screenshot", "Cancel", 0, 100, this);
-        progressDialog->setWindowModality(Qt::WindowModal);
-        progressDialog->setAutoClose(false);
-        progressDialog->setAutoReset(false);
-        progressDialog->show();
+        // The overlay is pooled; close() drops the capture and its caches.
+        close();
+    });
+}
 
-        // Position the progress dialog at the bottom right of the screen
-        QRect screenGeometry = desktopGeometry;
-        QSize progressDialogSize = progressDialog->sizeHint();
-        progressDialog->move(screenGeometry.bottomRight() - QPoint(progressDialogSize.width() + 10, progressDialogSize.height() + 100));
+void ScreenshotDisplay::showUploadResult(const UploadRecord& record, bool searchImage, const QRect& screenGeometry, const QJsonObject& loginInfo) {
+    const QString id = record.id;
+    const QString link = SCREEN_ME_HOST + "/" + record.url;
 
-        QNetworkReply* reply = manager->post(request, multiPart);
-        multiPart->setParent(reply);
+    if (searchImage) {
+        QDesktopServices::openUrl(QUrl("https://tineye.com/search?url=" + record.imageUrl));
+        return;
+    }
 
-        connect(progressDialog, &QProgressDialog::canceled, reply, &QNetworkReply::abort);
+    QMessageBox msgBox(activeSurface);
+    msgBox.setWindowTitle("Screenshot Uploaded");
+    msgBox.setText("Screenshot uploaded successfully ! Link: " + link);
+    QPushButton* copyButton = msgBox.addButton(tr("Copy"), QMessageBox::ActionRole);
+    QPushButton* openButton = msgBox.addButton(tr("Open"), QMessageBox::ActionRole);
+    msgBox.addButton(QMessageBox::Ok);
+
+    QCheckBox* privateCheckBox = nullptr;
+    if (!loginInfo["token"].toString().isEmpty()) {
+        privateCheckBox = new QCheckBox("Private", &msgBox);
+        msgBox.setCheckBox(privateCheckBox);
+
+        connect(privateCheckBox, &QCheckBox::toggled, this, [this, id, loginInfo](bool checked) {
+            QUrl url(SCREEN_ME_HOST + "/api/screenshot/" + id);
+            QNetworkRequest request(url);
+
+            request.setRawHeader("Authorization", "Bearer " + loginInfo["token"].toString().toUtf8());
+            request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+            QJsonObject json;
+            json["privacy"] = checked ? "private" : "public";
+            QJsonDocument doc(json);
+            QByteArray data = doc.toJson();
+
+            QNetworkReply* reply = networkManager->sendCustomRequest(request, "PATCH", data);
+            connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+            });
+    }
 
-        connect(reply, &QNetworkReply::uploadProgress, this, [progressDialog](qint64 bytesSent, qint64 bytesTotal) {
-            if (bytesTotal > 0) {
-                progressDialog->setMaximum(bytesTotal);
-                progressDialog->setValue(bytesSent);
-            }
+    connect(copyButton, &QPushButton::clicked, [link]() {
+        QClipboard* clipboard = QGuiApplication::clipboard();
+        clipboard->setText(link);
         });
 
-        connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred), this, [reply]() {
-            qDebug() << "Network Error:" << reply->errorString();
+    connect(openButton, &QPushButton::clicked, [link]() {
+        QDesktopServices::openUrl(QUrl(link));
         });
 
-        connect(reply, &QNetworkReply::finished, this, [reply, file, tempFilePath, this, progressDialog, searchImage, screenGeometry, loginInfo]() {
-            progressDialog->close();
-
-            if (reply->error() == QNetworkReply::NoError) {
-                QByteArray response = reply->readAll();
-                QJsonDocument jsonResponse = QJsonDocument::fromJson(response);
-                QJsonObject jsonObject = jsonResponse.object();
-                QString url = jsonObject["url"].toString();
-                QString id = QString::number(jsonObject["id"].toInt());
-                QString link = SCREEN_ME_HOST + "/" + url;
-                QString imageUrl = jsonObject["imageUrl"].toString();
-
-                if (!searchImage) {
-                    QMessageBox msgBox(this);
-                    msgBox.setWindowTitle("Screenshot Uploaded");
-                    msgBox.setText("Screenshot uploaded successfully ! Link: " + link);
-                    QPushButton* copyButton = msgBox.addButton(tr("Copy"), QMessageBox::ActionRole);
-                    QPushButton* openButton = msgBox.addButton(tr("Open"), QMessageBox::ActionRole);
-                    msgBox.addButton(QMessageBox::Ok);
-
-                    QCheckBox* privateCheckBox = nullptr;
-                    if (!loginInfo["token"].toString().isEmpty()) {
-                        privateCheckBox = new QCheckBox("Private", &msgBox);
-                        msgBox.setCheckBox(privateCheckBox);
-
-                        connect(privateCheckBox, &QCheckBox::toggled, this, [id, loginInfo](bool checked) {
-                            QNetworkAccessManager* manager = new QNetworkAccessManager();
-                            QUrl url(SCREEN_ME_HOST + "/api/screenshot/" + id);
-                            QNetworkRequest request(url);
-
-                            request.setRawHeader("Authorization", "Bearer " + loginInfo["token"].toString().toUtf8());
-                            request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-                            QJsonObject json;
-                            json["privacy"] = checked ? "private" : "public";
-                            QJsonDocument doc(json);
-                            QByteArray data = doc.toJson();
-
-                            QNetworkReply* reply = manager->sendCustomRequest(request, "PATCH", data);
-                            connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
-                            });
-                    }
-
-                    connect(copyButton, &QPushButton::clicked, [link]() {
-                        QClipboard* clipboard = QGuiApplication::clipboard();
-                        clipboard->setText(link);
-                        });
-
-                    connect(openButton, &QPushButton::clicked, [link]() {
-                        QDesktopServices::openUrl(QUrl(link));
-                        });
-
-                    // Position the message box at the bottom right of the screen
-                    msgBox.show();
-                    QSize msgBoxSize = msgBox.sizeHint();
-                    msgBox.move(screenGeometry.bottomRight() - QPoint(msgBoxSize.width() + 10, msgBoxSize.height() + 100));
-                    msgBox.exec();
-                }
-                else {
-                    QDesktopServices::openUrl(QUrl("https://tineye.com/search?url=" + imageUrl));
-                }
-                
-            }
-            else {
-                QString errorString = reply->errorString();
-                qDebug() << "Upload Failed:" << errorString;
-                QString serverReply = errorString.section("server replied: ", 1, 1);
-                if (serverReply.contains("Forbidden")) {
-                    QMessageBox::critical(this, "Upload Failed", "Failed to upload screenshot: " + serverReply + "\nPlease try to log in again.");
-                }
-                else {
-                    QMessageBox::critical(this, "Upload Failed", "Failed to upload screenshot: " + serverReply);
-                }
-            }
-            reply->deleteLater();
-            file->deleteLater();
-            QFile::remove(tempFilePath);
-            delete progressDialog;
-
-            emit screenshotClosed();
-        });
-    }
+    // Position the message box at the bottom right of the screen
+    msgBox.show();
+    QSize msgBoxSize = msgBox.sizeHint();
+    msgBox.move(screenGeometry.bottomRight() - QPoint(msgBoxSize.width() + 10, msgBoxSize.height() + 100));
+    msgBox.exec();
 }
 
 
@@ -576,18 +1368,14 @@ void ScreenshotDisplay::onPrintRequested() {
     QPrinter printer(QPrinter::HighResolution);
     printer.setDocName(tr("ScreenMe Capture"));
 
-    QPrintDialog dialog(&printer, this);
+    QPrintDialog dialog(&printer, activeSurface);
     dialog.setWindowTitle(tr("Print Screenshot"));
     if (dialog.exec() != QDialog::Accepted) {
         return;
     }
 
-    QPixmap resultPixmap = originalPixmap;
-    QPainter painter(&resultPixmap);
-    painter.drawPixmap(0, 0, drawingPixmap);
-
-    const QRect captureRect = selectionRect.isValid() ? toPixmapRect(selectionRect) : resultPixmap.rect();
-    QPixmap printPixmap = resultPixmap.copy(captureRect);
+    const QRect captureRect = exportRect();
+    QPixmap printPixmap = renderCapture(captureRect);
 
     if (printPixmap.isNull()) {
         return;
@@ -604,26 +1392,56 @@ void ScreenshotDisplay::onPrintRequested() {
     printPainter.end();
 }
 
-void ScreenshotDisplay::copySelectionToClipboard() {
-    QPixmap resultPixmap = originalPixmap;
-    QPainter painter(&resultPixmap);
-    painter.drawPixmap(0, 0, drawingPixmap);
+void ScreenshotDisplay::onScrollCaptureRequested() {
+    if (!selectionRect.isValid() || scrollCapture) {
+        return;
+    }
 
-    if (selectionRect.isValid()) {
-        const QRect captureRect = toPixmapRect(selectionRect);
-        QApplication::clipboard()->setPixmap(resultPixmap.copy(captureRect));
+    // The page underneath is grabbed live, so the overlay steps aside;
+    // annotations made on the still capture do not carry over.
+    editor->hide();
+    for (OverlaySurface* surface : surfaces) {
+        surface->hide();
+    }
+    scrollCapture = new ScrollCapture(selectionRect.translated(desktopGeometry.topLeft()));
+    connect(scrollCapture, &ScrollCapture::finished, this, &ScreenshotDisplay::saveScrollCapture);
+    connect(scrollCapture, &ScrollCapture::cancelled, this, &ScreenshotDisplay::close);
+    scrollCapture->start();
+}
+
+void ScreenshotDisplay::saveScrollCapture(const QImage& image) {
+    QJsonObject config = configManager->loadConfig();
+    QString folder = config["default_save_folder"].toString();
+    if (folder.isEmpty()) {
+        folder = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    }
+    QString extension = config["file_extension"].toString();
+    if (extension.isEmpty()) {
+        extension = QStringLiteral("png");
+    }
+
+    QApplication::clipboard()->setImage(image);
+    const QString savePath = getUniqueFilePath(folder, "scrolling_screenshot", extension);
+    if (image.save(savePath)) {
+        emit scrollCaptureSaved(savePath);
     }
     else {
-        QApplication::clipboard()->setPixmap(resultPixmap);
+        qWarning() << "Failed to save the scrolling capture to" << savePath;
     }
     close();
 }
 
+void ScreenshotDisplay::copySelectionToClipboard() {
+    const QRect captureRect = exportRect();
+    QApplication::clipboard()->setPixmap(renderCapture(captureRect));
+    close();
+}
+
 void ScreenshotDisplay::updateTooltip() {
     if (selectionRect.isValid()) {
         QString tooltipText = QString("Size: %1 x %2").arg(selectionRect.width()).arg(selectionRect.height());
-        QPoint tooltipPosition = selectionRect.topRight() + QPoint(10, -20);
-        QToolTip::showText(mapToGlobal(tooltipPosition), tooltipText, this);
+        QPoint tooltipPosition = toView(selectionRect).topRight() + QPoint(10, -20);
+        QToolTip::showText(tooltipPosition + desktopGeometry.topLeft(), tooltipText, surfaceAt(tooltipPosition));
     }
 }
 
@@ -660,33 +1478,33 @@ ScreenshotDisplay::HandlePosition ScreenshotDisplay::handleAtPoint(const QPoint&
 }
 
 void ScreenshotDisplay::resizeSelection(const QPoint& point) {
-    QRect bounds(QPoint(0, 0), size());
+    const QRect bounds = overlayRect();
     QRect newRect = selectionRect;
 
     switch (currentHandle) {
     case TopLeft:
-        newRect.setTopLeft(point);
+        newRect.setTopLeft(QPoint(snapEdge(Qt::Vertical, point, false), snapEdge(Qt::Horizontal, point, false)));
         break;
     case TopRight:
-        newRect.setTopRight(point);
+        newRect.setTopRight(QPoint(snapEdge(Qt::Vertical, point, true), snapEdge(Qt::Horizontal, point, false)));
         break;
     case BottomLeft:
-        newRect.setBottomLeft(point);
+        newRect.setBottomLeft(QPoint(snapEdge(Qt::Vertical, point, false), snapEdge(Qt::Horizontal, point, true)));
         break;
     case BottomRight:
-        newRect.setBottomRight(point);
+        newRect.setBottomRight(QPoint(snapEdge(Qt::Vertical, point, true), snapEdge(Qt::Horizontal, point, true)));
         break;
     case Top:
-        newRect.setTop(point.y());
+        newRect.setTop(snapEdge(Qt::Horizontal, point, false));
         break;
     case Bottom:
-        newRect.setBottom(point.y());
+        newRect.setBottom(snapEdge(Qt::Horizontal, point, true));
         break;
     case Left:
-        newRect.setLeft(point.x());
+        newRect.setLeft(snapEdge(Qt::Vertical, point, false));
         break;
     case Right:
-        newRect.setRight(point.x());
+        newRect.setRight(snapEdge(Qt::Vertical, point, true));
         break;
     default:
         break;
@@ -697,6 +1515,44 @@ void ScreenshotDisplay::resizeSelection(const QPoint& point) {
     selectionRect = newRect;
 }
 
+void ScreenshotDisplay::setHoveredWindow(const QRect& rect) {
+    if (rect == hoveredWindow) {
+        return;
+    }
+    damage(selectionBounds(hoveredWindow).united(selectionBounds(rect)));
+    hoveredWindow = rect;
+}
+
+int ScreenshotDisplay::snapEdge(Qt::Orientation edge, const QPoint& position, bool trailing) const {
+    const bool vertical = edge == Qt::Vertical;
+    const int coordinate = vertical ? position.x() : position.y();
+    if (!edgeMap || (QGuiApplication::keyboardModifiers() & Qt::AltModifier)) {
+        return coordinate;
+    }
+
+    for (const CapturedScreen& screen : captureScreens) {
+        if (!screen.logical.contains(position)) {
+            continue;
+        }
+        // The map stores boundaries between pixels in the capture's native
+        // pixels. Right and bottom edges are inclusive, so their boundary is
+        // one pixel further and they stop on the last pixel before the edge.
+        const int boundary = coordinate + (trailing ? 1 : 0);
+        const QPointF physical = screen.toPhysical(QRectF(vertical ? QPointF(boundary, position.y()) : QPointF(position.x(), boundary), QSizeF(1, 1))).topLeft();
+        const int radius = qRound(kSnapDistance * screen.ratio);
+        const int found = vertical ? edgeMap->nearestVertical(qRound(physical.x()), qRound(physical.y()), radius)
+                                   : edgeMap->nearestHorizontal(qRound(physical.x()), qRound(physical.y()), radius);
+        const int first = vertical ? screen.physical.left() : screen.physical.top();
+        const int last = vertical ? screen.physical.right() + 1 : screen.physical.bottom() + 1;
+        if (found < first || found > last) {
+            return coordinate;
+        }
+        const int logicalFirst = vertical ? screen.logical.left() : screen.logical.top();
+        return logicalFirst + qRound((found - first) / screen.ratio) - (trailing ? 1 : 0);
+    }
+    return coordinate;
+}
+
 Qt::CursorShape ScreenshotDisplay::cursorForHandle(HandlePosition handle) {
     switch (handle) {
     case TopLeft:
@@ -718,7 +1574,13 @@ Qt::CursorShape ScreenshotDisplay::cursorForHandle(HandlePosition handle) {
 
 void ScreenshotDisplay::onToolSelected(Editor::Tool tool) {
     currentTool = tool;
-    setCursor(tool == Editor::None ? Qt::ArrowCursor : Qt::CrossCursor);
+    setOverlayCursor(tool == Editor::None || tool == Editor::Select ? Qt::ArrowCursor : Qt::CrossCursor);
+    if (tool != Editor::Select) {
+        selectAnnotation(0);
+    }
+    damage(borderCircleBounds(cursorPosition).united(loupeBounds(cursorPosition)));
+    cursorPosition = toCanvas(QCursor::pos() - desktopGeometry.topLeft());
+    damage(borderCircleBounds(cursorPosition).united(loupeBounds(cursorPosition)));
 }
 
 void ScreenshotDisplay::updateEditorPosition() {
@@ -726,10 +1588,14 @@ void ScreenshotDisplay::updateEditorPosition() {
         const int margin = 10;
         QSize editorSize = editor->sizeHint();
 
-        const QPoint globalTopRight = mapToGlobal(selectionRect.topRight());
-        const QPoint globalTopLeft = mapToGlobal(selectionRect.topLeft());
-        const QPoint globalCenter = mapToGlobal(selectionRect.center());
-        const QRect globalBounds = geometry();
+        const QRect shown = toView(selectionRect);
+        const QPoint globalTopRight = shown.topRight() + desktopGeometry.topLeft();
+        const QPoint globalTopLeft = shown.topLeft() + desktopGeometry.topLeft();
+        const QPoint globalCenter = shown.center() + desktopGeometry.topLeft();
+        // Keep the editor on the screen holding the middle of the selection
+        // rather than letting it straddle two monitors.
+        const OverlaySurface* host = surfaceAt(shown.center());
+        const QRect globalBounds = host ? host->geometry() : desktopGeometry;
 
         int desiredX = globalTopRight.x() + margin;
         if (desiredX + editorSize.width() > globalBounds.right() - margin) {
@@ -750,24 +1616,312 @@ void ScreenshotDisplay::updateEditorPosition() {
     }
 }
 
-void ScreenshotDisplay::drawArrow(QPainter& painter, const QPoint& start, const QPoint& end) {
-    painter.drawLine(start, end);
+QRect ScreenshotDisplay::segmentBounds(const QPoint& start, const QPoint& end) const {
+    const int margin = borderWidth / 2 + 2;
+    return QRect(start, end).normalized().adjusted(-margin, -margin, margin, margin);
+}
+
+void ScreenshotDisplay::commitStroke() {
+    const QRect bounds = strokeBounds.intersected(drawingLayer.rect());
+    strokeBounds = QRect();
+    if (bounds.isEmpty()) {
+        return;
+    }
+
+    // The live stroke layer is only a preview; the stroke itself becomes an
+    // annotation rendered by the scene, so its tiles can go.
+    drawingLayer.clear();
+
+    // Only the simplified points are kept; the scene draws them as a curve.
+    const int samples = strokeBuilder.sampleCount();
+    Annotation stroke;
+    stroke.kind = Annotation::Pen;
+    stroke.color = editor->getCurrentColor();
+    stroke.width = borderWidth;
+    stroke.points = strokeBuilder.finish();
+    PerfMetrics::instance().addCounter(QStringLiteral("stroke_samples"), samples);
+    PerfMetrics::instance().addCounter(QStringLiteral("stroke_points_kept"), stroke.points.size());
+    addAnnotation(stroke);
+    damage(bounds);
+}
+
+QRect ScreenshotDisplay::selectionBounds(const QRect& rect) const {
+    if (!rect.isValid()) {
+        return QRect();
+    }
+    // Dashed border plus the handle squares drawn by drawHandles().
+    const int margin = 8;
+    return rect.adjusted(-margin, -margin, margin, margin);
+}
+
+QRect ScreenshotDisplay::shapePreviewBounds() const {
+    if (!shapeDrawing) {
+        return QRect();
+    }
+    return isRedactionTool() ? currentShapeRect.adjusted(-2, -2, 2, 2) : previewAnnotation().bounds();
+}
+
+Annotation ScreenshotDisplay::previewAnnotation() const {
+    Annotation annotation;
+    annotation.color = editor->getCurrentColor();
+    annotation.width = borderWidth;
+    switch (editor->getCurrentTool()) {
+    case Editor::Rectangle:
+        annotation.kind = Annotation::Rectangle;
+        annotation.rect = currentShapeRect;
+        break;
+    case Editor::Ellipse:
+        annotation.kind = Annotation::Ellipse;
+        annotation.rect = currentShapeRect;
+        break;
+    case Editor::Line:
+        annotation.kind = Annotation::Line;
+        annotation.points = { lastPoint, drawingEnd };
+        break;
+    case Editor::Arrow:
+        annotation.kind = Annotation::Arrow;
+        annotation.points = { lastPoint, drawingEnd };
+        break;
+    default:
+        annotation.kind = Annotation::Pen;
+        annotation.points = strokeBuilder.points();
+        break;
+    }
+    return annotation;
+}
+
+QRect ScreenshotDisplay::annotationDamage(const Annotation& annotation) const {
+    // Covers the dashed outline drawn around the selected annotation.
+    return annotation.bounds().adjusted(-3, -3, 3, 3);
+}
+
+void ScreenshotDisplay::addAnnotation(const Annotation& annotation) {
+    const int id = scene.add(annotation);
+    const Annotation added = *scene.find(id);
+    undoHistory.pushAction(
+        [this, added]() {
+            if (selectedAnnotation == added.id) {
+                selectedAnnotation = 0;
+            }
+            scene.remove(added.id);
+            return annotationDamage(added);
+        },
+        [this, added]() {
+            scene.restore(added);
+            return annotationDamage(added);
+        });
+    damage(annotationDamage(added));
+}
+
+// Arguments are copies on purpose: callers often pass shapes owned by the
+// scene, and replace() drops the stored instance.
+void ScreenshotDisplay::replaceAnnotation(Annotation before, Annotation after) {
+    scene.replace(after);
+    const QRect dirty = annotationDamage(before).united(annotationDamage(after));
+    undoHistory.pushAction(
+        [this, before, dirty]() {
+            scene.replace(before);
+            return dirty;
+        },
+        [this, after, dirty]() {
+            scene.replace(after);
+            return dirty;
+        });
+    damage(dirty);
+}
+
+void ScreenshotDisplay::deleteSelectedAnnotation() {
+    const Annotation* selected = scene.find(selectedAnnotation);
+    if (!selected) {
+        return;
+    }
+    const Annotation removed = *selected;
+    selectedAnnotation = 0;
+    scene.remove(removed.id);
+    undoHistory.pushAction(
+        [this, removed]() {
+            scene.restore(removed);
+            return annotationDamage(removed);
+        },
+        [this, removed]() {
+            if (selectedAnnotation == removed.id) {
+                selectedAnnotation = 0;
+            }
+            scene.remove(removed.id);
+            return annotationDamage(removed);
+        });
+    damage(annotationDamage(removed));
+}
+
+void ScreenshotDisplay::selectAnnotation(int id) {
+    if (id == selectedAnnotation) {
+        return;
+    }
+    if (const Annotation* previous = scene.find(selectedAnnotation)) {
+        damage(annotationDamage(*previous));
+    }
+    selectedAnnotation = id;
+    if (const Annotation* current = scene.find(selectedAnnotation)) {
+        damage(annotationDamage(*current));
+    }
+}
+
+bool ScreenshotDisplay::showsBorderCircle() const {
+    const Editor::Tool tool = editor->getCurrentTool();
+    return tool != Editor::None && tool != Editor::Select;
+}
+
+bool ScreenshotDisplay::isRedactionTool() const {
+    const Editor::Tool tool = editor->getCurrentTool();
+    return tool == Editor::Pixelate || tool == Editor::Blur;
+}
+
+void ScreenshotDisplay::runRedactionKernel(QImage& image, const QRect& area, qreal scale) const {
+    // Strength follows the border width, in logical pixels, so the wheel
+    // adjusts it like any other tool.
+    const int strength = std::max(1, qRound(borderWidth * 3 * scale));
+    if (editor->getCurrentTool() == Editor::Pixelate) {
+        pixelate(image, area, std::max(2, strength));
+    }
+    else {
+        boxBlur(image, area, strength);
+    }
+}
+
+void ScreenshotDisplay::updateRedactionPreview() {
+    const QRect area = currentShapeRect.intersected(overlayRect());
+    redactionPreviewRect = area;
+    if (area.width() < 2 || area.height() < 2 || redactionSource.isNull()) {
+        redactionPreview = QImage();
+        return;
+    }
+
+    // The preview is filtered from a nearest-neighbour copy at logical
+    // resolution or below; the native-resolution pass runs once on release.
+    const qreal scale = std::min(1.0, std::sqrt(double(kRedactionPreviewPixels) / (double(area.width()) * area.height())));
+    const QSize size(std::max(1, qRound(area.width() * scale)), std::max(1, qRound(area.height() * scale)));
+    if (redactionPreview.size() != size) {
+        redactionPreview = QImage(size, redactionSource.format());
+    }
+    resampleNearest(redactionSource, toPixmapRect(area), redactionPreview);
+    runRedactionKernel(redactionPreview, redactionPreview.rect(), scale);
+}
+
+void ScreenshotDisplay::applyRedaction(const QRect& area) {
+    redactionSource = QImage();
+    redactionPreview = QImage();
+    const QRect target = area.intersected(overlayRect());
+    if (target.width() < 2 || target.height() < 2) {
+        damage(area.adjusted(-2, -2, 2, 2));
+        return;
+    }
+
+    undoHistory.beginStep(originalPixmap, toPixmapRect(target));
+
+    // Drop the pixmap's reference (and the pyramid's) first so writing to the image does not
+    // detach a full copy of the capture.
+    releaseCapturePyramid();
+    QImage image = originalPixmap.toImage();
+    originalPixmap = QPixmap();
+    if (image.depth() != 32) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    for (const CapturedScreen& screen : captureScreens) {
+        const QRect piece = target.intersected(screen.logical);
+        if (!piece.isEmpty()) {
+            runRedactionKernel(image, screen.toPhysical(QRectF(piece)).toAlignedRect(), screen.ratio);
+        }
+    }
+    originalPixmap = QPixmap::fromImage(std::move(image));
+
+    undoHistory.endStep(originalPixmap, target);
+    damage(area.adjusted(-2, -2, 2, 2));
+}
+
+QRect ScreenshotDisplay::exportRect() const {
+    return selectionRect.isValid() ? selectionRect : overlayRect();
+}
 
-    double angle = std::atan2(start.y() - end.y(), start.x() - end.x());
+QPixmap ScreenshotDisplay::renderCapture(const QRect& selection) const {
+    // Crop first: only the exported rect of the base image and of the
+    // annotation layers is ever copied, rasterized or blended.
+    QElapsedTimer timer;
+    timer.start();
+    const QRect area = selection.intersected(overlayRect());
+
+    // The export uses the highest density among the screens it touches. A
+    // selection inside one screen is a straight crop of its native pixels;
+    // only selections spanning screens of different density resample.
+    qreal ratio = 0.0;
+    int touched = 0;
+    const CapturedScreen* single = nullptr;
+    for (const CapturedScreen& screen : captureScreens) {
+        if (screen.logical.intersects(area)) {
+            ratio = std::max(ratio, screen.ratio);
+            single = &screen;
+            ++touched;
+        }
+    }
+    if (ratio <= 0.0) {
+        return QPixmap();
+    }
 
-    const double arrowHeadLength = borderWidth * 5;
-    const double arrowHeadAngle = M_PI / 15;
+    QImage result;
+    if (touched == 1 && single->logical.contains(area)) {
+        result = originalPixmap.copy(single->toPhysical(QRectF(area)).toAlignedRect()).toImage()
+            .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    else {
+        result = QImage((QSizeF(area.size()) * ratio).toSize(), QImage::Format_ARGB32_Premultiplied);
+        result.fill(Qt::transparent);
+        QPainter painter(&result);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        for (const CapturedScreen& screen : captureScreens) {
+            const QRect piece = area.intersected(screen.logical);
+            if (piece.isEmpty()) {
+                continue;
+            }
+            const QRectF target(QPointF(piece.topLeft() - area.topLeft()) * ratio, QSizeF(piece.size()) * ratio);
+            painter.drawPixmap(target, originalPixmap, screen.toPhysical(QRectF(piece)));
+        }
+    }
 
-    QPoint arrowP1 = end + QPoint(std::cos(angle + arrowHeadAngle) * arrowHeadLength,
-        std::sin(angle + arrowHeadAngle) * arrowHeadLength);
-    QPoint arrowP2 = end + QPoint(std::cos(angle - arrowHeadAngle) * arrowHeadLength,
-        std::sin(angle - arrowHeadAngle) * arrowHeadLength);
+    if (scene.intersects(area) || strokeBounds.intersects(area)) {
+        // Annotations are vector shapes, so they are rendered straight at the
+        // export density.
+        QImage layer(result.size(), QImage::Format_ARGB32_Premultiplied);
+        layer.fill(Qt::transparent);
+        QPainter painter(&layer);
+        painter.scale(qreal(layer.width()) / area.width(), qreal(layer.height()) / area.height());
+        painter.translate(-area.topLeft());
+        scene.render(painter, area);
+        drawingLayer.draw(painter, area);
+        painter.end();
+        blendPremultiplied(result, layer);
+    }
 
-    QPolygon arrowHead;
-    arrowHead << end << arrowP1 << arrowP2;
+    // Trimming works on the rendered pixels, so annotations drawn in a
+    // margin keep it, and it happens before anything is encoded.
+    if (configManager) {
+        const QJsonObject config = configManager->loadConfig();
+        if (config["auto_trim"].toBool(false)) {
+            QElapsedTimer trimTimer;
+            trimTimer.start();
+            const QRect content = trimUniformBorders(result, config["trim_tolerance"].toInt(8));
+            if (content != result.rect()) {
+                result = result.copy(content);
+            }
+            PerfMetrics::instance().addSample(QStringLiteral("trim_us"), trimTimer.nsecsElapsed() / 1000);
+        }
+    }
+
+    PerfMetrics::instance().addSample(QStringLiteral("export_us"), timer.nsecsElapsed() / 1000);
+    return QPixmap::fromImage(result);
+}
 
-    painter.setBrush(QBrush(editor->getCurrentColor()));
-    painter.drawPolygon(arrowHead);
+QRect ScreenshotDisplay::borderCircleBounds(const QPoint& position) const {
+    const int radius = borderWidth + 2;
+    return QRect(position - QPoint(radius, radius), QSize(radius * 2 + 1, radius * 2 + 1));
 }
 
 void ScreenshotDisplay::drawBorderCircle(QPainter& painter, const QPoint& position) {
@@ -776,17 +1930,127 @@ void ScreenshotDisplay::drawBorderCircle(QPainter& painter, const QPoint& positi
     painter.drawEllipse(position, borderWidth, borderWidth);
 }
 
+bool ScreenshotDisplay::showsLoupe() const {
+    // Only while the selection is being placed: before the first press, and
+    // while an edge or corner is dragged.
+    // Zoomed, the view already magnifies.
+    return editor->getCurrentTool() == Editor::None && !movingSelection && !isZoomed()
+        && (selectionStarted || currentHandle != None || !selectionRect.isValid());
+}
+
+QRect ScreenshotDisplay::loupeBounds(const QPoint& position) const {
+    const QSize size(kLoupeSamples * kLoupeZoom + 2, kLoupeSamples * kLoupeZoom + kLoupeInfoHeight + 2);
+
+    // Placed below-right of the cursor, flipped to stay on the cursor's screen.
+    QRect bounds = overlayRect();
+    for (const CapturedScreen& screen : captureScreens) {
+        if (screen.logical.contains(position)) {
+            bounds = screen.logical;
+            break;
+        }
+    }
+    QPoint topLeft = position + QPoint(kLoupeOffset, kLoupeOffset);
+    if (topLeft.x() + size.width() > bounds.right()) {
+        topLeft.setX(position.x() - kLoupeOffset - size.width());
+    }
+    if (topLeft.y() + size.height() > bounds.bottom()) {
+        topLeft.setY(position.y() - kLoupeOffset - size.height());
+    }
+    return QRect(topLeft, size);
+}
+
+void ScreenshotDisplay::drawLoupe(QPainter& painter, const QPoint& position) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Capture pixel under the cursor, in the native pixels of its screen.
+    QPoint centre = position;
+    for (const CapturedScreen& screen : captureScreens) {
+        if (screen.logical.contains(position)) {
+            const QPointF physical = screen.toPhysical(QRectF(position, QSizeF(1, 1))).topLeft();
+            centre = QPoint(int(std::floor(physical.x())), int(std::floor(physical.y())));
+            break;
+        }
+    }
+    const QRect samples(centre - QPoint(kLoupeSamples / 2, kLoupeSamples / 2), QSize(kLoupeSamples, kLoupeSamples));
+
+    // The cache is refilled when the cursor leaves it or the capture changed
+    // (the pixmap's cache key changes whenever it is painted on).
+    if (loupeCacheKey != originalPixmap.cacheKey() || !loupeCacheRect.contains(samples)) {
+        loupeCacheRect = QRect(centre - QPoint(kLoupeCacheSize / 2, kLoupeCacheSize / 2), QSize(kLoupeCacheSize, kLoupeCacheSize))
+            .intersected(originalPixmap.rect());
+        loupeCache = originalPixmap.copy(loupeCacheRect).toImage();
+        loupeCacheKey = originalPixmap.cacheKey();
+    }
+
+    const QRect bounds = loupeBounds(position);
+    const QRect zoomRect(bounds.topLeft() + QPoint(1, 1), QSize(kLoupeSamples * kLoupeZoom, kLoupeSamples * kLoupeZoom));
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.fillRect(bounds, QColor(17, 24, 39));
+
+    // Nearest-neighbour zoom of the visible part of the sample block; pixels
+    // outside the capture stay dark.
+    const QRect visible = samples.intersected(loupeCacheRect);
+    if (!visible.isEmpty()) {
+        const QRect target(zoomRect.topLeft() + (visible.topLeft() - samples.topLeft()) * kLoupeZoom, visible.size() * kLoupeZoom);
+        painter.drawImage(target, loupeCache, visible.translated(-loupeCacheRect.topLeft()));
+    }
+
+    QVector<QLine> grid;
+    grid.reserve(2 * (kLoupeSamples - 1));
+    for (int i = 1; i < kLoupeSamples; ++i) {
+        const int x = zoomRect.left() + i * kLoupeZoom;
+        const int y = zoomRect.top() + i * kLoupeZoom;
+        grid << QLine(x, zoomRect.top(), x, zoomRect.bottom()) << QLine(zoomRect.left(), y, zoomRect.right(), y);
+    }
+    painter.setPen(QPen(QColor(255, 255, 255, 40), 1));
+    painter.drawLines(grid);
+
+    const QRect centreCell(zoomRect.topLeft() + QPoint(kLoupeSamples / 2, kLoupeSamples / 2) * kLoupeZoom, QSize(kLoupeZoom, kLoupeZoom));
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QPen(Qt::black, 1));
+    painter.drawRect(centreCell.adjusted(-1, -1, 0, 0));
+    painter.setPen(QPen(Qt::white, 1));
+    painter.drawRect(centreCell.adjusted(0, 0, -1, -1));
+
+    QColor colour(Qt::black);
+    if (loupeCacheRect.contains(centre)) {
+        colour = loupeCache.pixelColor(centre - loupeCacheRect.topLeft());
+    }
+    const QRect info(zoomRect.left(), zoomRect.bottom() + 1, zoomRect.width(), kLoupeInfoHeight);
+    const QRect swatch(info.left() + 6, info.top() + 9, 16, 16);
+    painter.fillRect(swatch, colour);
+    painter.setPen(QPen(QColor(255, 255, 255, 120), 1));
+    painter.drawRect(swatch);
+    painter.setPen(Qt::white);
+    painter.drawText(info.adjusted(swatch.width() + 12, 0, -4, 0), Qt::AlignVCenter | Qt::AlignLeft,
+        QStringLiteral("%1, %2\n%3").arg(position.x()).arg(position.y()).arg(colour.name().toUpper()));
+
+    painter.setPen(QPen(QColor(255, 255, 255, 160), 1));
+    painter.drawRect(bounds.adjusted(0, 0, -1, -1));
+    painter.restore();
+
+    PerfMetrics::instance().addSample(QStringLiteral("loupe_us"), timer.nsecsElapsed() / 1000);
+}
+
 QRect ScreenshotDisplay::toPixmapRect(const QRect& rect) const {
     if (!rect.isValid()) {
         return QRect();
     }
 
-    const qreal scale = pixmapDeviceRatio <= 0.0 ? 1.0 : pixmapDeviceRatio;
-    const QPointF topLeft = rect.topLeft();
-    const QSizeF size = rect.size();
-    const QPoint scaledTopLeft(std::lround(topLeft.x() * scale), std::lround(topLeft.y() * scale));
-    const QSize scaledSize(std::lround(size.width() * scale), std::lround(size.height() * scale));
-    return QRect(scaledTopLeft, scaledSize);
+    // Screens keep their own scale, so a rect spanning several of them maps
+    // to the union of its per-screen pieces.
+    QRect mapped;
+    for (const CapturedScreen& screen : captureScreens) {
+        const QRect piece = rect.intersected(screen.logical);
+        if (!piece.isEmpty()) {
+            mapped = mapped.united(screen.toPhysical(QRectF(piece)).toAlignedRect());
+        }
+    }
+    return mapped;
 }
 
 void ScreenshotDisplay::adjustTextEditSize() {
@@ -797,41 +2061,37 @@ void ScreenshotDisplay::adjustTextEditSize() {
 
 void ScreenshotDisplay::finalizeTextEdit() {
     if (textEdit) {
-        saveStateForUndo();
-        QPainter painter(&originalPixmap);
-        painter.setFont(textEdit->font());
-        painter.setPen(QPen(editor->getCurrentColor()));
-
         QFontMetrics fm(textEdit->font());
-        QStringList lines = textEdit->toPlainText().split('\n');
-        QPoint currentPos = textEditPosition;
+        QPoint startPos = textEditPosition;
 
         QMargins contentMargins = textEdit->contentsMargins();
         int leftMargin = contentMargins.left();
         int topMargin = contentMargins.top();
 
-        currentPos.setY(currentPos.y() + fm.height() + topMargin);
-        currentPos.setX(currentPos.x() + fm.descent() + leftMargin);
-
-        for (const QString& line : lines) {
-            painter.drawText(currentPos, line);
-            currentPos.setY(currentPos.y() + fm.height());
+        startPos.setY(startPos.y() + fm.height() + topMargin);
+        startPos.setX(startPos.x() + fm.descent() + leftMargin);
+
+        Annotation label;
+        label.kind = Annotation::Text;
+        label.color = editor->getCurrentColor();
+        label.font = textEdit->font();
+        label.text = textEdit->toPlainText();
+        label.textOrigin = startPos;
+        if (!label.text.trimmed().isEmpty()) {
+            addAnnotation(label);
         }
 
         textEdit->deleteLater();
         textEdit = nullptr;
-        update();
     }
 }
 
-void ScreenshotDisplay::saveStateForUndo() {
-    undoStack.push(originalPixmap);
+void ScreenshotDisplay::undo() {
+    releaseCapturePyramid();
+    damage(undoHistory.undo(originalPixmap));
 }
 
-void ScreenshotDisplay::undo() {
-    if (!undoStack.empty()) {
-        originalPixmap = undoStack.top();
-        undoStack.pop();
-        update();
-    }
+void ScreenshotDisplay::redo() {
+    releaseCapturePyramid();
+    damage(undoHistory.redo(originalPixmap));
 }
@@ -0,0 +1,188 @@
+#include "../include/scroll_capture.h"
+#include "../include/perf_metrics.h"
+#include <QCursor>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QHBoxLayout>
+#include <QPixmap>
+#include <QScreen>
+#include <QVBoxLayout>
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+// Long enough for the overlay to be unmapped before the first grab.
+constexpr int kStartDelayMs = 200;
+constexpr int kGrabIntervalMs = 80;
+// Auto-scroll ends once this many grabs in a row show no movement.
+constexpr int kIdleFramesToStop = 6;
+constexpr int kPanelMargin = 8;
+}
+
+ScrollCapture::ScrollCapture(const QRect& area, QWidget* parent)
+    : QWidget(parent),
+    area(area),
+    statusLabel(new QLabel(this)),
+    autoScrollButton(new QPushButton(tr("Auto-scroll"), this)),
+    idleFrames(0) {
+    setWindowFlags(Qt::Tool | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
+    setAttribute(Qt::WA_StyledBackground);
+    setObjectName("scrollCapturePanel");
+    setStyleSheet(R"(
+        #scrollCapturePanel {
+            background-color: rgba(15, 23, 42, 0.93);
+            border: 1px solid rgba(148, 163, 184, 0.25);
+            border-radius: 10px;
+        }
+        #scrollCapturePanel QLabel {
+            color: #E2E8F0;
+        }
+        #scrollCapturePanel QPushButton {
+            background-color: rgba(148, 163, 184, 0.12);
+            border: 1px solid transparent;
+            border-radius: 6px;
+            color: #E2E8F0;
+            padding: 4px 10px;
+        }
+        #scrollCapturePanel QPushButton:hover {
+            background-color: rgba(148, 163, 184, 0.22);
+        }
+        #scrollCapturePanel QPushButton:checked {
+            background-color: #2563EB;
+        }
+    )");
+
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(10, 8, 10, 8);
+    layout->addWidget(statusLabel);
+
+    auto* buttons = new QHBoxLayout();
+    autoScrollButton->setCheckable(true);
+    autoScrollButton->setVisible(canAutoScroll());
+    auto* doneButton = new QPushButton(tr("Done"), this);
+    auto* cancelButton = new QPushButton(tr("Cancel"), this);
+    buttons->addWidget(autoScrollButton);
+    buttons->addWidget(doneButton);
+    buttons->addWidget(cancelButton);
+    layout->addLayout(buttons);
+
+    connect(doneButton, &QPushButton::clicked, this, &ScrollCapture::finish);
+    connect(cancelButton, &QPushButton::clicked, this, &ScrollCapture::cancel);
+    connect(autoScrollButton, &QPushButton::toggled, this, [this](bool enabled) {
+        idleFrames = 0;
+        if (enabled) {
+            // Wheel events go to the window under the pointer.
+            QCursor::setPos(this->area.center());
+        }
+    });
+
+    grabTimer.setInterval(kGrabIntervalMs);
+    connect(&grabTimer, &QTimer::timeout, this, &ScrollCapture::grabFrame);
+
+    statusLabel->setText(tr("Scroll the page, then press Done"));
+}
+
+void ScrollCapture::start() {
+    adjustSize();
+    QScreen* screen = QGuiApplication::screenAt(area.center());
+    const QRect bounds = screen ? screen->geometry() : area;
+    QPoint position(area.left(), area.bottom() + kPanelMargin);
+    if (position.y() + height() > bounds.bottom()) {
+        position.setY(area.top() - kPanelMargin - height());
+    }
+    if (position.y() < bounds.top()) {
+        position.setY(bounds.top() + kPanelMargin);
+    }
+    position.setX(std::max(bounds.left(), std::min(position.x(), bounds.right() - width())));
+    move(position);
+    show();
+    raise();
+
+    QTimer::singleShot(kStartDelayMs, this, [this]() {
+        if (!isVisible()) {
+            return;
+        }
+        grabFrame();
+        grabTimer.start();
+    });
+}
+
+bool ScrollCapture::canAutoScroll() {
+#if defined(Q_OS_WIN)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ScrollCapture::scrollOnce() {
+#if defined(Q_OS_WIN)
+    INPUT input = {};
+    input.type = INPUT_MOUSE;
+    input.mi.dwFlags = MOUSEEVENTF_WHEEL;
+    input.mi.mouseData = static_cast<DWORD>(-WHEEL_DELTA);
+    SendInput(1, &input, sizeof(INPUT));
+#endif
+}
+
+void ScrollCapture::grabFrame() {
+    QScreen* screen = QGuiApplication::screenAt(area.center());
+    if (!screen) {
+        return;
+    }
+    const QRect grabArea = area.intersected(screen->geometry()).translated(-screen->geometry().topLeft());
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    const QPixmap grab = screen->grabWindow(0, grabArea.x(), grabArea.y(), grabArea.width(), grabArea.height());
+    const ScrollStitcher::Result result = stitcher.addFrame(grab.toImage());
+    PerfMetrics::instance().addSample(QStringLiteral("scroll_frame_us"), frameTimer.nsecsElapsed() / 1000);
+
+    if (result == ScrollStitcher::Failed && stitcher.frameCount() > 0) {
+        // The page reached the height limit; keep what we have.
+        finish();
+        return;
+    }
+    updateStatus(result);
+
+    if (autoScrollButton->isChecked()) {
+        idleFrames = result == ScrollStitcher::Unchanged ? idleFrames + 1 : 0;
+        if (idleFrames >= kIdleFramesToStop) {
+            finish();
+            return;
+        }
+        scrollOnce();
+    }
+}
+
+void ScrollCapture::updateStatus(ScrollStitcher::Result result) {
+    if (result == ScrollStitcher::NoOverlap) {
+        statusLabel->setText(tr("Lost track of the page, scroll back a little"));
+        return;
+    }
+    statusLabel->setText(tr("%1 frames, %2 px").arg(stitcher.frameCount()).arg(stitcher.height()));
+}
+
+void ScrollCapture::finish() {
+    grabTimer.stop();
+    hide();
+    const QImage image = stitcher.image();
+    stitcher.clear();
+    if (image.isNull()) {
+        emit cancelled();
+    }
+    else {
+        emit finished(image);
+    }
+    deleteLater();
+}
+
+void ScrollCapture::cancel() {
+    grabTimer.stop();
+    hide();
+    emit cancelled();
+    deleteLater();
+}
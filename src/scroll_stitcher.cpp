@@ -0,0 +1,259 @@
+#include "../include/scroll_stitcher.h"
+#include "../include/pixel_ops.h"
+#include <QDir>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Rows in the window of the new frame that is looked up in the previous one.
+// A frame can move by at most its scrolling band minus this between grabs.
+constexpr int kAnchorRows = 16;
+// Shifts whose window hash matches but whose rows differ are possible on
+// repetitive content; at most this many are verified per frame.
+constexpr int kMaxCandidates = 16;
+constexpr quint64 kRowPrime = 0x100000001B3ull;
+constexpr quint64 kWindowBase = 0x9E3779B97F4A7C15ull;
+
+inline quint64 finalize(quint64 h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Two interleaved FNV-style lanes, so the multiply latency is hidden.
+quint64 hashRow(const quint32* pixels, int width) {
+    quint64 a = 0xCBF29CE484222325ull;
+    quint64 b = 0x84222325CBF29CE4ull;
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        a = (a ^ pixels[x]) * kRowPrime;
+        b = (b ^ pixels[x + 1]) * kRowPrime;
+    }
+    if (x < width) {
+        a = (a ^ pixels[x]) * kRowPrime;
+    }
+    return finalize(a ^ (b << 31 | b >> 33));
+}
+
+QVector<quint64> hashRows(const QImage& image) {
+    QVector<quint64> hashes(image.height());
+    quint64* out = hashes.data();
+    const int width = image.width();
+    parallelFor(image.height(), static_cast<qint64>(width) * image.height(), [&image, out, width](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            out[y] = hashRow(reinterpret_cast<const quint32*>(image.constScanLine(y)), width);
+        }
+    });
+    return hashes;
+}
+
+// Polynomial hash of rows [first, first + length): sum of row * base^(length - 1 - i).
+quint64 windowHash(const quint64* rows, int first, int length) {
+    quint64 h = 0;
+    for (int i = 0; i < length; ++i) {
+        h = h * kWindowBase + rows[first + i];
+    }
+    return h;
+}
+
+// Scroll distance of the band [top, top + band) from previous to current:
+// the smallest d > 0 with current[top + y] == previous[top + y + d] for every
+// row the two frames share, or -1.
+int findShift(const QVector<quint64>& previous, const QVector<quint64>& current, int top, int band) {
+    const int window = std::min(kAnchorRows, band / 2);
+    if (window < 1) {
+        return -1;
+    }
+    const quint64* prev = previous.constData() + top;
+    const quint64* cur = current.constData() + top;
+
+    // Anchor on the first window near the top of the band that is not a
+    // single repeated row; flat areas match everywhere and say nothing.
+    int anchor = -1;
+    for (int s = 0; s + window <= band / 2 && anchor < 0; ++s) {
+        for (int i = 1; i < window; ++i) {
+            if (cur[s + i] != cur[s]) {
+                anchor = s;
+                break;
+            }
+        }
+    }
+    if (anchor < 0) {
+        return -1;
+    }
+    const quint64 wanted = windowHash(cur, anchor, window);
+
+    quint64 power = 1;
+    for (int i = 1; i < window; ++i) {
+        power *= kWindowBase;
+    }
+
+    // Candidates come in increasing d, so the first that verifies keeps the
+    // largest overlap.
+    int candidates = 0;
+    quint64 h = windowHash(prev, 0, window);
+    for (int p = 0; p + window <= band; ++p) {
+        if (p > 0) {
+            h = (h - prev[p - 1] * power) * kWindowBase + prev[p + window - 1];
+        }
+        const int d = p - anchor;
+        if (h != wanted || d <= 0) {
+            continue;
+        }
+        bool matches = true;
+        for (int y = 0; y + d < band && matches; ++y) {
+            matches = cur[y] == prev[y + d];
+        }
+        if (matches) {
+            return d;
+        }
+        if (++candidates == kMaxCandidates) {
+            break;
+        }
+    }
+    return -1;
+}
+
+}
+
+ScrollStitcher::ScrollStitcher(int maxHeight)
+    : maxHeight(maxHeight),
+    frameWidth(0),
+    frameHeight(0),
+    rows(0),
+    frames(0),
+    shift(0),
+    capacity(0),
+    buffer(QDir::tempPath() + QStringLiteral("/screenme_scroll_XXXXXX")),
+    mapped(nullptr) {
+}
+
+ScrollStitcher::~ScrollStitcher() {
+    clear();
+}
+
+void ScrollStitcher::clear() {
+    if (mapped) {
+        buffer.unmap(mapped);
+        mapped = nullptr;
+    }
+    if (buffer.isOpen()) {
+        buffer.resize(0);
+    }
+    capacity = 0;
+    frameWidth = 0;
+    frameHeight = 0;
+    rows = 0;
+    frames = 0;
+    shift = 0;
+    previous.clear();
+}
+
+bool ScrollStitcher::reserveRows(int count) {
+    if (count <= capacity) {
+        return true;
+    }
+    if (!buffer.isOpen() && !buffer.open()) {
+        return false;
+    }
+    // Doubling keeps the number of remaps logarithmic in the page length;
+    // the mapping has to be dropped while the file grows.
+    const qint64 rowBytes = static_cast<qint64>(frameWidth) * 4;
+    const qint64 grown = std::max<qint64>({ count, capacity * 2, static_cast<qint64>(frameHeight) * 4 });
+    if (mapped) {
+        buffer.unmap(mapped);
+        mapped = nullptr;
+    }
+    if (!buffer.resize(grown * rowBytes)) {
+        return false;
+    }
+    mapped = buffer.map(0, grown * rowBytes);
+    if (!mapped) {
+        return false;
+    }
+    capacity = grown;
+    return true;
+}
+
+void ScrollStitcher::writeRows(int destination, const QImage& frame, int first, int count) {
+    const qint64 rowBytes = static_cast<qint64>(frameWidth) * 4;
+    for (int i = 0; i < count; ++i) {
+        std::memcpy(mapped + (destination + i) * rowBytes, frame.constScanLine(first + i), rowBytes);
+    }
+}
+
+ScrollStitcher::Result ScrollStitcher::addFrame(const QImage& source) {
+    if (source.isNull()) {
+        return Failed;
+    }
+    const QImage frame = source.format() == QImage::Format_RGB32 ? source : source.convertToFormat(QImage::Format_RGB32);
+    const int h = frame.height();
+
+    if (frames == 0) {
+        frameWidth = frame.width();
+        frameHeight = h;
+        if (h > maxHeight || !reserveRows(h)) {
+            clear();
+            return Failed;
+        }
+        writeRows(0, frame, 0, h);
+        rows = h;
+        shift = h;
+        frames = 1;
+        previous = hashRows(frame);
+        return Appended;
+    }
+    if (frame.width() != frameWidth || h != frameHeight) {
+        return Failed;
+    }
+
+    const QVector<quint64> current = hashRows(frame);
+
+    // Rows identical in place belong to a sticky header or footer (or are
+    // simply the same on both frames); only the band between them scrolls.
+    int top = 0;
+    while (top < h && current[top] == previous[top]) {
+        ++top;
+    }
+    if (top == h) {
+        return Unchanged;
+    }
+    int bottom = 0;
+    while (bottom < h - top && current[h - 1 - bottom] == previous[h - 1 - bottom]) {
+        ++bottom;
+    }
+
+    const int d = findShift(previous, current, top, h - top - bottom);
+    if (d < 0) {
+        return NoOverlap;
+    }
+    if (rows + d > maxHeight || !reserveRows(rows + d)) {
+        return Failed;
+    }
+
+    // The new rows go below the content accepted so far, replacing the
+    // previous frame's footer, and the current footer follows them.
+    writeRows(rows - bottom, frame, h - bottom - d, d + bottom);
+    rows += d;
+    shift = d;
+    ++frames;
+    previous = current;
+    return Appended;
+}
+
+QImage ScrollStitcher::image() const {
+    if (rows == 0 || !mapped) {
+        return QImage();
+    }
+    QImage result(frameWidth, rows, QImage::Format_RGB32);
+    if (result.isNull()) {
+        return result;
+    }
+    const qint64 rowBytes = static_cast<qint64>(frameWidth) * 4;
+    for (int y = 0; y < rows; ++y) {
+        std::memcpy(result.scanLine(y), mapped + y * rowBytes, rowBytes);
+    }
+    return result;
+}
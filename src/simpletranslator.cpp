@@ -39,19 +39,25 @@ bool SimpleTranslator::loadLanguage(const QString& locale) {
     add("Editor", "Ellipse", "Ellipse");
     add("Editor", "Line", "Ligne");
     add("Editor", "Arrow", "Flèche");
+    add("Editor", "Select", "Sélectionner");
+    add("Editor", "Pixelate", "Pixeliser");
+    add("Editor", "Blur", "Flouter");
     add("Editor", "Save", "Enregistrer");
     add("Editor", "Copy", "Copier");
     add("Editor", "Upload", "Publier");
     add("Editor", "Print", "Imprimer");
+    add("Editor", "Scrolling capture", "Capture défilante");
     add("Editor", "Search", "Rechercher");
     add("Editor", "Close", "Fermer");
 
     add("MainWindow", "Unable to capture desktop", "Impossible de capturer le bureau");
+    add("MainWindow", "Unable to capture the active window", "Impossible de capturer la fenêtre active");
 
     add("OptionsWindow", "ScreenMe Options", "Options ScreenMe");
     add("OptionsWindow", "Screenshot Hotkey:", "Raccourci capture :");
     add("OptionsWindow", "Press any key...", "Appuyez sur une touche...");
     add("OptionsWindow", "Fullscreen Screenshot Hotkey:", "Raccourci capture plein écran :");
+    add("OptionsWindow", "Active Window Hotkey:", "Raccourci capture de la fenêtre active :");
     add("OptionsWindow", "File Extension:", "Extension de fichier :");
     add("OptionsWindow", "Image Quality:", "Qualité d'image :");
     add("OptionsWindow", "Default Save Folder:", "Dossier d'enregistrement :");
@@ -59,7 +65,11 @@ bool SimpleTranslator::loadLanguage(const QString& locale) {
     add("OptionsWindow", "Language:", "Langue :");
     add("OptionsWindow", "English", "Anglais");
     add("OptionsWindow", "Français", "Français");
+    add("OptionsWindow", "Total upload limit (KB/s, 0 = unlimited):", "Limite d'envoi totale (Ko/s, 0 = illimitée) :");
+    add("OptionsWindow", "Per upload limit (KB/s, 0 = unlimited):", "Limite par envoi (Ko/s, 0 = illimitée) :");
     add("OptionsWindow", "Start with system", "Démarrer avec le système");
+    add("OptionsWindow", "Trim uniform borders on export", "Rogner les bordures unies à l'export");
+    add("OptionsWindow", "Trim tolerance (per channel):", "Tolérance du rognage (par canal) :");
     add("OptionsWindow", "Save", "Enregistrer");
     add("OptionsWindow", "Select Folder", "Sélectionner un dossier");
     add("OptionsWindow", "Language updated", "Langue mise à jour");
@@ -87,9 +97,26 @@ bool SimpleTranslator::loadLanguage(const QString& locale) {
         "Une instance de ScreenMe est déjà ouverte. Veuillez fermer l'application existante avant de relancer.");
     add("QObject", "Screenshot saved", "Capture enregistrée");
     add("QObject", "Fullscreen capture stored at %1", "Capture plein écran enregistrée dans %1");
+    add("QObject", "Window capture stored at %1", "Capture de fenêtre enregistrée dans %1");
+    add("QObject", "Scrolling capture stored at %1", "Capture défilante enregistrée dans %1");
+    add("QObject", "Compare captures...", "Comparer des captures...");
 
     add("ScreenshotDisplay", "ScreenMe Capture", "Capture ScreenMe");
     add("ScreenshotDisplay", "Print Screenshot", "Imprimer la capture");
+    add("ScreenshotDisplay", "Threshold %1: %2 changed regions", "Seuil %1 : %2 zones modifiées");
+
+    add("MainWindow", "Select two captures to compare", "Sélectionnez deux captures à comparer");
+    add("MainWindow", "Images (*.png *.jpg *.jpeg *.bmp)", "Images (*.png *.jpg *.jpeg *.bmp)");
+    add("MainWindow", "Compare captures", "Comparer des captures");
+    add("MainWindow", "Select exactly two images.", "Sélectionnez exactement deux images.");
+    add("MainWindow", "Unable to open %1", "Impossible d'ouvrir %1");
+
+    add("ScrollCapture", "Auto-scroll", "Défilement auto");
+    add("ScrollCapture", "Done", "Terminer");
+    add("ScrollCapture", "Cancel", "Annuler");
+    add("ScrollCapture", "Scroll the page, then press Done", "Faites défiler la page, puis cliquez sur Terminer");
+    add("ScrollCapture", "Lost track of the page, scroll back a little", "Page perdue, remontez un peu");
+    add("ScrollCapture", "%1 frames, %2 px", "%1 images, %2 px");
 
     return true;
 }
@@ -0,0 +1,132 @@
+#include "../include/stroke.h"
+#include <QPointF>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+// Raw samples simplified at a time while drawing.
+constexpr int kBatchSize = 64;
+
+qreal squaredDistanceToSegment(const QPointF& point, const QPointF& a, const QPointF& b) {
+    const QPointF ab = b - a;
+    const qreal length = QPointF::dotProduct(ab, ab);
+    const qreal t = length > 0.0 ? std::clamp(QPointF::dotProduct(point - a, ab) / length, 0.0, 1.0) : 0.0;
+    const QPointF offset = point - (a + ab * t);
+    return QPointF::dotProduct(offset, offset);
+}
+}
+
+QVector<QPoint> simplifyPolyline(const QVector<QPoint>& points, qreal tolerance) {
+    const int count = points.size();
+    if (count < 3) {
+        return points;
+    }
+
+    // An explicit stack of ranges instead of recursion, so very long strokes
+    // cannot exhaust the call stack.
+    std::vector<bool> keep(count, false);
+    keep[0] = true;
+    keep[count - 1] = true;
+    std::vector<std::pair<int, int>> ranges = { { 0, count - 1 } };
+    const qreal limit = tolerance * tolerance;
+    while (!ranges.empty()) {
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+        qreal farthest = limit;
+        int split = -1;
+        for (int i = first + 1; i < last; ++i) {
+            const qreal distance = squaredDistanceToSegment(points[i], points[first], points[last]);
+            if (distance > farthest) {
+                farthest = distance;
+                split = i;
+            }
+        }
+        if (split >= 0) {
+            keep[split] = true;
+            ranges.emplace_back(first, split);
+            ranges.emplace_back(split, last);
+        }
+    }
+
+    QVector<QPoint> result;
+    result.reserve(static_cast<int>(std::count(keep.begin(), keep.end(), true)));
+    for (int i = 0; i < count; ++i) {
+        if (keep[i]) {
+            result.append(points[i]);
+        }
+    }
+    return result;
+}
+
+QPainterPath smoothStrokePath(const QVector<QPoint>& points) {
+    QPainterPath path;
+    const int count = points.size();
+    if (count == 0) {
+        return path;
+    }
+    path.moveTo(points.first());
+    for (int i = 0; i + 1 < count; ++i) {
+        const QPointF p0 = points[std::max(i - 1, 0)];
+        const QPointF p1 = points[i];
+        const QPointF p2 = points[i + 1];
+        const QPointF p3 = points[std::min(i + 2, count - 1)];
+        path.cubicTo(p1 + (p2 - p0) / 6.0, p2 - (p3 - p1) / 6.0, p2);
+    }
+    return path;
+}
+
+StrokeBuilder::StrokeBuilder(qreal tolerance)
+    : tolerance(tolerance),
+    samples(0) {
+}
+
+void StrokeBuilder::begin(const QPoint& point) {
+    clear();
+    simplified.append(point);
+    samples = 1;
+}
+
+void StrokeBuilder::add(const QPoint& point) {
+    if (simplified.isEmpty()) {
+        begin(point);
+        return;
+    }
+    const QPoint& previous = pending.isEmpty() ? simplified.last() : pending.last();
+    if (point == previous) {
+        return;
+    }
+    pending.append(point);
+    ++samples;
+    if (pending.size() >= kBatchSize) {
+        flush();
+    }
+}
+
+void StrokeBuilder::flush() {
+    if (pending.isEmpty()) {
+        return;
+    }
+    // The batch starts from the last kept point, which stays where it is.
+    pending.prepend(simplified.last());
+    const QVector<QPoint> batch = simplifyPolyline(pending, tolerance);
+    simplified.append(batch.mid(1));
+    pending.clear();
+}
+
+QVector<QPoint> StrokeBuilder::points() const {
+    return simplified + pending;
+}
+
+QVector<QPoint> StrokeBuilder::finish() {
+    flush();
+    QVector<QPoint> stroke = std::move(simplified);
+    clear();
+    return stroke;
+}
+
+void StrokeBuilder::clear() {
+    simplified.clear();
+    pending.clear();
+    samples = 0;
+}
@@ -0,0 +1,88 @@
+#include "../include/tiled_layer.h"
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+quint64 tileKey(int column, int row) {
+    return (static_cast<quint64>(static_cast<quint32>(row)) << 32) | static_cast<quint32>(column);
+}
+
+int tileIndex(int coordinate) {
+    return static_cast<int>(std::floor(coordinate / double(TiledLayer::TileSize)));
+}
+
+int tileSide(qreal ratio) {
+    return qCeil(TiledLayer::TileSize * ratio);
+}
+
+}
+
+void TiledLayer::reset(const QSize& size, qreal pixelRatio) {
+    tiles.clear();
+    layerSize = size;
+    ratio = pixelRatio;
+    peakBytes = 0;
+}
+
+void TiledLayer::clear() {
+    tiles.clear();
+}
+
+void TiledLayer::paint(const QRect& area, const std::function<void(QPainter&)>& draw) {
+    const QRect visible = area.intersected(rect());
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    for (int row = tileIndex(visible.top()); row <= tileIndex(visible.bottom()); ++row) {
+        for (int column = tileIndex(visible.left()); column <= tileIndex(visible.right()); ++column) {
+            auto it = tiles.find(tileKey(column, row));
+            if (it == tiles.end()) {
+                QPixmap tile(tileSide(ratio), tileSide(ratio));
+                tile.setDevicePixelRatio(ratio);
+                tile.fill(Qt::transparent);
+                it = tiles.insert(tileKey(column, row), tile);
+            }
+
+            const QRect tileRect(column * TileSize, row * TileSize, TileSize, TileSize);
+            QPainter painter(&it.value());
+            painter.translate(-tileRect.topLeft());
+            painter.setClipRect(tileRect.intersected(visible));
+            draw(painter);
+        }
+    }
+    peakBytes = std::max(peakBytes, memoryUsage());
+}
+
+void TiledLayer::draw(QPainter& painter, const QRect& area) const {
+    if (tiles.isEmpty()) {
+        return;
+    }
+
+    const QRect visible = area.intersected(rect());
+    if (visible.isEmpty()) {
+        return;
+    }
+    for (int row = tileIndex(visible.top()); row <= tileIndex(visible.bottom()); ++row) {
+        for (int column = tileIndex(visible.left()); column <= tileIndex(visible.right()); ++column) {
+            const auto it = tiles.constFind(tileKey(column, row));
+            if (it == tiles.constEnd()) {
+                continue;
+            }
+            const QRect tileRect(column * TileSize, row * TileSize, TileSize, TileSize);
+            const QRect target = tileRect.intersected(visible);
+            const QPoint offset = target.topLeft() - tileRect.topLeft();
+            painter.drawPixmap(QRectF(target), it.value(), QRectF(QPointF(offset) * ratio, QSizeF(target.size()) * ratio));
+        }
+    }
+}
+
+qint64 TiledLayer::memoryUsage() const {
+    return tiles.size() * static_cast<qint64>(tileSide(ratio)) * tileSide(ratio) * 4;
+}
+
+qint64 TiledLayer::denseMemoryUsage() const {
+    return qRound64(layerSize.width() * ratio) * qRound64(layerSize.height() * ratio) * 4;
+}
@@ -0,0 +1,226 @@
+#include "../include/undo_history.h"
+#include <QDebug>
+#include <QImage>
+#include <QPainter>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Speed matters more than ratio here: screenshots compress well even at the
+// fastest zlib level and a step must be recorded between two frames.
+constexpr int kCompressionLevel = 1;
+}
+
+UndoHistory::UndoHistory(qint64 memoryLimit)
+    : stepOpen(false),
+    memoryLimit(std::max<qint64>(0, memoryLimit)),
+    inMemoryBytes(0) {
+}
+
+void UndoHistory::setMemoryLimit(qint64 bytes) {
+    memoryLimit = std::max<qint64>(0, bytes);
+    enforceLimit();
+}
+
+QByteArray UndoHistory::grabTile(const QPixmap& image, const QRect& rect) {
+    const QImage tile = image.copy(rect).toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const int rowBytes = tile.width() * 4;
+    QByteArray raw(rowBytes * tile.height(), Qt::Uninitialized);
+    for (int y = 0; y < tile.height(); ++y) {
+        std::memcpy(raw.data() + y * rowBytes, tile.constScanLine(y), rowBytes);
+    }
+    return raw;
+}
+
+void UndoHistory::beginStep(const QPixmap& image, const QRect& area) {
+    pending = Step();
+    pendingRaw.clear();
+    pending.bounds = area.intersected(image.rect());
+    stepOpen = pending.bounds.isValid();
+    if (!stepOpen) {
+        return;
+    }
+
+    const int firstColumn = pending.bounds.left() / TileSize;
+    const int lastColumn = pending.bounds.right() / TileSize;
+    const int firstRow = pending.bounds.top() / TileSize;
+    const int lastRow = pending.bounds.bottom() / TileSize;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            TileDelta delta;
+            delta.rect = QRect(column * TileSize, row * TileSize, TileSize, TileSize).intersected(image.rect());
+            pendingRaw.append(grabTile(image, delta.rect));
+            pending.tiles.append(delta);
+        }
+    }
+}
+
+void UndoHistory::endStep(const QPixmap& image, const QRect& damage) {
+    if (!stepOpen) {
+        return;
+    }
+    stepOpen = false;
+
+    Step step;
+    for (int i = 0; i < pending.tiles.size(); ++i) {
+        TileDelta delta = pending.tiles[i];
+        const QByteArray after = grabTile(image, delta.rect);
+        if (after == pendingRaw[i]) {
+            continue;
+        }
+        delta.before.data = qCompress(pendingRaw[i], kCompressionLevel);
+        delta.after.data = qCompress(after, kCompressionLevel);
+        step.bytes += delta.before.data.size() + delta.after.data.size();
+        step.bounds = step.bounds.united(delta.rect);
+        step.tiles.append(delta);
+    }
+    pending = Step();
+    pendingRaw.clear();
+
+    if (!step.tiles.isEmpty()) {
+        step.damage = damage.isValid() ? damage : step.bounds;
+        push(std::move(step));
+    }
+}
+
+void UndoHistory::pushAction(std::function<QRect()> undoAction, std::function<QRect()> redoAction) {
+    Step step;
+    step.undoAction = std::move(undoAction);
+    step.redoAction = std::move(redoAction);
+    push(std::move(step));
+}
+
+void UndoHistory::push(Step step) {
+    for (const Step& discarded : redoSteps) {
+        if (!discarded.spilled) {
+            inMemoryBytes -= discarded.bytes;
+        }
+    }
+    redoSteps.clear();
+
+    inMemoryBytes += step.bytes;
+    undoSteps.push_back(std::move(step));
+    enforceLimit();
+}
+
+QRect UndoHistory::undo(QPixmap& image) {
+    if (undoSteps.empty()) {
+        return QRect();
+    }
+    Step step = std::move(undoSteps.back());
+    undoSteps.pop_back();
+    QRect bounds = step.damage;
+    if (step.undoAction) {
+        bounds = step.undoAction();
+    }
+    else {
+        restore(image, step, false);
+    }
+    redoSteps.push_back(std::move(step));
+    return bounds;
+}
+
+QRect UndoHistory::redo(QPixmap& image) {
+    if (redoSteps.empty()) {
+        return QRect();
+    }
+    Step step = std::move(redoSteps.back());
+    redoSteps.pop_back();
+    QRect bounds = step.damage;
+    if (step.redoAction) {
+        bounds = step.redoAction();
+    }
+    else {
+        restore(image, step, true);
+    }
+    undoSteps.push_back(std::move(step));
+    return bounds;
+}
+
+void UndoHistory::clear() {
+    undoSteps.clear();
+    redoSteps.clear();
+    pending = Step();
+    pendingRaw.clear();
+    stepOpen = false;
+    inMemoryBytes = 0;
+    if (spillFile.isOpen()) {
+        spillFile.resize(0);
+    }
+}
+
+void UndoHistory::restore(QPixmap& image, const Step& step, bool useAfter) {
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const TileDelta& delta : step.tiles) {
+        const QByteArray raw = qUncompress(load(useAfter ? delta.after : delta.before));
+        const int rowBytes = delta.rect.width() * 4;
+        if (raw.size() != rowBytes * delta.rect.height()) {
+            qWarning() << "Undo tile at" << delta.rect << "is damaged, skipping";
+            continue;
+        }
+        QImage tile(delta.rect.size(), QImage::Format_ARGB32_Premultiplied);
+        for (int y = 0; y < tile.height(); ++y) {
+            std::memcpy(tile.scanLine(y), raw.constData() + y * rowBytes, rowBytes);
+        }
+        painter.drawImage(delta.rect.topLeft(), tile);
+    }
+}
+
+QByteArray UndoHistory::load(const TileBlob& blob) {
+    if (blob.fileOffset < 0) {
+        return blob.data;
+    }
+    if (!spillFile.seek(blob.fileOffset)) {
+        return QByteArray();
+    }
+    return spillFile.read(blob.fileSize);
+}
+
+void UndoHistory::enforceLimit() {
+    // Oldest undo steps go first, then the redo steps furthest from the
+    // current state; the most recent edits stay in memory.
+    for (auto it = undoSteps.begin(); inMemoryBytes > memoryLimit && it != undoSteps.end(); ++it) {
+        if (!spill(*it)) {
+            return;
+        }
+    }
+    for (auto it = redoSteps.begin(); inMemoryBytes > memoryLimit && it != redoSteps.end(); ++it) {
+        if (!spill(*it)) {
+            return;
+        }
+    }
+}
+
+bool UndoHistory::spill(Step& step) {
+    if (step.spilled) {
+        return true;
+    }
+    if (!spillFile.isOpen() && !spillFile.open()) {
+        qWarning() << "Unable to open undo spill file, keeping history in memory";
+        return false;
+    }
+    for (TileDelta& delta : step.tiles) {
+        if (!spillBlob(delta.before) || !spillBlob(delta.after)) {
+            return false;
+        }
+    }
+    step.spilled = true;
+    inMemoryBytes -= step.bytes;
+    return true;
+}
+
+bool UndoHistory::spillBlob(TileBlob& blob) {
+    if (blob.fileOffset >= 0) {
+        return true;
+    }
+    const qint64 offset = spillFile.size();
+    if (!spillFile.seek(offset) || spillFile.write(blob.data) != blob.data.size()) {
+        qWarning() << "Unable to write undo spill file:" << spillFile.errorString();
+        return false;
+    }
+    blob.fileOffset = offset;
+    blob.fileSize = blob.data.size();
+    blob.data = QByteArray();
+    return true;
+}
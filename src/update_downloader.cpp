@@ -0,0 +1,256 @@
+#include "../include/update_downloader.h"
+#include "../include/utils.h"
+#include <QDebug>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QTimer>
+
+namespace {
+constexpr int kMaxRetries = 5;
+constexpr qint64 kChunkSize = 64 * 1024;
+}
+
+UpdateDownloader::UpdateDownloader(const QUrl& url, const QString& targetPath, const QByteArray& expectedSha256, QObject* parent)
+    : QObject(parent),
+    manager(new QNetworkAccessManager(this)),
+    reply(nullptr),
+    hash(QCryptographicHash::Sha256),
+    url(url),
+    targetPath(targetPath),
+    expectedSha256(expectedSha256.trimmed().toLower()),
+    offset(0),
+    received(0),
+    totalSize(-1),
+    retries(0),
+    cancelled(false),
+    restartRequested(false),
+    responseChecked(false) {
+}
+
+QString UpdateDownloader::partPath() const {
+    return targetPath + ".part";
+}
+
+QString UpdateDownloader::validatorPath() const {
+    return targetPath + ".part.meta";
+}
+
+void UpdateDownloader::start() {
+    cancelled = false;
+    retries = 0;
+    // Nothing is downloaded, let alone installed, that cannot be verified.
+    if (expectedSha256.isEmpty()) {
+        emit failed(tr("The update has no checksum and cannot be verified"));
+        return;
+    }
+    if (!preparePartFile()) {
+        emit failed(tr("Unable to write %1").arg(partPath()));
+        return;
+    }
+    sendRequest();
+}
+
+void UpdateDownloader::cancel() {
+    cancelled = true;
+    if (reply) {
+        reply->abort();
+    }
+    else if (partFile.isOpen()) {
+        // Waiting to retry: no reply will finish, so nothing else would
+        // report the cancellation. The pending retry sees cancelled and
+        // does nothing.
+        partFile.close();
+        emit failed(tr("Download cancelled"));
+    }
+}
+
+bool UpdateDownloader::preparePartFile() {
+    hash.reset();
+    offset = 0;
+    received = 0;
+    loadValidator();
+
+    partFile.setFileName(partPath());
+    if (partFile.exists() && !validator.isEmpty() && partFile.open(QIODevice::ReadOnly)) {
+        // Rehash what a previous run already stored so the final digest covers
+        // the whole file without reading it again at the end.
+        while (!partFile.atEnd()) {
+            const QByteArray chunk = partFile.read(1024 * 1024);
+            if (chunk.isEmpty()) {
+                break;
+            }
+            hash.addData(chunk);
+        }
+        offset = partFile.pos();
+        partFile.close();
+    }
+    else {
+        QFile::remove(partPath());
+        validator.clear();
+    }
+
+    return partFile.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void UpdateDownloader::sendRequest() {
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    if (offset > 0) {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-");
+        if (!validator.isEmpty()) {
+            request.setRawHeader("If-Range", validator);
+        }
+    }
+
+    responseChecked = false;
+    received = 0;
+    reply = manager->get(request);
+    reply->setReadBufferSize(4 * kChunkSize);
+    connect(reply, &QNetworkReply::metaDataChanged, this, &UpdateDownloader::onMetaDataChanged);
+    connect(reply, &QNetworkReply::readyRead, this, &UpdateDownloader::onReadyRead);
+    connect(reply, &QNetworkReply::finished, this, &UpdateDownloader::onReplyFinished);
+}
+
+void UpdateDownloader::restartFromScratch() {
+    partFile.resize(0);
+    hash.reset();
+    offset = 0;
+    received = 0;
+    validator.clear();
+    QFile::remove(validatorPath());
+    restartRequested = true;
+    reply->abort();
+}
+
+void UpdateDownloader::onMetaDataChanged() {
+    if (responseChecked || !reply) {
+        return;
+    }
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (status == 206) {
+        static const QRegularExpression rangePattern(QStringLiteral("bytes (\\d+)-\\d+/(\\d+|\\*)"));
+        const QRegularExpressionMatch match = rangePattern.match(QString::fromLatin1(reply->rawHeader("Content-Range")));
+        if (!match.hasMatch() || match.captured(1).toLongLong() != offset) {
+            restartFromScratch();
+            return;
+        }
+        totalSize = match.captured(2) == QStringLiteral("*") ? -1 : match.captured(2).toLongLong();
+    }
+    else if (status == 200) {
+        if (offset > 0) {
+            // Server ignored the range or the file changed: start over.
+            partFile.resize(0);
+            hash.reset();
+            offset = 0;
+        }
+        const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+        totalSize = length.isValid() ? length.toLongLong() : -1;
+    }
+    else if (status == 416 && offset > 0) {
+        restartFromScratch();
+        return;
+    }
+    else {
+        return;
+    }
+
+    QByteArray newValidator = reply->rawHeader("ETag");
+    if (newValidator.isEmpty() || newValidator.startsWith("W/")) {
+        newValidator = reply->rawHeader("Last-Modified");
+    }
+    if (newValidator != validator) {
+        saveValidator(newValidator);
+    }
+    responseChecked = true;
+}
+
+void UpdateDownloader::onReadyRead() {
+    if (!responseChecked) {
+        onMetaDataChanged();
+        if (!responseChecked) {
+            return;
+        }
+    }
+
+    while (reply && reply->bytesAvailable() > 0) {
+        const QByteArray chunk = reply->read(kChunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        if (partFile.write(chunk) != chunk.size()) {
+            qWarning() << "Unable to write update chunk:" << partFile.errorString();
+            cancel();
+            return;
+        }
+        hash.addData(chunk);
+        received += chunk.size();
+    }
+
+    emit progress(offset + received, totalSize);
+}
+
+void UpdateDownloader::onReplyFinished() {
+    QNetworkReply* finishedReply = reply;
+    reply = nullptr;
+    finishedReply->deleteLater();
+
+    if (restartRequested) {
+        restartRequested = false;
+        sendRequest();
+        return;
+    }
+
+    if (finishedReply->error() != QNetworkReply::NoError || !responseChecked) {
+        partFile.flush();
+        offset += received;
+        received = 0;
+
+        const int status = finishedReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const bool clientError = status >= 400 && status < 500;
+        if (cancelled || clientError || retries >= kMaxRetries) {
+            partFile.close();
+            emit failed(cancelled ? tr("Download cancelled") : finishedReply->errorString());
+            return;
+        }
+
+        ++retries;
+        qDebug() << "Update download interrupted at" << offset << "bytes, resuming:" << finishedReply->errorString();
+        QTimer::singleShot(1000 * retries, this, [this]() {
+            if (!cancelled) {
+                sendRequest();
+            }
+        });
+        return;
+    }
+
+    partFile.close();
+
+    const QByteArray digest = hash.result().toHex();
+    if (digest != expectedSha256) {
+        QFile::remove(partPath());
+        QFile::remove(validatorPath());
+        emit failed(tr("Checksum mismatch for downloaded update"));
+        return;
+    }
+
+    if (!replaceFile(partPath(), targetPath)) {
+        emit failed(tr("Unable to move update to %1").arg(targetPath));
+        return;
+    }
+    QFile::remove(validatorPath());
+    emit finished(targetPath);
+}
+
+void UpdateDownloader::loadValidator() {
+    QFile file(validatorPath());
+    validator = file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+}
+
+void UpdateDownloader::saveValidator(const QByteArray& newValidator) {
+    validator = newValidator;
+    QFile file(validatorPath());
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(validator);
+    }
+}
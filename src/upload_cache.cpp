@@ -0,0 +1,253 @@
+#include "../include/upload_cache.h"
+#include "../include/utils.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Streaming XXH64; image rows are fed one at a time so scanline padding never
+// enters the hash.
+class Xxh64 {
+public:
+    explicit Xxh64(quint64 seed = 0)
+        : total(0), bufferSize(0) {
+        v[0] = seed + P1 + P2;
+        v[1] = seed + P2;
+        v[2] = seed;
+        v[3] = seed - P1;
+        this->seed = seed;
+    }
+
+    void update(const uchar* data, size_t length) {
+        total += length;
+        if (bufferSize + length < 32) {
+            std::memcpy(buffer + bufferSize, data, length);
+            bufferSize += length;
+            return;
+        }
+        if (bufferSize > 0) {
+            const size_t fill = 32 - bufferSize;
+            std::memcpy(buffer + bufferSize, data, fill);
+            consumeStripe(buffer);
+            data += fill;
+            length -= fill;
+            bufferSize = 0;
+        }
+        while (length >= 32) {
+            consumeStripe(data);
+            data += 32;
+            length -= 32;
+        }
+        std::memcpy(buffer, data, length);
+        bufferSize = length;
+    }
+
+    quint64 digest() const {
+        quint64 h;
+        if (total >= 32) {
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (quint64 lane : v) {
+                h = (h ^ round(0, lane)) * P1 + P4;
+            }
+        }
+        else {
+            h = seed + P5;
+        }
+        h += total;
+
+        const uchar* p = buffer;
+        size_t remaining = bufferSize;
+        while (remaining >= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * P1 + P4;
+            p += 8;
+            remaining -= 8;
+        }
+        if (remaining >= 4) {
+            h ^= static_cast<quint64>(read32(p)) * P1;
+            h = rotl(h, 23) * P2 + P3;
+            p += 4;
+            remaining -= 4;
+        }
+        while (remaining > 0) {
+            h ^= static_cast<quint64>(*p) * P5;
+            h = rotl(h, 11) * P1;
+            ++p;
+            --remaining;
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static constexpr quint64 P1 = 11400714785074694791ULL;
+    static constexpr quint64 P2 = 14029467366897019727ULL;
+    static constexpr quint64 P3 = 1609587929392839161ULL;
+    static constexpr quint64 P4 = 9650029242287828579ULL;
+    static constexpr quint64 P5 = 2870177450012600261ULL;
+
+    static quint64 rotl(quint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+    static quint64 round(quint64 acc, quint64 input) {
+        acc += input * P2;
+        acc = rotl(acc, 31);
+        return acc * P1;
+    }
+    static quint64 read64(const uchar* p) {
+        quint64 value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static quint32 read32(const uchar* p) {
+        quint32 value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void consumeStripe(const uchar* p) {
+        for (int lane = 0; lane < 4; ++lane) {
+            v[lane] = round(v[lane], read64(p + lane * 8));
+        }
+    }
+
+    quint64 v[4];
+    quint64 seed;
+    quint64 total;
+    uchar buffer[32];
+    size_t bufferSize;
+};
+
+}
+
+UploadCache& UploadCache::instance() {
+    static UploadCache cache(64);
+    return cache;
+}
+
+UploadCache::UploadCache(int capacity)
+    : capacity(std::max(1, capacity)),
+    dirty(false) {
+    load();
+    if (QCoreApplication* app = QCoreApplication::instance()) {
+        QObject::connect(app, &QCoreApplication::aboutToQuit, app, [this]() {
+            flush();
+        });
+    }
+}
+
+QByteArray UploadCache::contentHash(const QImage& image, const QByteArray& settings) {
+    const QImage pixels = image.depth() == 32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    Xxh64 hasher;
+    const quint32 header[3] = {
+        static_cast<quint32>(pixels.width()),
+        static_cast<quint32>(pixels.height()),
+        static_cast<quint32>(pixels.format())
+    };
+    hasher.update(reinterpret_cast<const uchar*>(header), sizeof(header));
+    const size_t rowBytes = static_cast<size_t>(pixels.width()) * 4;
+    for (int y = 0; y < pixels.height(); ++y) {
+        hasher.update(pixels.constScanLine(y), rowBytes);
+    }
+    hasher.update(reinterpret_cast<const uchar*>(settings.constData()), static_cast<size_t>(settings.size()));
+
+    return QByteArray::number(hasher.digest(), 16).rightJustified(16, '0');
+}
+
+bool UploadCache::lookup(const QByteArray& hash, UploadRecord& record) {
+    auto it = index.find(hash);
+    if (it == index.end()) {
+        return false;
+    }
+    // Hits are the fast path: no disk I/O, the new order is saved later.
+    if (it.value() != entries.begin()) {
+        entries.splice(entries.begin(), entries, it.value());
+        dirty = true;
+    }
+    record = entries.front().second;
+    return true;
+}
+
+void UploadCache::insert(const QByteArray& hash, const UploadRecord& record) {
+    auto it = index.find(hash);
+    if (it != index.end()) {
+        entries.erase(it.value());
+        index.erase(it);
+    }
+    entries.emplace_front(hash, record);
+    index.insert(hash, entries.begin());
+    evict();
+    save();
+}
+
+void UploadCache::setCapacity(int newCapacity) {
+    newCapacity = std::max(1, newCapacity);
+    if (newCapacity == capacity) {
+        return;
+    }
+    capacity = newCapacity;
+    evict();
+    save();
+}
+
+void UploadCache::flush() {
+    if (dirty) {
+        save();
+    }
+}
+
+void UploadCache::evict() {
+    while (static_cast<int>(entries.size()) > capacity) {
+        index.remove(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void UploadCache::load() {
+    QFile file(getConfigFilePath("upload_cache.json"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QJsonArray array = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue& value : array) {
+        const QJsonObject obj = value.toObject();
+        const QByteArray hash = obj["hash"].toString().toLatin1();
+        if (hash.isEmpty() || index.contains(hash)) {
+            continue;
+        }
+        UploadRecord record;
+        record.id = obj["id"].toString();
+        record.url = obj["url"].toString();
+        record.imageUrl = obj["imageUrl"].toString();
+        entries.emplace_back(hash, record);
+        index.insert(hash, std::prev(entries.end()));
+    }
+    evict();
+}
+
+void UploadCache::save() {
+    dirty = false;
+    QJsonArray array;
+    for (const Entry& entry : entries) {
+        QJsonObject obj;
+        obj["hash"] = QString::fromLatin1(entry.first);
+        obj["id"] = entry.second.id;
+        obj["url"] = entry.second.url;
+        obj["imageUrl"] = entry.second.imageUrl;
+        array.append(obj);
+    }
+
+    QFile file(getConfigFilePath("upload_cache.json"));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(array).toJson(QJsonDocument::Compact));
+    }
+}
@@ -0,0 +1,188 @@
+#include "../include/upload_throttle.h"
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr qint64 kMinWindowMs = 50;
+constexpr qint64 kMaxWindowMs = 1000;
+constexpr qint64 kInitialWindowMs = 250;
+constexpr qint64 kMinChunk = 1024;
+}
+
+TokenBucket::TokenBucket(qint64 bytesPerSecond)
+    : bytesPerSecond(std::max<qint64>(0, bytesPerSecond)),
+    tokens(0.0),
+    windowMs(kInitialWindowMs),
+    activeStreams(0),
+    lastRefillNs(0) {
+    clock.start();
+    tokens = static_cast<double>(capacity());
+}
+
+void TokenBucket::setRate(qint64 rate) {
+    rate = std::max<qint64>(0, rate);
+    if (rate == bytesPerSecond) {
+        return;
+    }
+    refill();
+    bytesPerSecond = rate;
+    tokens = std::min(tokens, static_cast<double>(capacity()));
+}
+
+qint64 TokenBucket::capacity() const {
+    return std::max<qint64>(kMinChunk, bytesPerSecond * windowMs / 1000);
+}
+
+void TokenBucket::refill() {
+    const qint64 now = clock.nsecsElapsed();
+    const qint64 elapsed = now - lastRefillNs;
+    lastRefillNs = now;
+    if (isUnlimited()) {
+        return;
+    }
+
+    tokens += static_cast<double>(bytesPerSecond) * elapsed / 1e9;
+    const double cap = static_cast<double>(capacity());
+    if (tokens > cap) {
+        // Tokens went unused: the link has headroom, allow larger bursts.
+        tokens = cap;
+        const qint64 maxWindow = std::max(kMinWindowMs, kMaxWindowMs / std::max(1, activeStreams));
+        windowMs = std::min(maxWindow, windowMs + windowMs / 4 + 1);
+    }
+}
+
+qint64 TokenBucket::available() {
+    if (isUnlimited()) {
+        return std::numeric_limits<qint64>::max();
+    }
+    refill();
+    if (tokens < 1.0) {
+        // Readers are starving: pace in smaller slices.
+        windowMs = std::max(kMinWindowMs, windowMs * 3 / 4);
+        return 0;
+    }
+    return static_cast<qint64>(tokens);
+}
+
+void TokenBucket::consume(qint64 bytes) {
+    if (!isUnlimited()) {
+        tokens -= static_cast<double>(bytes);
+    }
+}
+
+qint64 TokenBucket::msUntilAvailable(qint64 bytes) const {
+    if (isUnlimited()) {
+        return 0;
+    }
+    const double deficit = static_cast<double>(bytes) - tokens;
+    if (deficit <= 0.0) {
+        return 0;
+    }
+    return std::max<qint64>(1, static_cast<qint64>(std::ceil(deficit * 1000.0 / bytesPerSecond)));
+}
+
+void TokenBucket::attachStream() {
+    ++activeStreams;
+    const qint64 maxWindow = std::max(kMinWindowMs, kMaxWindowMs / activeStreams);
+    windowMs = std::min(windowMs, maxWindow);
+}
+
+void TokenBucket::detachStream() {
+    activeStreams = std::max(0, activeStreams - 1);
+}
+
+TokenBucket& globalUploadBucket() {
+    static TokenBucket bucket;
+    return bucket;
+}
+
+ThrottledUploadDevice::ThrottledUploadDevice(QIODevice* source, qint64 perUploadRate, QObject* parent)
+    : QIODevice(parent),
+    source(source),
+    localBucket(perUploadRate),
+    sent(0),
+    resumePending(false) {
+    source->setParent(this);
+    if (!source->isOpen()) {
+        source->open(QIODevice::ReadOnly);
+    }
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    localBucket.attachStream();
+    globalUploadBucket().attachStream();
+}
+
+ThrottledUploadDevice::~ThrottledUploadDevice() {
+    localBucket.detachStream();
+    globalUploadBucket().detachStream();
+}
+
+ThrottledUploadDevice* ThrottledUploadDevice::fromConfig(QIODevice* source, const QJsonObject& config, QObject* parent) {
+    globalUploadBucket().setRate(static_cast<qint64>(config["upload_rate_limit"].toDouble(0)));
+    const qint64 perUpload = static_cast<qint64>(config["upload_rate_limit_per_upload"].toDouble(0));
+    return new ThrottledUploadDevice(source, perUpload, parent);
+}
+
+bool ThrottledUploadDevice::atEnd() const {
+    return source->atEnd();
+}
+
+qint64 ThrottledUploadDevice::bytesAvailable() const {
+    return source->bytesAvailable();
+}
+
+double ThrottledUploadDevice::averageThroughput() const {
+    if (!transferClock.isValid()) {
+        return 0.0;
+    }
+    const qint64 elapsed = std::max<qint64>(1, transferClock.elapsed());
+    return static_cast<double>(sent) * 1000.0 / elapsed;
+}
+
+qint64 ThrottledUploadDevice::readData(char* data, qint64 maxSize) {
+    if (!transferClock.isValid()) {
+        transferClock.start();
+    }
+    if (source->atEnd()) {
+        return -1;
+    }
+
+    TokenBucket& global = globalUploadBucket();
+    qint64 allowed = maxSize;
+    allowed = std::min(allowed, localBucket.available());
+    allowed = std::min(allowed, global.available());
+
+    if (allowed <= 0) {
+        const qint64 chunk = std::min(maxSize, kMinChunk);
+        scheduleResume(std::max(localBucket.msUntilAvailable(chunk), global.msUntilAvailable(chunk)));
+        return 0;
+    }
+
+    const qint64 read = source->read(data, allowed);
+    if (read <= 0) {
+        return source->atEnd() ? -1 : read;
+    }
+
+    localBucket.consume(read);
+    global.consume(read);
+    sent += read;
+    return read;
+}
+
+qint64 ThrottledUploadDevice::writeData(const char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+void ThrottledUploadDevice::scheduleResume(qint64 delayMs) {
+    if (resumePending) {
+        return;
+    }
+    resumePending = true;
+    QTimer::singleShot(static_cast<int>(std::max<qint64>(1, delayMs)), this, [this]() {
+        resumePending = false;
+        emit readyRead();
+    });
+}
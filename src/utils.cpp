@@ -13,6 +13,31 @@
 #include <QString>
 #include <QStandardPaths>
 #include <QSettings>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <dwmapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "dwmapi.lib")
+#endif
+#ifndef PW_RENDERFULLCONTENT
+#define PW_RENDERFULLCONTENT 0x00000002
+#endif
+#elif defined(Q_OS_LINUX)
+#include <qpa/qplatformnativeinterface.h>
+#include "xcb/xcb.h"
+#include "xcb/composite.h"
+#include <cstdlib>
+#include <cstring>
+#endif
 
 QString getUniqueFilePath(const QString& folder, const QString& baseName, const QString& extension) {
     QDir dir(folder);
@@ -39,6 +64,79 @@ QString getConfigFilePath(const QString& file) {
     return dir.filePath(file);
 }
 
+namespace {
+
+struct ParsedVersion {
+    QVector<qlonglong> numbers;
+    QStringList preRelease;
+};
+
+ParsedVersion parseVersion(QString version) {
+    ParsedVersion parsed;
+    version = version.trimmed();
+    if (version.startsWith('v') || version.startsWith('V')) {
+        version.remove(0, 1);
+    }
+    version = version.section('+', 0, 0);
+
+    const int dash = version.indexOf('-');
+    if (dash >= 0) {
+        parsed.preRelease = version.mid(dash + 1).split('.', Qt::SkipEmptyParts);
+        version.truncate(dash);
+    }
+    for (const QString& part : version.split('.')) {
+        parsed.numbers.append(part.toLongLong());
+    }
+    return parsed;
+}
+
+}
+
+// Semantic version ordering: numeric components compare as numbers ("1.10" >
+// "1.9", "1.3.01" == "1.3.1"), and a pre-release sorts before its release.
+int compareVersions(const QString& lhs, const QString& rhs) {
+    const ParsedVersion a = parseVersion(lhs);
+    const ParsedVersion b = parseVersion(rhs);
+
+    const int count = std::max(a.numbers.size(), b.numbers.size());
+    for (int i = 0; i < count; ++i) {
+        const qlonglong x = i < a.numbers.size() ? a.numbers.at(i) : 0;
+        const qlonglong y = i < b.numbers.size() ? b.numbers.at(i) : 0;
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+
+    if (a.preRelease.isEmpty() != b.preRelease.isEmpty()) {
+        return a.preRelease.isEmpty() ? 1 : -1;
+    }
+    const int identifiers = std::min(a.preRelease.size(), b.preRelease.size());
+    for (int i = 0; i < identifiers; ++i) {
+        bool aNumeric = false;
+        bool bNumeric = false;
+        const qlonglong x = a.preRelease.at(i).toLongLong(&aNumeric);
+        const qlonglong y = b.preRelease.at(i).toLongLong(&bNumeric);
+        if (aNumeric && bNumeric) {
+            if (x != y) {
+                return x < y ? -1 : 1;
+            }
+        }
+        else if (aNumeric != bNumeric) {
+            return aNumeric ? -1 : 1;
+        }
+        else {
+            const int cmp = QString::compare(a.preRelease.at(i), b.preRelease.at(i));
+            if (cmp != 0) {
+                return cmp < 0 ? -1 : 1;
+            }
+        }
+    }
+    if (a.preRelease.size() != b.preRelease.size()) {
+        return a.preRelease.size() < b.preRelease.size() ? -1 : 1;
+    }
+    return 0;
+}
+
 DesktopCapture captureEntireDesktop() {
     DesktopCapture capture;
     const QList<QScreen*> screens = QGuiApplication::screens();
@@ -57,47 +155,239 @@ DesktopCapture captureEntireDesktop() {
         return capture;
     }
 
-    QPixmap desktopPixmap(totalGeometry.size());
-    desktopPixmap.fill(Qt::transparent);
+    QVector<QPixmap> grabs;
+    grabs.reserve(screens.size());
+    for (QScreen* screen : screens) {
+        QPixmap grab = screen->grabWindow(0);
+        capture.ratio = std::max(capture.ratio, grab.devicePixelRatio());
+        grabs.append(grab);
+    }
 
-    QPainter painter(&desktopPixmap);
-    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    capture.geometry = totalGeometry;
+    for (int i = 0; i < screens.size(); ++i) {
+        CapturedScreen entry;
+        entry.logical = screens.at(i)->geometry().translated(-totalGeometry.topLeft());
+        entry.ratio = grabs.at(i).devicePixelRatio();
+        entry.physical = QRect(QPoint(std::lround(entry.logical.x() * capture.ratio), std::lround(entry.logical.y() * capture.ratio)),
+                               grabs.at(i).size());
+        capture.screens.append(entry);
+        grabs[i].setDevicePixelRatio(1.0);
+    }
 
-    for (QScreen* screen : screens) {
-        const QRect screenGeometry = screen->geometry();
-        const QPoint offset = screenGeometry.topLeft() - totalGeometry.topLeft();
-        QPixmap screenPixmap = screen->grabWindow(0);
-        const qreal dpr = screenPixmap.devicePixelRatio();
-        const QSizeF logicalSize = QSizeF(screenPixmap.size()) / dpr;
-        const QRectF targetRect(QPointF(offset), logicalSize);
-        painter.drawPixmap(targetRect, screenPixmap, QRectF(QPointF(0, 0), QSizeF(screenPixmap.size())));
+    if (grabs.size() == 1) {
+        capture.pixmap = grabs.first();
+        return capture;
+    }
+
+    // Native pixels are blitted, never resampled; gaps only exist when
+    // screens differ in ratio or do not tile the bounding rectangle.
+    const QSize atlasSize(std::lround(std::ceil(totalGeometry.width() * capture.ratio)),
+                          std::lround(std::ceil(totalGeometry.height() * capture.ratio)));
+    QPixmap desktopPixmap(atlasSize);
+    if (!capture.isUniform()) {
+        desktopPixmap.fill(Qt::transparent);
     }
 
+    QPainter painter(&desktopPixmap);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (int i = 0; i < grabs.size(); ++i) {
+        painter.drawPixmap(capture.screens.at(i).physical.topLeft(), grabs.at(i));
+    }
     painter.end();
-    desktopPixmap.setDevicePixelRatio(1.0);
 
     capture.pixmap = desktopPixmap;
-    capture.geometry = totalGeometry;
     return capture;
 }
 
+bool replaceFile(const QString& source, const QString& target) {
+#if defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(source).utf16()),
+                       reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(target).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    // rename(2) replaces an existing target atomically.
+    return std::rename(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+#endif
+}
+
+QPixmap captureActiveWindow() {
+#if defined(Q_OS_WIN)
+    HWND window = GetForegroundWindow();
+    RECT windowRect;
+    if (!window || !GetWindowRect(window, &windowRect)) {
+        return QPixmap();
+    }
+    // The visible frame, without the invisible resize borders of Windows 10+.
+    RECT visibleRect = windowRect;
+    if (FAILED(DwmGetWindowAttribute(window, DWMWA_EXTENDED_FRAME_BOUNDS, &visibleRect, sizeof(visibleRect)))) {
+        visibleRect = windowRect;
+    }
+    const int width = windowRect.right - windowRect.left;
+    const int height = windowRect.bottom - windowRect.top;
+    if (width <= 0 || height <= 0) {
+        return QPixmap();
+    }
+
+    // PrintWindow has the window render itself into our bitmap, so nothing
+    // stacked above it ends up in the capture.
+    HDC screenDc = GetDC(nullptr);
+    HDC memoryDc = CreateCompatibleDC(screenDc);
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
+    HBITMAP bitmap = CreateDIBSection(screenDc, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    QImage image;
+    if (bitmap) {
+        HGDIOBJ previous = SelectObject(memoryDc, bitmap);
+        if (PrintWindow(window, memoryDc, PW_RENDERFULLCONTENT)) {
+            const QRect visible(visibleRect.left - windowRect.left, visibleRect.top - windowRect.top,
+                                visibleRect.right - visibleRect.left, visibleRect.bottom - visibleRect.top);
+            image = QImage(static_cast<const uchar*>(bits), width, height, width * 4, QImage::Format_RGB32)
+                .copy(visible.intersected(QRect(0, 0, width, height)));
+        }
+        SelectObject(memoryDc, previous);
+        DeleteObject(bitmap);
+    }
+    DeleteDC(memoryDc);
+    ReleaseDC(nullptr, screenDc);
+    return QPixmap::fromImage(image);
+#elif defined(Q_OS_LINUX)
+    if (QGuiApplication::platformName() != QLatin1String("xcb") || !QGuiApplication::primaryScreen()) {
+        return QPixmap();
+    }
+    xcb_connection_t* connection = static_cast<xcb_connection_t*>(
+        QGuiApplication::platformNativeInterface()->nativeResourceForIntegration("connection"));
+    if (!connection) {
+        return QPixmap();
+    }
+    const xcb_window_t root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+
+    // The window manager publishes the focused client on the root window.
+    static const char activeName[] = "_NET_ACTIVE_WINDOW";
+    xcb_window_t active = XCB_WINDOW_NONE;
+    xcb_intern_atom_reply_t* atom = xcb_intern_atom_reply(connection,
+        xcb_intern_atom(connection, 1, static_cast<uint16_t>(std::strlen(activeName)), activeName), nullptr);
+    if (atom && atom->atom != XCB_ATOM_NONE) {
+        xcb_get_property_reply_t* property = xcb_get_property_reply(connection,
+            xcb_get_property(connection, 0, root, atom->atom, XCB_ATOM_WINDOW, 0, 1), nullptr);
+        if (property && xcb_get_property_value_length(property) >= static_cast<int>(sizeof(xcb_window_t))) {
+            active = *static_cast<const xcb_window_t*>(xcb_get_property_value(property));
+        }
+        std::free(property);
+    }
+    std::free(atom);
+    if (active == XCB_WINDOW_NONE) {
+        return QPixmap();
+    }
+
+    // Composite redirects top-level windows, i.e. the window manager's frame
+    // around the client, so walk up to the child of the root.
+    xcb_window_t frame = active;
+    for (;;) {
+        xcb_query_tree_reply_t* tree = xcb_query_tree_reply(connection, xcb_query_tree(connection, frame), nullptr);
+        if (!tree) {
+            return QPixmap();
+        }
+        const xcb_window_t parent = tree->parent;
+        std::free(tree);
+        if (parent == root || parent == XCB_WINDOW_NONE) {
+            break;
+        }
+        frame = parent;
+    }
+
+    // The off-screen pixmap a compositing manager keeps for the frame holds
+    // the window's own contents, so nothing stacked above it can bleed in.
+    // (Grabbing through Qt would copy the area from the root window instead.)
+    // Without a compositing manager the frame is not redirected and naming
+    // its pixmap fails; the window is then not captured at all rather than
+    // with whatever covers it.
+    xcb_composite_query_version_reply_t* version = xcb_composite_query_version_reply(connection,
+        xcb_composite_query_version(connection, XCB_COMPOSITE_MAJOR_VERSION, XCB_COMPOSITE_MINOR_VERSION), nullptr);
+    const bool hasComposite = version && (version->major_version > 0 || version->minor_version >= 2);
+    std::free(version);
+    if (!hasComposite) {
+        return QPixmap();
+    }
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(connection, xcb_get_geometry(connection, frame), nullptr);
+    if (!geometry) {
+        return QPixmap();
+    }
+    const int width = geometry->width + 2 * geometry->border_width;
+    const int height = geometry->height + 2 * geometry->border_width;
+    std::free(geometry);
+
+    const xcb_pixmap_t contents = xcb_generate_id(connection);
+    if (xcb_generic_error_t* error = xcb_request_check(connection, xcb_composite_name_window_pixmap_checked(connection, frame, contents))) {
+        std::free(error);
+        return QPixmap();
+    }
+    QImage image;
+    xcb_get_image_reply_t* reply = xcb_get_image_reply(connection,
+        xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, contents, 0, 0, static_cast<uint16_t>(width), static_cast<uint16_t>(height), ~0u), nullptr);
+    xcb_free_pixmap(connection, contents);
+    // 24- and 32-bit visuals both come as 32 bits per pixel in BGRA order.
+    if (reply && (reply->depth == 24 || reply->depth == 32)
+        && xcb_get_image_data_length(reply) >= width * height * 4) {
+        const QImage::Format format = reply->depth == 32 ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+        image = QImage(xcb_get_image_data(reply), width, height, width * 4, format).copy();
+    }
+    std::free(reply);
+    return QPixmap::fromImage(image);
+#else
+    return QPixmap();
+#endif
+}
+
+bool DesktopCapture::isUniform() const {
+    qint64 coveredArea = 0;
+    for (const CapturedScreen& screen : screens) {
+        if (!qFuzzyCompare(screen.ratio, ratio)) {
+            return false;
+        }
+        coveredArea += static_cast<qint64>(screen.logical.width()) * screen.logical.height();
+    }
+    return coveredArea == static_cast<qint64>(geometry.width()) * geometry.height();
+}
+
+QPixmap DesktopCapture::flattened() const {
+    if (isUniform()) {
+        return pixmap;
+    }
+
+    // Screens below the highest ratio are scaled up to fill their cell; this
+    // is the only place a mixed-density capture gets resampled.
+    QPixmap result(pixmap.size());
+    result.fill(Qt::transparent);
+    QPainter painter(&result);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    for (const CapturedScreen& screen : screens) {
+        const QRectF cell(QPointF(screen.physical.topLeft()), QSizeF(screen.logical.size()) * ratio);
+        painter.drawPixmap(cell, pixmap, QRectF(screen.physical));
+    }
+    painter.end();
+    return result;
+}
+
 void CaptureScreenshot(const QString& savePath) {
     const DesktopCapture capture = captureEntireDesktop();
     if (!capture.isValid()) {
         qWarning() << "Unable to capture desktop";
         return;
     }
-    capture.pixmap.save(savePath);
+    capture.flattened().save(savePath);
 }
 
 void displayScreenshotOnScreen(const QPixmap& pixmap, const QRect& geometry) {
-    ScreenshotDisplay* displayWidget = new ScreenshotDisplay(pixmap, geometry);
-    if (geometry.isValid()) {
-        displayWidget->setGeometry(geometry);
-    } else {
-        displayWidget->resize(pixmap.size());
-    }
-    displayWidget->show();
+    // The overlay places one surface per screen over the given geometry and
+    // shows them itself.
+    ScreenshotDisplay* display = new ScreenshotDisplay(nullptr);
+    display->reset(pixmap, geometry);
 }
 
 void saveLoginInfo(const QString& id, const QString& email, const QString& nickname, const QString& token) {
@@ -0,0 +1,154 @@
+#include "../include/window_tree.h"
+#include <QGuiApplication>
+#include <QScreen>
+
+#if defined(Q_OS_LINUX)
+#include <qpa/qplatformnativeinterface.h>
+#include "xcb/xcb.h"
+#include <cstdlib>
+#endif
+
+namespace {
+
+// Frames, the client windows inside them and one level of their children.
+constexpr int kMaxDepth = 2;
+constexpr int kMinimumSize = 8;
+
+// X11 reports native pixels; Qt keeps each screen's origin and divides the
+// rest by its device pixel ratio.
+QRect toOverlay(const QRect& native, const QRect& desktopGeometry) {
+    const QPoint centre = native.center();
+    for (QScreen* screen : QGuiApplication::screens()) {
+        const qreal ratio = screen->devicePixelRatio();
+        const QRect logical = screen->geometry();
+        if (!QRect(logical.topLeft(), logical.size() * ratio).contains(centre)) {
+            continue;
+        }
+        const QPointF topLeft = QPointF(logical.topLeft()) + QPointF(native.topLeft() - logical.topLeft()) / ratio;
+        return QRect(topLeft.toPoint(), (QSizeF(native.size()) / ratio).toSize()).translated(-desktopGeometry.topLeft());
+    }
+    return native.translated(-desktopGeometry.topLeft());
+}
+
+#if defined(Q_OS_LINUX)
+struct PendingWindow {
+    xcb_window_t window;
+    QRect parent;
+    int toplevel;
+};
+#endif
+
+}
+
+void WindowTree::clear() {
+    entries.clear();
+    index.clear();
+}
+
+void WindowTree::add(const QRect& rect, int toplevel, int depth) {
+    index.insert(rect, entries.size());
+    entries.append({ rect, toplevel, depth });
+}
+
+void WindowTree::capture(const QRect& desktopGeometry) {
+    clear();
+#if defined(Q_OS_LINUX)
+    if (QGuiApplication::platformName() != QLatin1String("xcb")) {
+        return;
+    }
+    xcb_connection_t* connection = static_cast<xcb_connection_t*>(
+        QGuiApplication::platformNativeInterface()->nativeResourceForIntegration("connection"));
+    if (!connection) {
+        return;
+    }
+    const xcb_window_t root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+
+    QVector<PendingWindow> level;
+    if (xcb_query_tree_reply_t* reply = xcb_query_tree_reply(connection, xcb_query_tree(connection, root), nullptr)) {
+        const xcb_window_t* children = xcb_query_tree_children(reply);
+        const int count = xcb_query_tree_children_length(reply);
+        // Children come bottom to top, so the index is the stacking order.
+        for (int i = 0; i < count; ++i) {
+            level.append({ children[i], QRect(), i });
+        }
+        std::free(reply);
+    }
+
+    for (int depth = 0; depth <= kMaxDepth && !level.isEmpty(); ++depth) {
+        // Geometry, attributes and children of the whole level are requested
+        // before the first reply is read.
+        const bool descend = depth < kMaxDepth;
+        QVector<xcb_get_geometry_cookie_t> geometryCookies;
+        QVector<xcb_get_window_attributes_cookie_t> attributeCookies;
+        QVector<xcb_query_tree_cookie_t> treeCookies;
+        geometryCookies.reserve(level.size());
+        attributeCookies.reserve(level.size());
+        treeCookies.reserve(descend ? level.size() : 0);
+        for (const PendingWindow& pending : level) {
+            geometryCookies.append(xcb_get_geometry(connection, pending.window));
+            attributeCookies.append(xcb_get_window_attributes(connection, pending.window));
+            if (descend) {
+                treeCookies.append(xcb_query_tree(connection, pending.window));
+            }
+        }
+
+        QVector<PendingWindow> next;
+        for (int i = 0; i < level.size(); ++i) {
+            const PendingWindow& pending = level[i];
+            xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(connection, geometryCookies[i], nullptr);
+            xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(connection, attributeCookies[i], nullptr);
+            xcb_query_tree_reply_t* tree = descend ? xcb_query_tree_reply(connection, treeCookies[i], nullptr) : nullptr;
+
+            QRect rect;
+            if (geometry && attributes && attributes->map_state == XCB_MAP_STATE_VIEWABLE
+                && attributes->_class == XCB_WINDOW_CLASS_INPUT_OUTPUT) {
+                // Positions are relative to the parent's inside, borders excluded.
+                rect = QRect(geometry->x + geometry->border_width, geometry->y + geometry->border_width,
+                             geometry->width, geometry->height);
+                if (depth > 0) {
+                    rect = rect.translated(pending.parent.topLeft()).intersected(pending.parent);
+                }
+            }
+            if (rect.width() >= kMinimumSize && rect.height() >= kMinimumSize) {
+                add(toOverlay(rect, desktopGeometry), pending.toplevel, depth);
+                if (tree) {
+                    const xcb_window_t* children = xcb_query_tree_children(tree);
+                    const int count = xcb_query_tree_children_length(tree);
+                    for (int c = 0; c < count; ++c) {
+                        next.append({ children[c], rect, pending.toplevel });
+                    }
+                }
+            }
+            std::free(geometry);
+            std::free(attributes);
+            std::free(tree);
+        }
+        level = std::move(next);
+    }
+#else
+    Q_UNUSED(desktopGeometry);
+#endif
+}
+
+QRect WindowTree::windowAt(const QPoint& position) const {
+    // Later top-levels are stacked higher; within one, deeper is more
+    // specific and later siblings are on top.
+    int best = -1;
+    index.search(QRect(position, QSize(1, 1)), [this, &best](int candidate, const QRect&) {
+        if (best < 0) {
+            best = candidate;
+            return;
+        }
+        const Entry& entry = entries[candidate];
+        const Entry& current = entries[best];
+        if (entry.toplevel != current.toplevel) {
+            if (entry.toplevel > current.toplevel) {
+                best = candidate;
+            }
+        }
+        else if (entry.depth != current.depth ? entry.depth > current.depth : candidate > best) {
+            best = candidate;
+        }
+    });
+    return best < 0 ? QRect() : entries[best].rect;
+}
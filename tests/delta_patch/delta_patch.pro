@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_delta_patch
+
+HEADERS += \
+    ../../include/delta_patch.h
+
+SOURCES += \
+    tst_delta_patch.cpp \
+    ../../src/delta_patch.cpp
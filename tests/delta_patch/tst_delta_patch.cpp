@@ -0,0 +1,155 @@
+#include "../../include/delta_patch.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <algorithm>
+
+namespace {
+
+QByteArray randomBytes(QRandomGenerator& random, int size) {
+    QByteArray bytes(size, '\0');
+    for (char& byte : bytes) {
+        byte = static_cast<char>(random.bounded(256));
+    }
+    return bytes;
+}
+
+// A new build of the same file: a few bytes patched, blocks inserted and
+// removed, and a stretch shifted by a constant, as relocated code is.
+QByteArray edited(const QByteArray& base, quint32 seed) {
+    QRandomGenerator random(seed);
+    QByteArray result = base;
+    for (int edit = 0; edit < 20 && !result.isEmpty(); ++edit) {
+        const int at = random.bounded(static_cast<int>(result.size()));
+        switch (random.bounded(4)) {
+        case 0:
+            result[at] = static_cast<char>(result[at] ^ 0x5A);
+            break;
+        case 1:
+            result.insert(at, randomBytes(random, random.bounded(300)));
+            break;
+        case 2:
+            result.remove(at, random.bounded(300));
+            break;
+        default:
+            for (int i = at; i < std::min(static_cast<int>(result.size()), at + 500); ++i) {
+                result[i] = static_cast<char>(result[i] + 3);
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+}
+
+class TestDeltaPatch : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void roundTrip_data();
+    void roundTrip();
+    void rejectsDamagedPatch_data();
+    void rejectsDamagedPatch();
+    void rejectsMissingBase();
+
+private:
+    bool writeBase(const QByteArray& base);
+    QString path(const QString& name) const { return directory.filePath(name); }
+
+    QTemporaryDir directory;
+};
+
+void TestDeltaPatch::initTestCase() {
+    QVERIFY(directory.isValid());
+}
+
+bool TestDeltaPatch::writeBase(const QByteArray& base) {
+    QFile file(path("base"));
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(base) == base.size();
+}
+
+void TestDeltaPatch::roundTrip_data() {
+    QTest::addColumn<QByteArray>("base");
+    QTest::addColumn<QByteArray>("target");
+
+    QRandomGenerator random(29);
+    const QByteArray base = randomBytes(random, 50000);
+    // Text-like data has long repeated runs, which the suffix sort has to
+    // tell apart.
+    QByteArray text;
+    while (text.size() < 40000) {
+        text += "ScreenMe " + QByteArray::number(random.bounded(1000)) + " capture;\n";
+    }
+
+    QTest::newRow("random") << base << randomBytes(random, 50000);
+    QTest::newRow("identical") << base << base;
+    QTest::newRow("edited") << base << edited(base, 1);
+    QTest::newRow("edited text") << text << edited(text, 2);
+    QTest::newRow("grown") << base << base + randomBytes(random, 10000);
+    QTest::newRow("shrunk") << base << base.left(20000) + base.mid(30000);
+    QTest::newRow("empty") << QByteArray() << QByteArray();
+    QTest::newRow("from empty") << QByteArray() << base;
+    QTest::newRow("to empty") << base << QByteArray();
+    QTest::newRow("one byte") << QByteArray("a") << QByteArray("b");
+}
+
+void TestDeltaPatch::roundTrip() {
+    QFETCH(QByteArray, base);
+    QFETCH(QByteArray, target);
+    QVERIFY(writeBase(base));
+
+    const QByteArray patch = createDeltaPatch(base, target);
+    QVERIFY(patch.startsWith("SMDELTA1"));
+
+    QByteArray digest;
+    QString error;
+    QVERIFY2(applyDeltaPatch(path("base"), patch, path("output"), &digest, &error), qPrintable(error));
+    QFile output(path("output"));
+    QVERIFY(output.open(QIODevice::ReadOnly));
+    QCOMPARE(output.readAll(), target);
+    QCOMPARE(digest, QCryptographicHash::hash(target, QCryptographicHash::Sha256).toHex());
+}
+
+void TestDeltaPatch::rejectsDamagedPatch_data() {
+    QTest::addColumn<QByteArray>("patch");
+
+    QRandomGenerator random(30);
+    const QByteArray base = randomBytes(random, 20000);
+    // Inserted bytes land in the extra block, so it is never empty.
+    const QByteArray patch = createDeltaPatch(base, edited(base, 3) + randomBytes(random, 1000));
+    QVERIFY(writeBase(base));
+
+    QByteArray wrongMagic = patch;
+    wrongMagic[7] = '2';
+    QByteArray damagedControl = patch;
+    damagedControl[36] = static_cast<char>(damagedControl[36] ^ 0xFF);
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("wrong magic") << wrongMagic;
+    QTest::newRow("header only") << patch.left(32);
+    QTest::newRow("truncated blocks") << patch.left(40);
+    QTest::newRow("truncated extra") << patch.left(patch.size() - 16);
+    QTest::newRow("damaged control") << damagedControl;
+}
+
+void TestDeltaPatch::rejectsDamagedPatch() {
+    QFETCH(QByteArray, patch);
+    QByteArray digest;
+    QString error;
+    QVERIFY(!applyDeltaPatch(path("base"), patch, path("output"), &digest, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestDeltaPatch::rejectsMissingBase() {
+    const QByteArray patch = createDeltaPatch(QByteArray("old"), QByteArray("new"));
+    QString error;
+    QVERIFY(!applyDeltaPatch(path("missing"), patch, path("output"), nullptr, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestDeltaPatch)
+#include "tst_delta_patch.moc"
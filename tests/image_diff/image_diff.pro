@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_image_diff
+
+HEADERS += \
+    ../../include/image_diff.h \
+    ../../include/pixel_ops.h \
+    ../../include/simd.h
+
+SOURCES += \
+    tst_image_diff.cpp \
+    ../../src/image_diff.cpp \
+    ../../src/pixel_ops.cpp
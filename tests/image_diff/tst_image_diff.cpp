@@ -0,0 +1,146 @@
+#include "../../include/image_diff.h"
+#include "test_support.h"
+#include <QRandomGenerator>
+#include <QtTest>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Moves one channel of about one pixel in twenty by a random amount.
+QImage perturbed(const QImage& image, quint32 seed) {
+    QImage result = image.copy();
+    QRandomGenerator random(seed);
+    for (int y = 0; y < result.height(); ++y) {
+        quint32* line = reinterpret_cast<quint32*>(result.scanLine(y));
+        for (int x = 0; x < result.width(); ++x) {
+            if (random.bounded(20) == 0) {
+                const int shift = random.bounded(4) * 8;
+                const int channel = static_cast<int>((line[x] >> shift) & 0xFF);
+                const int moved = std::clamp(channel + random.bounded(-255, 256), 0, 255);
+                line[x] = (line[x] & ~(0xFFu << shift)) | (static_cast<quint32>(moved) << shift);
+            }
+        }
+    }
+    return result;
+}
+
+void fillRect(QImage& image, const QRect& rect, quint32 color) {
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        quint32* line = reinterpret_cast<quint32*>(image.scanLine(y));
+        std::fill(line + rect.left(), line + rect.right() + 1, color);
+    }
+}
+
+bool changed(quint32 a, quint32 b, int threshold) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (std::abs(int((a >> shift) & 0xFF) - int((b >> shift) & 0xFF)) >= threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+class TestImageDiff : public QObject {
+    Q_OBJECT
+
+private slots:
+    void identicalImagesMatch();
+    void matchesScalarReference_data();
+    void matchesScalarReference();
+    void clustersTouchingCells();
+    void comparesCommonAreaOfDifferentSizes();
+    void nullImagesGiveNullDiff();
+    void benchmark4k_data();
+    void benchmark4k();
+};
+
+void TestImageDiff::identicalImagesMatch() {
+    const QImage image = noiseImage(1000, 700, 1);
+    const ImageDiff diff = ImageDiff::compute(image, image.copy());
+    QCOMPARE(diff.size(), QSize(1000, 700));
+    QCOMPARE(diff.changedPixels(), qint64(0));
+    QVERIFY(diff.regions().isEmpty());
+}
+
+void TestImageDiff::matchesScalarReference_data() {
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("threshold");
+    QTest::newRow("odd, 1") << QSize(37, 23) << 1;
+    QTest::newRow("odd, default") << QSize(129, 65) << ImageDiff::kDefaultThreshold;
+    QTest::newRow("large, 255") << QSize(1001, 300) << 255;
+    QTest::newRow("large, 100") << QSize(1920, 200) << 100;
+}
+
+void TestImageDiff::matchesScalarReference() {
+    QFETCH(QSize, size);
+    QFETCH(int, threshold);
+    const QImage before = noiseImage(size.width(), size.height(), 2);
+    const QImage after = perturbed(before, 3);
+    const ImageDiff diff = ImageDiff::compute(before, after, threshold);
+    const QImage mask = diff.maskImage();
+
+    qint64 expected = 0;
+    for (int y = 0; y < size.height(); ++y) {
+        const quint32* a = reinterpret_cast<const quint32*>(before.constScanLine(y));
+        const quint32* b = reinterpret_cast<const quint32*>(after.constScanLine(y));
+        const uchar* m = mask.constScanLine(y);
+        for (int x = 0; x < size.width(); ++x) {
+            const bool wanted = changed(a[x], b[x], threshold);
+            expected += wanted;
+            QVERIFY2((m[x] == 255) == wanted, qPrintable(QStringLiteral("pixel %1,%2").arg(x).arg(y)));
+        }
+    }
+    QCOMPARE(diff.changedPixels(), expected);
+}
+
+void TestImageDiff::clustersTouchingCells() {
+    QImage before(300, 200, QImage::Format_RGB32);
+    before.fill(0xFFFFFFFF);
+    QImage after = before.copy();
+    fillRect(after, QRect(10, 10, 20, 20), 0xFFFF0000);
+    // Spans four cells, which must come back as one region.
+    fillRect(after, QRect(200, 100, 50, 30), 0xFF0000FF);
+    const ImageDiff diff = ImageDiff::compute(before, after);
+    QCOMPARE(diff.changedPixels(), qint64(20 * 20 + 50 * 30));
+    QCOMPARE(diff.regions(), QVector<QRect>({ QRect(10, 10, 20, 20), QRect(200, 100, 50, 30) }));
+}
+
+void TestImageDiff::comparesCommonAreaOfDifferentSizes() {
+    QImage before(100, 80, QImage::Format_RGB32);
+    before.fill(0xFF336699);
+    QImage after(120, 60, QImage::Format_RGB32);
+    after.fill(0xFF336699);
+    const ImageDiff diff = ImageDiff::compute(before, after);
+    QCOMPARE(diff.size(), QSize(120, 80));
+    QCOMPARE(diff.changedPixels(), qint64(120 * 80 - 100 * 60));
+    QCOMPARE(diff.regions(), QVector<QRect>({ QRect(0, 0, 120, 80) }));
+}
+
+void TestImageDiff::nullImagesGiveNullDiff() {
+    const ImageDiff diff = ImageDiff::compute(QImage(), QImage());
+    QVERIFY(diff.isNull());
+    QVERIFY(diff.maskImage().isNull());
+    QVERIFY(diff.regions().isEmpty());
+}
+
+void TestImageDiff::benchmark4k_data() {
+    addPoolThreadRows();
+}
+
+void TestImageDiff::benchmark4k() {
+    QFETCH(int, threads);
+    const QImage before = noiseImage(3840, 2160, 4);
+    QImage after = before.copy();
+    fillRect(after, QRect(1000, 500, 400, 300), 0xFF000000);
+
+    PoolThreads pool(threads);
+    QBENCHMARK {
+        ImageDiff::compute(before, after);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestImageDiff)
+#include "tst_image_diff.moc"
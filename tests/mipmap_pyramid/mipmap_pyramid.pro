@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_mipmap_pyramid
+
+HEADERS += \
+    ../../include/mipmap_pyramid.h \
+    ../../include/pixel_ops.h \
+    ../../include/simd.h
+
+SOURCES += \
+    tst_mipmap_pyramid.cpp \
+    ../../src/mipmap_pyramid.cpp \
+    ../../src/pixel_ops.cpp
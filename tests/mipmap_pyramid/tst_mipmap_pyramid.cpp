@@ -0,0 +1,149 @@
+#include "../../include/mipmap_pyramid.h"
+#include "test_support.h"
+#include <QtTest>
+#include <algorithm>
+
+namespace {
+
+constexpr QImage::Format kFormat = QImage::Format_ARGB32_Premultiplied;
+
+// Straightforward 2x2 box filter; odd edges average with themselves.
+QImage referenceHalve(const QImage& source) {
+    QImage result((source.width() + 1) / 2, (source.height() + 1) / 2, source.format());
+    for (int y = 0; y < result.height(); ++y) {
+        for (int x = 0; x < result.width(); ++x) {
+            const int x0 = x * 2;
+            const int y0 = y * 2;
+            const int x1 = std::min(x0 + 1, source.width() - 1);
+            const int y1 = std::min(y0 + 1, source.height() - 1);
+            const quint32 pixels[4] = {
+                reinterpret_cast<const quint32*>(source.constScanLine(y0))[x0],
+                reinterpret_cast<const quint32*>(source.constScanLine(y0))[x1],
+                reinterpret_cast<const quint32*>(source.constScanLine(y1))[x0],
+                reinterpret_cast<const quint32*>(source.constScanLine(y1))[x1],
+            };
+            quint32 value = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                quint32 sum = 2;
+                for (quint32 pixel : pixels) {
+                    sum += (pixel >> shift) & 0xFF;
+                }
+                value |= (sum >> 2) << shift;
+            }
+            reinterpret_cast<quint32*>(result.scanLine(y))[x] = value;
+        }
+    }
+    return result;
+}
+
+}
+
+class TestMipmapPyramid : public QObject {
+    Q_OBJECT
+
+private slots:
+    void matchesReference_data();
+    void matchesReference();
+    void convertsOtherFormats();
+    void levelIsClamped();
+    void levelForScale_data();
+    void levelForScale();
+    void countsOnlyBuiltLevels();
+    void benchmarkLevelOne_data();
+    void benchmarkLevelOne();
+};
+
+void TestMipmapPyramid::matchesReference_data() {
+    QTest::addColumn<QSize>("size");
+    QTest::newRow("1x1") << QSize(1, 1);
+    QTest::newRow("odd") << QSize(37, 23);
+    QTest::newRow("one row") << QSize(301, 1);
+    QTest::newRow("one column") << QSize(1, 129);
+    QTest::newRow("power of two") << QSize(256, 64);
+    QTest::newRow("wide") << QSize(1921, 517);
+}
+
+void TestMipmapPyramid::matchesReference() {
+    QFETCH(QSize, size);
+    const QImage image = noiseImage(size.width(), size.height(), static_cast<quint32>(size.width() * 7919 + size.height()), kFormat);
+    MipmapPyramid pyramid;
+    pyramid.reset(image);
+    QVERIFY(!pyramid.isNull());
+
+    QImage expected = image;
+    for (int level = 1; level <= pyramid.maxLevel(); ++level) {
+        expected = referenceHalve(expected);
+        QCOMPARE(pyramid.level(level), expected);
+    }
+    // The top level is a single pixel on the longer side.
+    QCOMPARE(std::max(expected.width(), expected.height()), 1);
+}
+
+void TestMipmapPyramid::convertsOtherFormats() {
+    QImage image(10, 6, QImage::Format_RGB888);
+    image.fill(Qt::black);
+    MipmapPyramid pyramid;
+    pyramid.reset(image);
+    QCOMPARE(pyramid.level(0).format(), QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(pyramid.level(1).size(), QSize(5, 3));
+}
+
+void TestMipmapPyramid::levelIsClamped() {
+    MipmapPyramid pyramid;
+    pyramid.reset(noiseImage(100, 40, 1, kFormat));
+    QCOMPARE(pyramid.maxLevel(), 7);
+    QCOMPARE(pyramid.level(-3).size(), QSize(100, 40));
+    QCOMPARE(pyramid.level(50).size(), QSize(1, 1));
+
+    pyramid.clear();
+    QVERIFY(pyramid.isNull());
+    QCOMPARE(pyramid.maxLevel(), 0);
+}
+
+void TestMipmapPyramid::levelForScale_data() {
+    QTest::addColumn<qreal>("scale");
+    QTest::addColumn<int>("level");
+    QTest::newRow("zoomed in") << 4.0 << 0;
+    QTest::newRow("1:1") << 1.0 << 0;
+    QTest::newRow("just below 1") << 0.9 << 0;
+    QTest::newRow("half") << 0.5 << 1;
+    QTest::newRow("between") << 0.3 << 1;
+    QTest::newRow("quarter") << 0.25 << 2;
+    QTest::newRow("eighth") << 0.125 << 3;
+    QTest::newRow("zero") << 0.0 << 0;
+}
+
+void TestMipmapPyramid::levelForScale() {
+    QFETCH(qreal, scale);
+    QFETCH(int, level);
+    QCOMPARE(MipmapPyramid::levelFor(scale), level);
+}
+
+void TestMipmapPyramid::countsOnlyBuiltLevels() {
+    MipmapPyramid pyramid;
+    pyramid.reset(noiseImage(64, 64, 2, kFormat));
+    QCOMPARE(pyramid.memoryUsage(), qint64(0));
+    const qint64 levelOne = pyramid.level(1).sizeInBytes();
+    QCOMPARE(pyramid.memoryUsage(), levelOne);
+    const qint64 levelTwo = pyramid.level(2).sizeInBytes();
+    QCOMPARE(pyramid.memoryUsage(), levelOne + levelTwo);
+}
+
+void TestMipmapPyramid::benchmarkLevelOne_data() {
+    addPoolThreadRows();
+}
+
+// A three-monitor 4K capture.
+void TestMipmapPyramid::benchmarkLevelOne() {
+    QFETCH(int, threads);
+    const QImage image = noiseImage(11520, 2160, 3, kFormat);
+    PoolThreads pool(threads);
+    MipmapPyramid pyramid;
+    QBENCHMARK {
+        pyramid.reset(image);
+        pyramid.level(1);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestMipmapPyramid)
+#include "tst_mipmap_pyramid.moc"
@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = tst_scroll_stitcher
+
+HEADERS += \
+    ../../include/scroll_stitcher.h \
+    ../../include/pixel_ops.h \
+    ../../include/simd.h
+
+SOURCES += \
+    tst_scroll_stitcher.cpp \
+    ../../src/scroll_stitcher.cpp \
+    ../../src/pixel_ops.cpp
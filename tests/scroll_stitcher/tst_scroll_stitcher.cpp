@@ -0,0 +1,157 @@
+#include "../../include/scroll_stitcher.h"
+#include <QtTest>
+#include <cstring>
+
+namespace {
+
+constexpr int kWidth = 64;
+// Rows of the page visible between the header and the footer.
+constexpr int kBand = 200;
+
+quint32 noise(quint32 seed, int x, int y) {
+    quint32 h = seed ^ (static_cast<quint32>(y) * 0x9E3779B1u) ^ (static_cast<quint32>(x) * 0x85EBCA77u);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return 0xFF000000u | h;
+}
+
+// Rows that never repeat, standing in for a page, a header or a footer.
+QImage noiseRows(quint32 seed, int count) {
+    QImage image(kWidth, count, QImage::Format_RGB32);
+    for (int y = 0; y < count; ++y) {
+        quint32* line = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < kWidth; ++x) {
+            line[x] = noise(seed, x, y);
+        }
+    }
+    return image;
+}
+
+QImage stack(const QVector<QImage>& parts) {
+    int height = 0;
+    for (const QImage& part : parts) {
+        height += part.height();
+    }
+    QImage result(kWidth, height, QImage::Format_RGB32);
+    int y = 0;
+    for (const QImage& part : parts) {
+        for (int row = 0; row < part.height(); ++row, ++y) {
+            std::memcpy(result.scanLine(y), part.constScanLine(row), kWidth * 4);
+        }
+    }
+    return result;
+}
+
+// The screen with the page scrolled down by offset rows.
+QImage frameAt(const QImage& page, int offset, const QImage& header = QImage(), const QImage& footer = QImage()) {
+    return stack({ header, page.copy(0, offset, kWidth, kBand), footer });
+}
+
+}
+
+class TestScrollStitcher : public QObject {
+    Q_OBJECT
+
+private slots:
+    void stitchesPlainScroll();
+    void keepsStickyHeaderAndFooter();
+    void reportsUnchangedFrame();
+    void reportsNoOverlap();
+    void stopsAtMaxHeight();
+    void rejectsOversizedFirstFrame();
+    void rejectsFrameOfAnotherSize();
+};
+
+void TestScrollStitcher::stitchesPlainScroll() {
+    const QImage page = noiseRows(1, 1000);
+    ScrollStitcher stitcher;
+    for (int offset = 0; offset <= 150; offset += 50) {
+        QCOMPARE(stitcher.addFrame(frameAt(page, offset)), ScrollStitcher::Appended);
+    }
+    QCOMPARE(stitcher.frameCount(), 4);
+    QCOMPARE(stitcher.lastShift(), 50);
+    QCOMPARE(stitcher.width(), kWidth);
+    QCOMPARE(stitcher.height(), kBand + 150);
+    QCOMPARE(stitcher.image(), page.copy(0, 0, kWidth, kBand + 150));
+}
+
+void TestScrollStitcher::keepsStickyHeaderAndFooter() {
+    const QImage page = noiseRows(1, 1000);
+    const QImage header = noiseRows(2, 30);
+    const QImage footer = noiseRows(3, 20);
+    ScrollStitcher stitcher;
+    QCOMPARE(stitcher.addFrame(frameAt(page, 0, header, footer)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 40, header, footer)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.lastShift(), 40);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 120, header, footer)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.lastShift(), 80);
+
+    // Header and footer appear once, around every page row scrolled past.
+    QCOMPARE(stitcher.height(), 30 + kBand + 120 + 20);
+    QCOMPARE(stitcher.image(), stack({ header, page.copy(0, 0, kWidth, kBand + 120), footer }));
+}
+
+void TestScrollStitcher::reportsUnchangedFrame() {
+    const QImage page = noiseRows(1, 1000);
+    const QImage header = noiseRows(2, 30);
+    ScrollStitcher stitcher;
+    const QImage frame = frameAt(page, 0, header);
+    QCOMPARE(stitcher.addFrame(frame), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.addFrame(frame), ScrollStitcher::Unchanged);
+    QCOMPARE(stitcher.frameCount(), 1);
+    QCOMPARE(stitcher.height(), 30 + kBand);
+    QCOMPARE(stitcher.image(), frame);
+}
+
+void TestScrollStitcher::reportsNoOverlap() {
+    const QImage page = noiseRows(1, 1000);
+    ScrollStitcher stitcher;
+    QCOMPARE(stitcher.addFrame(frameAt(page, 0)), ScrollStitcher::Appended);
+    // Scrolled past everything the previous frame showed.
+    QCOMPARE(stitcher.addFrame(frameAt(page, kBand + 50)), ScrollStitcher::NoOverlap);
+    QCOMPARE(stitcher.height(), kBand);
+
+    // A rejected frame leaves the previous one as the reference.
+    QCOMPARE(stitcher.addFrame(frameAt(page, 100)), ScrollStitcher::Appended);
+    // Scrolled back up.
+    QCOMPARE(stitcher.addFrame(frameAt(page, 50)), ScrollStitcher::NoOverlap);
+    QCOMPARE(stitcher.frameCount(), 2);
+    QCOMPARE(stitcher.height(), kBand + 100);
+    QCOMPARE(stitcher.image(), page.copy(0, 0, kWidth, kBand + 100));
+}
+
+void TestScrollStitcher::stopsAtMaxHeight() {
+    const QImage page = noiseRows(1, 1000);
+    ScrollStitcher stitcher(kBand + 60);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 0)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 50)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 100)), ScrollStitcher::Failed);
+
+    // What was stitched before the limit is kept.
+    QCOMPARE(stitcher.height(), kBand + 50);
+    QCOMPARE(stitcher.image(), page.copy(0, 0, kWidth, kBand + 50));
+}
+
+void TestScrollStitcher::rejectsOversizedFirstFrame() {
+    const QImage page = noiseRows(1, 1000);
+    ScrollStitcher stitcher(kBand - 1);
+    QCOMPARE(stitcher.addFrame(frameAt(page, 0)), ScrollStitcher::Failed);
+    QCOMPARE(stitcher.frameCount(), 0);
+    QCOMPARE(stitcher.height(), 0);
+    QVERIFY(stitcher.image().isNull());
+}
+
+void TestScrollStitcher::rejectsFrameOfAnotherSize() {
+    const QImage page = noiseRows(1, 1000);
+    ScrollStitcher stitcher;
+    QCOMPARE(stitcher.addFrame(frameAt(page, 0)), ScrollStitcher::Appended);
+    QCOMPARE(stitcher.addFrame(page.copy(0, 50, kWidth, kBand - 1)), ScrollStitcher::Failed);
+    QCOMPARE(stitcher.addFrame(QImage()), ScrollStitcher::Failed);
+    QCOMPARE(stitcher.height(), kBand);
+}
+
+QTEST_GUILESS_MAIN(TestScrollStitcher)
+#include "tst_scroll_stitcher.moc"
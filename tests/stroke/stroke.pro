@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_stroke
+
+HEADERS += \
+    ../../include/stroke.h
+
+SOURCES += \
+    tst_stroke.cpp \
+    ../../src/stroke.cpp
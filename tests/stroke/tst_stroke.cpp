@@ -0,0 +1,155 @@
+#include "../../include/stroke.h"
+#include <QRandomGenerator>
+#include <QtMath>
+#include <QtTest>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr qreal kTolerance = 0.75;
+
+qreal distanceToSegment(const QPointF& point, const QPointF& a, const QPointF& b) {
+    const QPointF ab = b - a;
+    const qreal length = QPointF::dotProduct(ab, ab);
+    const qreal t = length > 0.0 ? std::clamp(QPointF::dotProduct(point - a, ab) / length, 0.0, 1.0) : 0.0;
+    const QPointF offset = point - (a + ab * t);
+    return std::sqrt(QPointF::dotProduct(offset, offset));
+}
+
+qreal distanceToPolyline(const QPointF& point, const QVector<QPoint>& polyline) {
+    qreal best = std::hypot(point.x() - polyline.first().x(), point.y() - polyline.first().y());
+    for (int i = 0; i + 1 < polyline.size(); ++i) {
+        best = std::min(best, distanceToSegment(point, polyline[i], polyline[i + 1]));
+    }
+    return best;
+}
+
+// A hand-drawn-like stroke: the heading drifts a little at every sample
+// and positions are rounded to whole pixels, as pointer events are.
+QVector<QPoint> randomStroke(QRandomGenerator& random, int count) {
+    QVector<QPoint> points;
+    QPointF position(random.bounded(1000.0), random.bounded(1000.0));
+    qreal heading = random.bounded(2.0 * M_PI);
+    for (int i = 0; i < count; ++i) {
+        heading += random.bounded(0.3) - 0.15;
+        const qreal step = 1.0 + random.bounded(2.0);
+        position += QPointF(std::cos(heading), std::sin(heading)) * step;
+        points.append(position.toPoint());
+    }
+    return points;
+}
+
+}
+
+class TestStroke : public QObject {
+    Q_OBJECT
+
+private slots:
+    void shortPolylinesAreKept();
+    void straightLineKeepsItsEnds();
+    void turnsAreKept();
+    void builderStaysWithinTolerance();
+    void builderSkipsRepeatedSamples();
+    void addStartsAStroke();
+    void finishEmptiesTheBuilder();
+    void smoothPathPassesThroughPoints();
+};
+
+void TestStroke::shortPolylinesAreKept() {
+    QCOMPARE(simplifyPolyline({}, kTolerance), QVector<QPoint>());
+    QCOMPARE(simplifyPolyline({ QPoint(1, 2) }, kTolerance), QVector<QPoint>({ QPoint(1, 2) }));
+    const QVector<QPoint> two = { QPoint(0, 0), QPoint(5, 5) };
+    QCOMPARE(simplifyPolyline(two, kTolerance), two);
+}
+
+void TestStroke::straightLineKeepsItsEnds() {
+    QVector<QPoint> line;
+    for (int t = 0; t <= 50; ++t) {
+        line.append(QPoint(t * 2, t));
+    }
+    QCOMPARE(simplifyPolyline(line, kTolerance), QVector<QPoint>({ QPoint(0, 0), QPoint(100, 50) }));
+}
+
+void TestStroke::turnsAreKept() {
+    QVector<QPoint> points;
+    for (int x = 0; x <= 50; ++x) {
+        points.append(QPoint(x, 0));
+    }
+    // Doubles back over itself: only distances to segments see the turn.
+    for (int x = 49; x >= 20; --x) {
+        points.append(QPoint(x, 0));
+    }
+    QCOMPARE(simplifyPolyline(points, kTolerance), QVector<QPoint>({ QPoint(0, 0), QPoint(50, 0), QPoint(20, 0) }));
+}
+
+void TestStroke::builderStaysWithinTolerance() {
+    QRandomGenerator random(49);
+    qint64 samples = 0;
+    qint64 kept = 0;
+    for (int stroke = 0; stroke < 200; ++stroke) {
+        const QVector<QPoint> raw = randomStroke(random, 2000);
+        StrokeBuilder builder(kTolerance);
+        builder.begin(raw.first());
+        for (int i = 1; i < raw.size(); ++i) {
+            builder.add(raw[i]);
+        }
+        const int sampleCount = builder.sampleCount();
+        const QVector<QPoint> simplified = builder.finish();
+
+        QCOMPARE(simplified.first(), raw.first());
+        QCOMPARE(simplified.last(), raw.last());
+        for (const QPoint& point : raw) {
+            QVERIFY(distanceToPolyline(point, simplified) <= kTolerance + 1e-9);
+        }
+        samples += sampleCount;
+        kept += simplified.size();
+    }
+    qInfo("kept %lld of %lld samples (%.1f%%)", kept, samples, 100.0 * kept / samples);
+    // About one sample in six survives on these strokes.
+    QVERIFY(kept * 3 < samples);
+}
+
+void TestStroke::builderSkipsRepeatedSamples() {
+    StrokeBuilder builder;
+    builder.begin(QPoint(0, 0));
+    builder.add(QPoint(0, 0));
+    builder.add(QPoint(3, 4));
+    builder.add(QPoint(3, 4));
+    QCOMPARE(builder.sampleCount(), 2);
+    QCOMPARE(builder.points(), QVector<QPoint>({ QPoint(0, 0), QPoint(3, 4) }));
+}
+
+void TestStroke::addStartsAStroke() {
+    StrokeBuilder builder;
+    builder.add(QPoint(7, 8));
+    QCOMPARE(builder.sampleCount(), 1);
+    QCOMPARE(builder.points(), QVector<QPoint>({ QPoint(7, 8) }));
+}
+
+void TestStroke::finishEmptiesTheBuilder() {
+    StrokeBuilder builder;
+    builder.begin(QPoint(0, 0));
+    for (int x = 1; x <= 200; ++x) {
+        builder.add(QPoint(x, 0));
+    }
+    // Batch ends stay vertices even on a straight line.
+    QCOMPARE(builder.finish(), QVector<QPoint>({ QPoint(0, 0), QPoint(64, 0), QPoint(128, 0), QPoint(192, 0), QPoint(200, 0) }));
+    QCOMPARE(builder.sampleCount(), 0);
+    QVERIFY(builder.points().isEmpty());
+}
+
+void TestStroke::smoothPathPassesThroughPoints() {
+    const QVector<QPoint> points = { QPoint(0, 0), QPoint(10, 20), QPoint(30, 5), QPoint(40, 40) };
+    const QPainterPath path = smoothStrokePath(points);
+    // A move, then one cubic (two control points and an end) per segment.
+    QCOMPARE(path.elementCount(), 1 + 3 * (static_cast<int>(points.size()) - 1));
+    for (int i = 0; i < points.size(); ++i) {
+        const QPainterPath::Element element = path.elementAt(i * 3);
+        QCOMPARE(QPointF(element.x, element.y), QPointF(points[i]));
+    }
+    QVERIFY(smoothStrokePath({}).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestStroke)
+#include "tst_stroke.moc"
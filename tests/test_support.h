@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QImage>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QThreadPool>
+#include <QtTest>
+
+// Helpers shared by the unit tests; tests.pri puts this directory on the
+// include path.
+
+// Random 32-bit pixels, the same for a given seed.
+inline QImage noiseImage(int width, int height, quint32 seed, QImage::Format format = QImage::Format_ARGB32) {
+    QImage image(width, height, format);
+    QRandomGenerator random(seed);
+    for (int y = 0; y < height; ++y) {
+        random.fillRange(reinterpret_cast<quint32*>(image.scanLine(y)), width);
+    }
+    return image;
+}
+
+// Data rows of a benchmark measured on one pool thread and on the whole
+// pool; the test function reads the "threads" column into PoolThreads.
+inline void addPoolThreadRows() {
+    QTest::addColumn<int>("threads");
+    QTest::newRow("one thread") << 1;
+    QTest::newRow("pool") << QThread::idealThreadCount();
+}
+
+// Limits the global thread pool, which parallelFor splits work over, for
+// the lifetime of the object.
+class PoolThreads {
+public:
+    explicit PoolThreads(int count)
+        : previous(QThreadPool::globalInstance()->maxThreadCount()) {
+        QThreadPool::globalInstance()->setMaxThreadCount(count);
+    }
+    ~PoolThreads() {
+        QThreadPool::globalInstance()->setMaxThreadCount(previous);
+    }
+    PoolThreads(const PoolThreads&) = delete;
+    PoolThreads& operator=(const PoolThreads&) = delete;
+
+private:
+    int previous;
+};
@@ -0,0 +1,11 @@
+# Shared settings of the unit tests. Each test is a console executable that
+# compiles the classes it covers straight from ../../src; none of them needs a
+# display.
+QT += testlib gui
+QT -= widgets
+
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD
+HEADERS += $$PWD/test_support.h
@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    scroll_stitcher \
+    image_diff \
+    stroke \
+    mipmap_pyramid \
+    delta_patch
@@ -3,108 +3,283 @@
 #include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QJsonArray>
+#include <QDir>
 #include <QMessageBox>
 #include <QFile>
 #include <QProcess>
 #include <QProgressDialog>
 #include <QStandardPaths>
+#include <QDateTime>
+#include <QTimer>
+#include <algorithm>
 #include "include/main_window.h"
 #include "include/utils.h"
+#include "include/update_downloader.h"
+#include "include/delta_patch.h"
+
+namespace {
+
+QJsonObject loadUpdateCache() {
+    QFile file(getConfigFilePath("update_manifest.json"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void saveUpdateCache(const QJsonObject& cache) {
+    QFile file(getConfigFilePath("update_manifest.json"));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(cache).toJson(QJsonDocument::Compact));
+    }
+}
+
+}
+
+void MainWindow::scheduleUpdateCheck() {
+    // Let the tray settle and the first capture happen before touching the network.
+    QJsonObject config = configManager->loadConfig();
+    const int delaySeconds = std::max(0, config["update_check_delay_seconds"].toInt(30));
+    QTimer::singleShot(delaySeconds * 1000, this, [this]() {
+        checkForUpdates(false);
+    });
+}
 
 void MainWindow::checkForUpdates(bool fromAction) {
+    QJsonObject cache = loadUpdateCache();
+    const QJsonObject cachedManifest = cache.value("manifest").toObject();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (!fromAction) {
+        // Failed attempts count too, so an offline machine does not hit the
+        // server again on every start.
+        QJsonObject config = configManager->loadConfig();
+        const qint64 intervalMs = static_cast<qint64>(std::max(0.0, config["update_check_interval_hours"].toDouble(24)) * 3600.0 * 1000.0);
+        const qint64 checkedAt = static_cast<qint64>(cache.value("checked_at").toDouble());
+        const qint64 attemptedAt = static_cast<qint64>(cache.value("attempted_at").toDouble());
+        if (now - std::max(checkedAt, attemptedAt) < intervalMs) {
+            if (!cachedManifest.isEmpty()) {
+                processUpdateManifest(cachedManifest, fromAction);
+            }
+            return;
+        }
+    }
+    cache["attempted_at"] = static_cast<double>(now);
+    saveUpdateCache(cache);
+
     QNetworkAccessManager* manager = new QNetworkAccessManager(this);
-    connect(manager, &QNetworkAccessManager::finished, this, [this, fromAction](QNetworkReply* reply) {
+    connect(manager, &QNetworkAccessManager::finished, this, [this, fromAction, manager](QNetworkReply* reply) {
         this->onUpdateCheckFinished(reply, fromAction);
+        manager->deleteLater();
         });
 
     QUrl url("https://screen-me.cloud/update.json");
     QNetworkRequest request(url);
+    if (!cachedManifest.isEmpty()) {
+        const QString etag = cache.value("etag").toString();
+        const QString lastModified = cache.value("last_modified").toString();
+        if (!etag.isEmpty()) {
+            request.setRawHeader("If-None-Match", etag.toLatin1());
+        }
+        if (!lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", lastModified.toLatin1());
+        }
+    }
     manager->get(request);
 }
 
 void MainWindow::onUpdateCheckFinished(QNetworkReply* reply, bool fromAction) {
     if (reply->error() == QNetworkReply::NoError) {
-        QByteArray response = reply->readAll();
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(response);
-        if (jsonDoc.isObject()) {
-            QJsonObject jsonObj = jsonDoc.object();
-            QString latestVersion = jsonObj.value("version").toString();
-            QString currentVersion = VERSION;
-
-            ConfigManager configManager("config.json");
-            QJsonObject config = configManager.loadConfig();
-
-            if (latestVersion > currentVersion && config["skipVersion"] != latestVersion) {
-                QString downloadUrl = jsonObj.value("download_url").toString();
-
-                QMessageBox::StandardButton replyButton;
-                replyButton = QMessageBox::question(this,
-                    "New update available !",
-                    QString("A new update (%1) has been released. Do you want to download and install now ?").arg(latestVersion),
-                    QMessageBox::Yes | QMessageBox::No | QMessageBox::Ignore);
-                if (replyButton == QMessageBox::Yes) {
-                    downloadUpdate(downloadUrl);
-                } else if (replyButton == QMessageBox::Ignore) {
-                    config["skipVersion"] = latestVersion;
-
-                    configManager.saveConfig(config);
-                }
-            }
-            else {
-                if (fromAction) {
-                    QMessageBox::information(this,
-                        "Update Check",
-                        "Your software is up to date.");
-                }
+        QJsonObject cache = loadUpdateCache();
+        QJsonObject manifest;
+
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 304) {
+            manifest = cache.value("manifest").toObject();
+        }
+        else {
+            QByteArray response = reply->readAll();
+            QJsonDocument jsonDoc = QJsonDocument::fromJson(response);
+            if (jsonDoc.isObject()) {
+                manifest = jsonDoc.object();
+                cache["manifest"] = manifest;
+                cache["etag"] = QString::fromLatin1(reply->rawHeader("ETag"));
+                cache["last_modified"] = QString::fromLatin1(reply->rawHeader("Last-Modified"));
             }
         }
+
+        if (!manifest.isEmpty()) {
+            cache["checked_at"] = static_cast<double>(QDateTime::currentMSecsSinceEpoch());
+            saveUpdateCache(cache);
+            processUpdateManifest(manifest, fromAction);
+        }
     }
     reply->deleteLater();
 }
 
-void MainWindow::downloadUpdate(const QString& downloadUrl) {
-    QNetworkAccessManager* manager = new QNetworkAccessManager(this);
-    QUrl url(downloadUrl);
+void MainWindow::processUpdateManifest(const QJsonObject& manifest, bool fromAction) {
+    QString latestVersion = manifest.value("version").toString();
+    QString currentVersion = VERSION;
+
+    ConfigManager configManager("config.json");
+    QJsonObject config = configManager.loadConfig();
+
+    if (compareVersions(latestVersion, currentVersion) > 0 && config["skipVersion"] != latestVersion) {
+        QMessageBox::StandardButton replyButton;
+        replyButton = QMessageBox::question(this,
+            "New update available !",
+            QString("A new update (%1) has been released. Do you want to download and install now ?").arg(latestVersion),
+            QMessageBox::Yes | QMessageBox::No | QMessageBox::Ignore);
+        if (replyButton == QMessageBox::Yes) {
+            downloadUpdate(manifest);
+        } else if (replyButton == QMessageBox::Ignore) {
+            config["skipVersion"] = latestVersion;
+
+            configManager.saveConfig(config);
+        }
+    }
+    else {
+        if (fromAction) {
+            QMessageBox::information(this,
+                "Update Check",
+                "Your software is up to date.");
+        }
+    }
+}
+
+void MainWindow::downloadUpdate(const QJsonObject& manifest) {
+    // Prefer a delta from the installed version when its installer was kept
+    // from the previous update; anything else gets the full installer.
+    const QString basePath = cachedInstallerPath(VERSION);
+    if (QFile::exists(basePath)) {
+        const QJsonArray deltas = manifest.value("deltas").toArray();
+        for (const QJsonValue& value : deltas) {
+            const QJsonObject delta = value.toObject();
+            if (delta.value("from").toString() == VERSION && !delta.value("url").toString().isEmpty()) {
+                downloadDeltaUpdate(manifest, delta, basePath);
+                return;
+            }
+        }
+    }
+    downloadFullUpdate(manifest);
+}
+
+void MainWindow::downloadFullUpdate(const QJsonObject& manifest) {
+    QUrl url(manifest.value("download_url").toString());
     if (!url.isValid()) {
         qDebug() << "Invalid URL: " << url;
         return;
     }
-    QNetworkRequest request(url);
 
-    QProgressDialog* progressDialog = new QProgressDialog("Downloading update...", "Cancel", 0, 100, this);
+    const QString version = manifest.value("version").toString();
+    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    UpdateDownloader* downloader = new UpdateDownloader(url, tempDir + "/update.exe", manifest.value("sha256").toString().toLatin1(), this);
+    QProgressDialog* progressDialog = createDownloadProgress(downloader, "Downloading update...");
+
+    connect(downloader, &UpdateDownloader::finished, this, [this, downloader, progressDialog, version](const QString& path) {
+        progressDialog->close();
+        downloader->deleteLater();
+        onDownloadFinished(path, version);
+    });
+    connect(downloader, &UpdateDownloader::failed, this, [this, downloader, progressDialog](const QString& reason) {
+        progressDialog->close();
+        downloader->deleteLater();
+        qWarning() << "Update download failed:" << reason;
+        if (!downloader->isCancelled()) {
+            QMessageBox::warning(this, "Update failed", reason);
+        }
+    });
+
+    downloader->start();
+}
+
+void MainWindow::downloadDeltaUpdate(const QJsonObject& manifest, const QJsonObject& delta, const QString& basePath) {
+    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    UpdateDownloader* downloader = new UpdateDownloader(QUrl(delta.value("url").toString()), tempDir + "/update.delta",
+                                                        delta.value("sha256").toString().toLatin1(), this);
+    QProgressDialog* progressDialog = createDownloadProgress(downloader, "Downloading update patch...");
+
+    connect(downloader, &UpdateDownloader::finished, this, [this, downloader, progressDialog, manifest, basePath, tempDir](const QString& patchPath) {
+        progressDialog->close();
+        downloader->deleteLater();
+
+        QFile patchFile(patchPath);
+        const QByteArray patch = patchFile.open(QIODevice::ReadOnly) ? patchFile.readAll() : QByteArray();
+        patchFile.close();
+        QFile::remove(patchPath);
+
+        const QString installerPath = tempDir + "/update.exe";
+        const QString patchedPath = installerPath + ".patched";
+        const QByteArray expected = manifest.value("sha256").toString().trimmed().toLower().toLatin1();
+        QByteArray digest;
+        QString error;
+        if (!applyDeltaPatch(basePath, patch, patchedPath, &digest, &error) || expected.isEmpty() || digest != expected) {
+            qWarning() << "Delta update unusable, falling back to full download:" << (error.isEmpty() ? QString("checksum mismatch") : error);
+            QFile::remove(patchedPath);
+            downloadFullUpdate(manifest);
+            return;
+        }
+
+        if (!replaceFile(patchedPath, installerPath)) {
+            downloadFullUpdate(manifest);
+            return;
+        }
+        onDownloadFinished(installerPath, manifest.value("version").toString());
+    });
+    connect(downloader, &UpdateDownloader::failed, this, [this, downloader, progressDialog, manifest](const QString& reason) {
+        progressDialog->close();
+        downloader->deleteLater();
+        if (downloader->isCancelled()) {
+            return;
+        }
+        qWarning() << "Delta download failed, falling back to full download:" << reason;
+        downloadFullUpdate(manifest);
+    });
+
+    downloader->start();
+}
+
+QProgressDialog* MainWindow::createDownloadProgress(UpdateDownloader* downloader, const QString& label) {
+    QProgressDialog* progressDialog = new QProgressDialog(label, "Cancel", 0, 100, this);
     progressDialog->setWindowModality(Qt::WindowModal);
     progressDialog->setMinimumDuration(0);
+    progressDialog->setAttribute(Qt::WA_DeleteOnClose);
 
-    QNetworkReply* networkReply = manager->get(request);
-
-    connect(manager, &QNetworkAccessManager::finished, this, &MainWindow::onDownloadFinished);
-    connect(networkReply, &QNetworkReply::downloadProgress, this, [progressDialog](qint64 bytesReceived, qint64 bytesTotal) {
+    connect(downloader, &UpdateDownloader::progress, progressDialog, [progressDialog](qint64 bytesReceived, qint64 bytesTotal) {
         if (bytesTotal > 0) {
             progressDialog->setMaximum(100);
             progressDialog->setValue(static_cast<int>((bytesReceived * 100) / bytesTotal));
         }
     });
-    connect(progressDialog, &QProgressDialog::canceled, networkReply, &QNetworkReply::abort);
+    connect(progressDialog, &QProgressDialog::canceled, downloader, &UpdateDownloader::cancel);
+    return progressDialog;
 }
 
-void MainWindow::onDownloadFinished(QNetworkReply* reply) {
-    if (reply->error() == QNetworkReply::NoError) {
-        QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-        QFile file(tempDir + "/update.exe");
-        if (file.open(QIODevice::WriteOnly)) {
-            file.write(reply->readAll());
-            file.close();
-
-            QMessageBox::StandardButton replyButton;
-            replyButton = QMessageBox::question(this,
-                "Download finished",
-                "The update has been downloaded. Do you want to install now ?",
-                QMessageBox::Yes | QMessageBox::No);
-            if (replyButton == QMessageBox::Yes) {
-                QProcess::startDetached(tempDir + "/update.exe");
-                QApplication::exit(0);
-            }
+QString MainWindow::cachedInstallerPath(const QString& version) {
+    return getConfigFilePath("updates") + "/ScreenMe-" + version + ".exe";
+}
+
+void MainWindow::onDownloadFinished(const QString& installerPath, const QString& version) {
+    QMessageBox::StandardButton replyButton;
+    replyButton = QMessageBox::question(this,
+        "Download finished",
+        "The update has been downloaded. Do you want to install now ?",
+        QMessageBox::Yes | QMessageBox::No);
+    if (replyButton == QMessageBox::Yes) {
+        // The verified installer becomes the base for the next delta update.
+        // Until the user agrees to install, the installer of the running
+        // version stays, since deltas are built from that one.
+        QDir cacheDir(getConfigFilePath("updates"));
+        cacheDir.mkpath(".");
+        const QStringList previous = cacheDir.entryList(QStringList() << "ScreenMe-*.exe", QDir::Files);
+        for (const QString& name : previous) {
+            cacheDir.remove(name);
+        }
+        if (!version.isEmpty()) {
+            QFile::copy(installerPath, cachedInstallerPath(version));
         }
+        QProcess::startDetached(installerPath);
+        QApplication::exit(0);
     }
-    reply->deleteLater();
-} 
+}